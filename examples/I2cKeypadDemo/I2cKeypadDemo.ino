@@ -274,6 +274,7 @@ void loop()
   // call the getKeyUntil() function. This function also calls scanKeys() many times, so you don't need to call scanKeys().
   // This function waits for one of the termination conditions to occur, and then returns (i.e. this function blocks other code from running until it is done).
   // Note: If running a Particle device, this function getKeyUntil() will automatically call Particle.process() to keep the cloud connection alive.
+  // Note: keypad.setWaitHook() gives getKeyUntil() a function to call between scans, so the processor can sleep (or run other tasks) while it waits.
   keyFromKeypad = keypad.getKeyUntil(10000);
   if (keyFromKeypad != RETURN_NO_KEY_IN_BUFFER)  // if a key is pressed, display it.
   {
@@ -287,5 +288,31 @@ void loop()
   }
 
 
+  // Testing the getIntUntil() function (reads a whole number, ending with a terminator key, the max number of digits, or a timeout)
+  // getIntUntil() does not wait... it adds the keys pressed since the last call to the number, and returns WAITING_FOR_MORE_KEYS
+  //    until the number is finished. So your loop() can keep doing other things while the number is typed.
+  //    getKeysUntil(), getFixedUntil() and getFloatUntil() work the same way.
+  long number;           // the number entered on the keypad
+  int status;            // WAITING_FOR_MORE_KEYS until the number is finished
+  keypad.flushKeys();
+  Serial.println();
+  Serial.println();
+  Serial.println("Testing getIntUntil()");
+  Serial.println("Type a number of up to 6 digits and press E within 20 seconds ('-' makes it negative, 'C' is backspace)...");
+  do
+  {
+    // E ends the number, C is backspace, - is the minus sign
+    status = keypad.getIntUntil(number, 6, 20000, 'E', 'C', '-');
+    // other code could run here while the number is being typed
+    #ifdef PARTICLE
+      Particle.process();           // keep particle happy if we sit in this loop for a long time
+    #endif
+  } while (status == WAITING_FOR_MORE_KEYS);
+  if (status == TIMEOUT_PERIOD_EXCEEDED)
+    Serial.print("Timed out. ");
+  Serial.print("The number is: ");
+  Serial.println(number);
+
+
 
 }
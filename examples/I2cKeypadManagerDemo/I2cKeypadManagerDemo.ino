@@ -0,0 +1,93 @@
+
+/*
+  I2cKeypadManagerDemo.ino
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    This demo program shows how to use I2cKeypadManager to scan two keypads
+    on the same I2C bus. The manager spreads the keypad scans evenly over the scan period,
+    and returns the keys from both keypads in the order they were pressed.
+
+    Each keypad must connect to the I2C bus using a MCP23008 8 bit interface chip,
+    and each MCP23008 must have a different i2c address (0x20 - 0x27).
+
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  This demo program is public domain. You may use it for any purpose.
+      NO WARRANTY IS IMPLIED.
+
+  License Information:  https://www.dcity.org/license-information/
+
+  NOTES:
+      1. If using Arduino IDE, version 1.5.0 or higher is REQUIRED!
+
+*/
+
+// include files... some boards require different include files
+#ifdef PARTICLE                     // if using a core, photon, or electron (by particle.io)
+#include "I2cKeypad/I2cKeypad.h"  // use this if the library files are in the particle repository of libraries
+#include "I2cKeypad/I2cKeypadManager.h"
+#else                           // if using an arduino or something else
+#include "I2cKeypad.h"
+#include "I2cKeypadManager.h"
+#include "Wire.h"
+#endif
+
+
+#define KEYPAD_DEBOUNCE_TIME 20                // 20ms debounce time for the keypads
+#define KEYPAD_SCAN_PERIOD 21                  // each keypad is scanned once every 21ms (this should be more than the debounce time)
+#define KEYPAD_BUS_BUDGET 1000                 // spend at most 1000us scanning keypads in each call to update()
+#define KEYPAD_ROWS 4
+#define KEYPAD_COlS 4
+byte rowPins[KEYPAD_ROWS] = {0, 1, 2, 3};      // these are the i/o pins for each keypad row connected to the MCP23008 chip
+byte colPins[KEYPAD_COlS] = {4, 5, 6, 7};      // these are the i/o pins for each keypad column connected to the MCP23008 chip
+
+char keyMap[KEYPAD_ROWS][KEYPAD_COlS] = {
+  {'1','2','3','A'},                                // row 1 keys
+  {'4','5','6','B'},                                // row 2 keys
+  {'7','8','9','C'},                                // row 3 keys
+  {'0','-','.','E'}                                 // row 4 keys
+};
+
+// create the keypad objects (the same key map is used for both keypads)
+I2cKeypad keypad1( ((char*)keyMap), rowPins, colPins,  KEYPAD_ROWS, KEYPAD_COlS, KEYPAD_DEBOUNCE_TIME, 0x20);
+I2cKeypad keypad2( ((char*)keyMap), rowPins, colPins,  KEYPAD_ROWS, KEYPAD_COlS, KEYPAD_DEBOUNCE_TIME, 0x21);
+
+// create the manager that scans both keypads
+I2cKeypadManager keypads(KEYPAD_SCAN_PERIOD, KEYPAD_BUS_BUDGET);
+
+
+void setup()
+{
+  Wire.begin();                         // initialize i2c
+  Serial.begin(9600);                   // initialize the Serial port, needed to check keypad operation
+
+  keypads.addKeypad(keypad1);           // this keypad will be source 0
+  keypads.addKeypad(keypad2);           // this keypad will be source 1
+  keypads.begin();                      // initialize all of the keypads
+
+  delay(3000);
+  Serial.println("I2cKeypadManager Demo Program");
+  Serial.println("Press keys on either keypad...");
+}
+
+
+void loop()
+{
+  uint8_t source;                       // index of the keypad that the key came from
+  uint8_t key;                          // ASCII value of the key
+
+  keypads.update();                     // scan the keypads that are due (call this often)
+
+  key = keypads.getKey(&source);
+  if (key != RETURN_NO_KEY_IN_BUFFER)
+  {
+    Serial.print("Keypad ");
+    Serial.print(source + 1);
+    Serial.print(": ");
+    Serial.println(char(key));
+  }
+}
@@ -0,0 +1,62 @@
+/*
+  Arduino.h (host version)
+
+  Short Description:
+
+    Stand-in for the Arduino core, so the I2cKeypad library can be compiled and run on a
+    Linux (or other) computer. The clock is simulated: millis() and micros() only move when
+    the simulation moves them (see simMicros), so the results are the same on every run.
+
+    Only the parts of the Arduino core used by the library are here.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+
+// there is no separate flash memory on the host
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// simulated time in microseconds. Only the simulation (and delay(), delayMicroseconds() and the simulated i2c bus) moves it.
+extern uint64_t simMicros;
+
+// microcontroller pin that reads the INT output of a simulated chip (see SimKeypadChip::connectInterruptPin()), or -1
+extern int simIntPin;
+
+// a chip holding SDA low: the microcontroller pins for SDA and SCL (-1 = not simulated), and the number of SCL clocks
+// until the chip lets go of SDA (0 = SDA is free). While SDA is held every i2c transaction times out.
+extern int simSdaPin;
+extern int simSclPin;
+extern uint8_t simSdaHeld;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void yield(void);
+
+#endif
@@ -0,0 +1,226 @@
+/*
+  HostArduino.cpp
+
+  Short Description:
+
+    The simulated clock, pins and i2c bus used to run the I2cKeypad library on a host computer.
+    See Arduino.h and Wire.h in this folder for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimKeypadChip.h"
+
+uint64_t simMicros = 1000000;         // start at 1 second, so times just before the start don't wrap around
+int simIntPin = -1;
+SimKeypadChip *simIntDevice = 0;      // chip whose INT pin is read by digitalRead(simIntPin)
+int simSdaPin = -1;
+int simSclPin = -1;
+uint8_t simSdaHeld = 0;
+TwoWire Wire;
+
+
+// Arduino core functions ********************************
+
+unsigned long millis(void)
+{
+  return (unsigned long)(simMicros / 1000);
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)simMicros;
+}
+
+void delay(unsigned long ms)
+{
+  simMicros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  simMicros += us;
+}
+
+// letting SCL go (an input, raised by its pullup) is a clock for a chip that is holding SDA low
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if ((int)pin == simSclPin && mode == INPUT && simSdaHeld)
+    --simSdaHeld;
+}
+
+// the only input pins are the INT pin of a simulated chip, and SDA
+int digitalRead(uint8_t pin)
+{
+  if ((int)pin == simIntPin && simIntDevice)
+    return simIntDevice->interruptAsserted() ? LOW : HIGH;
+  if ((int)pin == simSdaPin)
+    return simSdaHeld ? LOW : HIGH;
+  return HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  (void)pin;
+  (void)value;
+}
+
+void yield(void)
+{
+}
+
+
+// TwoWire functions ********************************
+
+TwoWire::TwoWire()
+{
+  memset(_devices, 0, sizeof(_devices));
+  _clock = 100000;
+  _address = 0;
+  _txLength = 0;
+  _rxLength = 0;
+  _rxIndex = 0;
+  _failCount = 0;
+  _failError = 0;
+  ends = 0;
+  resetCounters();
+}
+
+void TwoWire::setClock(uint32_t clock)
+{
+  _clock = clock;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+  _address = address & 0x7f;
+  _txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+  if (_txLength >= WIRE_BUFFER_SIZE)
+    return 0;
+  _txBuffer[_txLength++] = data;
+  return 1;
+}
+
+// send the bytes saved by write()
+// parameters
+//    sendStop - false to leave the bus busy for a repeated start read (the read counts as part of this transaction)
+// returns
+//    0 if the device acknowledged, 2 if there is no device at the address, or the error of a failure made on purpose
+uint8_t TwoWire::endTransmission(bool sendStop)
+{
+  uint8_t error = failure();
+  if (error)
+  {
+    busTime(1);
+    ++transactions;
+    return error;
+  }
+  SimDevice *device = _devices[_address];
+  busTime(device ? _txLength + 1 : 1);        // only the address byte is sent if it is not acknowledged
+  if (sendStop || !device)
+    ++transactions;
+  if (!device)
+    return 2;
+  device->write(_txBuffer, _txLength);
+  return 0;
+}
+
+// read bytes from a device
+// parameters
+//    address - i2c address of the device
+//    quantity - number of bytes to read
+// returns
+//    the number of bytes read (0 if there is no device at the address)
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+  SimDevice *device = _devices[address & 0x7f];
+  ++transactions;
+  _rxIndex = 0;
+  _rxLength = 0;
+  if (!device || failure())
+  {
+    busTime(1);
+    return 0;
+  }
+  if (quantity > WIRE_BUFFER_SIZE)
+    quantity = WIRE_BUFFER_SIZE;
+  busTime(quantity + 1);
+  _rxLength = device->read(_rxBuffer, quantity);
+  return _rxLength;
+}
+
+int TwoWire::available(void)
+{
+  return _rxLength - _rxIndex;
+}
+
+int TwoWire::read(void)
+{
+  return _rxIndex < _rxLength ? _rxBuffer[_rxIndex++] : -1;
+}
+
+void TwoWire::attach(uint8_t address, SimDevice *device)
+{
+  _devices[address & 0x7f] = device;
+}
+
+SimDevice *TwoWire::device(uint8_t address)
+{
+  return _devices[address & 0x7f];
+}
+
+// count a whole transaction
+// parameters
+//    byteCount - number of bytes on the bus, including the address bytes
+void TwoWire::countTransaction(uint8_t byteCount)
+{
+  ++transactions;
+  busTime(byteCount);
+}
+
+// make the next transactions fail
+// parameters
+//    count - number of transactions that fail
+//    error - value returned by endTransmission() for them (2 = address NACK, 5 = timeout)
+void TwoWire::failTransactions(uint8_t count, uint8_t error)
+{
+  _failCount = count;
+  _failError = error;
+}
+
+void TwoWire::resetCounters(void)
+{
+  transactions = 0;
+  bytes = 0;
+  busMicros = 0;
+}
+
+// return the error for the next transaction, if it fails on purpose: every transaction times out while SDA is held
+// low, and the ones given to failTransactions() fail with their error
+uint8_t TwoWire::failure(void)
+{
+  if (simSdaHeld)
+    return 5;
+  if (!_failCount)
+    return 0;
+  --_failCount;
+  return _failError;
+}
+
+// count the bytes of a transaction, and move the simulated clock by the time they take on the bus
+// (9 clocks for each byte, plus about 2 clocks for the start and stop conditions)
+void TwoWire::busTime(uint8_t byteCount)
+{
+  unsigned long time = (unsigned long)(((uint64_t)byteCount * 9 + 2) * 1000000 / _clock);
+  bytes += byteCount;
+  busMicros += time;
+  simMicros += time;
+}
@@ -0,0 +1,369 @@
+/*
+  KeypadBenchmark.cpp
+
+  Short Description:
+
+    Runs the I2cKeypad library on a host computer against a simulated chip with a 4x4 keypad,
+    and measures what each scan costs and how quickly key presses reach the keypad buffer.
+    This lets a change to the scan code be measured before it is tried on real hardware.
+
+    Each setup of the library (chip, scan mode, scan rates, debounce, interrupts) is run through these scenarios:
+      idle    - no keys are pressed for 2 seconds
+      single  - one key at a time is pressed and released, with contact bounce
+      multi   - a second key is pressed while the first one is held down
+
+    For each one it prints:
+      calls     - number of scanKeys() calls (the rest of loop() is simulated as LOOP_TIME microseconds)
+      trans     - i2c transactions per call (average and max)
+      bytes     - bytes on the bus per call (average and max, including address bytes)
+      bus us    - bus time per call in microseconds (average and max)
+      bus %     - percent of the time the bus was busy
+      found     - key presses saved in the buffer / key presses made
+      latency   - time from the first contact of a key until it was saved in the buffer (average and max, in ms)
+
+    Everything runs on a simulated clock, so the results are the same on every run.
+
+    To build and run (from the top folder of the library):
+
+      g++ -std=c++11 -O2 -Wall -Iextras/host -Isrc -o keypad_benchmark \
+          extras/host/KeypadBenchmark.cpp extras/host/HostArduino.cpp extras/host/SimKeypadChip.cpp \
+          extras/host/SimMcp23008.cpp extras/host/SimMcp23017.cpp extras/host/SimPcf8574.cpp \
+          src/I2cKeypad.cpp src/I2cKeypadManager.cpp src/I2cKeypadCodeMatcher.cpp src/I2cKeypadTrace.cpp
+      ./keypad_benchmark
+
+    To run the Linux version of the library (i2c-dev, see src/I2cKeypadI2cDev.h) against the same simulated
+    chips, add -DKEYPAD_LINUX_I2CDEV and the simulated i2c-dev interface (SimI2cDev.cpp):
+
+      g++ -std=c++11 -O2 -Wall -DKEYPAD_LINUX_I2CDEV -Iextras/host -Isrc -o keypad_benchmark_linux \
+          extras/host/KeypadBenchmark.cpp extras/host/HostArduino.cpp extras/host/SimKeypadChip.cpp \
+          extras/host/SimMcp23008.cpp extras/host/SimMcp23017.cpp extras/host/SimPcf8574.cpp extras/host/SimI2cDev.cpp \
+          src/I2cKeypad.cpp src/I2cKeypadManager.cpp src/I2cKeypadCodeMatcher.cpp src/I2cKeypadTrace.cpp src/I2cKeypadI2cDev.cpp
+      ./keypad_benchmark_linux
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimMcp23008.h"
+#include "SimMcp23017.h"
+#include "SimPcf8574.h"
+#include "I2cKeypad.h"
+
+#define KEYPAD_ADDRESS 0x20           // i2c address of the simulated chip
+#define I2C_CLOCK 100000              // i2c clock rate (Hz)
+#define KEYPAD_ROWS 4
+#define KEYPAD_COLUMNS 4
+#define KEYPAD_DEBOUNCE_TIME 20       // milliseconds
+#define INT_PIN 2                     // microcontroller pin the chip's INT pin is connected to
+
+#define LOOP_TIME 100                 // microseconds that the rest of loop() takes, between scanKeys() calls
+#define MAX_PRESSES 64                // max number of key presses in one scenario
+#define BOUNCES 3                     // times a key bounces when it is pressed or released
+#define BOUNCE_TIME 300               // microseconds between each change while a key bounces
+
+char keyMap[KEYPAD_ROWS][KEYPAD_COLUMNS] = {
+  {'1', '2', '3', 'A'},
+  {'4', '5', '6', 'B'},
+  {'7', '8', '9', 'C'},
+  {'0', '-', '.', 'E'}
+};
+uint8_t rowPins[KEYPAD_ROWS] = {0, 1, 2, 3};
+uint8_t colPins[KEYPAD_COLUMNS] = {4, 5, 6, 7};
+
+// one way of setting up the library
+struct Setup {
+  const char *name;
+  uint8_t chipType;
+  uint8_t scanMode;
+  uint16_t activeInterval;            // setScanRates() (0 = don't call it)
+  uint16_t idleInterval;
+  uint16_t idleDelay;
+  uint8_t pressSamples;               // setDebounceSamples() (0 = use the debounce time)
+  uint8_t releaseSamples;
+  uint8_t scanBudget;                 // setScanBudget()
+  bool interrupts;                    // enableInterrupts()
+};
+
+const Setup setups[] = {
+  // name                   chip             scan mode                   active idle delay  press release budget interrupts
+  {"columns",               KEYPAD_MCP23008, KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     false},
+  {"line reversal",         KEYPAD_MCP23008, KEYPAD_SCAN_LINE_REVERSAL,  0,     0,   0,     0,    0,      0,     false},
+  {"matrix",                KEYPAD_MCP23008, KEYPAD_SCAN_MATRIX,         0,     0,   0,     0,    0,      0,     false},
+  {"columns + interrupt",   KEYPAD_MCP23008, KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     true},
+  {"columns + budget 1",    KEYPAD_MCP23008, KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      1,     false},
+  {"columns + adaptive",    KEYPAD_MCP23008, KEYPAD_SCAN_COLUMNS,        5,     50,  500,   0,    0,      0,     false},
+  {"columns + samples",     KEYPAD_MCP23008, KEYPAD_SCAN_COLUMNS,        2,     50,  500,   4,    3,      0,     false},
+  {"reversal + samples",    KEYPAD_MCP23008, KEYPAD_SCAN_LINE_REVERSAL,  2,     50,  500,   4,    3,      0,     false},
+  {"matrix + samples",      KEYPAD_MCP23008, KEYPAD_SCAN_MATRIX,         2,     50,  500,   4,    3,      0,     false},
+  {"MCP23017 columns",      KEYPAD_MCP23017, KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     false},
+  {"MCP23017 interrupt",    KEYPAD_MCP23017, KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     true},
+  {"PCF8574 columns",       KEYPAD_PCF8574,  KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     false},
+  {"PCF8574 reversal",      KEYPAD_PCF8574,  KEYPAD_SCAN_LINE_REVERSAL,  0,     0,   0,     0,    0,      0,     false},
+  {"PCF8574 interrupt",     KEYPAD_PCF8574,  KEYPAD_SCAN_COLUMNS,        0,     0,   0,     0,    0,      0,     true},
+  {"PCF8575 matrix",        KEYPAD_PCF8575,  KEYPAD_SCAN_MATRIX,         0,     0,   0,     0,    0,      0,     false},
+};
+
+// a key press made by a scenario
+struct Press {
+  char key;
+  unsigned long time;                 // time of the first contact (micros)
+  unsigned long found;                // time it was saved in the keypad buffer (0 if it was not)
+};
+
+// results of one scenario
+struct Results {
+  unsigned long calls;
+  unsigned long transactions;
+  unsigned long maxTransactions;
+  unsigned long bytes;
+  unsigned long maxBytes;
+  unsigned long busMicros;
+  unsigned long maxBusMicros;
+  unsigned long elapsed;
+  Press presses[MAX_PRESSES];
+  uint8_t pressCount;
+};
+
+SimMcp23008 mcp23008;
+SimMcp23017 mcp23017;
+SimPcf8574 pcf8574(8);
+SimPcf8574 pcf8575(16);
+SimKeypadChip *chip;                  // the chip used by the setup being run
+
+
+// schedule a key press (with bounce) and remember it, so its latency can be measured
+// parameters
+//    results - the press is added here
+//    time - time of the first contact (micros)
+//    row, col - the key
+// returns
+//    nothing
+void schedulePress(Results &results, unsigned long time, uint8_t row, uint8_t col)
+{
+  chip->scheduleBounce(time, rowPins[row], colPins[col], true, BOUNCES, BOUNCE_TIME);
+  if (results.pressCount < MAX_PRESSES)
+  {
+    Press &press = results.presses[results.pressCount++];
+    press.key = keyMap[row][col];
+    press.time = time;
+    press.found = 0;
+  }
+}
+
+// schedule a key release (with bounce)
+void scheduleRelease(unsigned long time, uint8_t row, uint8_t col)
+{
+  chip->scheduleBounce(time, rowPins[row], colPins[col], false, BOUNCES, BOUNCE_TIME);
+}
+
+// call scanKeys() like loop() would until the time is up, measuring each call. Key press events are matched
+// with the presses that were scheduled.
+// parameters
+//    keypad - the keypad
+//    results - the measurements are added here
+//    duration - microseconds to run
+// returns
+//    nothing
+void run(I2cKeypad &keypad, Results &results, unsigned long duration)
+{
+  unsigned long end = micros() + duration;
+  KeypadEvent event;
+
+  while ((long)(micros() - end) < 0)
+  {
+    unsigned long transactions = Wire.transactions;
+    unsigned long bytes = Wire.bytes;
+    unsigned long busMicros = Wire.busMicros;
+
+    keypad.scanKeys();
+
+    transactions = Wire.transactions - transactions;
+    bytes = Wire.bytes - bytes;
+    busMicros = Wire.busMicros - busMicros;
+    results.calls++;
+    results.transactions += transactions;
+    results.bytes += bytes;
+    results.busMicros += busMicros;
+    if (transactions > results.maxTransactions)
+      results.maxTransactions = transactions;
+    if (bytes > results.maxBytes)
+      results.maxBytes = bytes;
+    if (busMicros > results.maxBusMicros)
+      results.maxBusMicros = busMicros;
+
+    // match each press event with the latest press of that key before it (a press that was missed is not found later)
+    while (keypad.getEventQueue().pop(event))
+    {
+      if (event.type != KEY_EVENT_PRESSED)
+        continue;
+      for (uint8_t i = results.pressCount; i--; )
+      {
+        Press &press = results.presses[i];
+        if (press.key == event.key && (long)(event.time - press.time) >= 0)
+        {
+          if (!press.found)
+            press.found = event.time;
+          break;
+        }
+      }
+    }
+
+    simMicros += LOOP_TIME;           // the rest of loop()
+  }
+  results.elapsed += duration;
+}
+
+// scenario: no keys pressed
+void idleScenario(I2cKeypad &keypad, Results &results)
+{
+  run(keypad, results, 2000000);
+}
+
+// scenario: press and release each key once, one at a time
+void singleScenario(I2cKeypad &keypad, Results &results)
+{
+  unsigned long time = micros() + 13000;   // not lined up with the scan times
+  for (uint8_t i = 0; i < KEYPAD_ROWS * KEYPAD_COLUMNS; ++i)
+  {
+    uint8_t row = i / KEYPAD_COLUMNS;
+    uint8_t col = i % KEYPAD_COLUMNS;
+    schedulePress(results, time, row, col);
+    scheduleRelease(time + 80000, row, col);
+    run(keypad, results, 80000 + 150000 + 1700 * i);
+    time = micros() + 700;
+  }
+}
+
+// scenario: hold one key, press a second key, then release them both (a fast typist rolling from one key to the next)
+void multiScenario(I2cKeypad &keypad, Results &results)
+{
+  for (uint8_t i = 0; i < 8; ++i)
+  {
+    uint8_t row1 = i % KEYPAD_ROWS;
+    uint8_t col1 = i % KEYPAD_COLUMNS;
+    uint8_t row2 = (i + 1) % KEYPAD_ROWS;
+    uint8_t col2 = (i + 2) % KEYPAD_COLUMNS;
+    unsigned long time = micros() + 1100 * i;
+    schedulePress(results, time, row1, col1);
+    schedulePress(results, time + 40000, row2, col2);
+    scheduleRelease(time + 120000, row2, col2);
+    scheduleRelease(time + 160000, row1, col1);
+    run(keypad, results, 400000);
+  }
+}
+
+// print one line of results
+void printResults(const char *setupName, const char *scenarioName, Results &results)
+{
+  unsigned long found = 0;
+  unsigned long latency = 0;
+  unsigned long maxLatency = 0;
+  for (uint8_t i = 0; i < results.pressCount; ++i)
+  {
+    Press &press = results.presses[i];
+    if (!press.found)
+      continue;
+    unsigned long time = press.found - press.time;
+    ++found;
+    latency += time;
+    if (time > maxLatency)
+      maxLatency = time;
+  }
+
+  printf("%-22s %-7s %7lu  %5.2f %3lu  %6.2f %4lu  %7.1f %5lu  %5.2f",
+         setupName, scenarioName, results.calls,
+         (double)results.transactions / results.calls, results.maxTransactions,
+         (double)results.bytes / results.calls, results.maxBytes,
+         (double)results.busMicros / results.calls, results.maxBusMicros,
+         100.0 * results.busMicros / results.elapsed);
+  if (results.pressCount)
+    printf("  %2lu/%-2u  %5.1f %5.1f\n", found, results.pressCount,
+           found ? latency / 1000.0 / found : 0.0, maxLatency / 1000.0);
+  else
+    printf("\n");
+}
+
+// run every scenario with one setup of the library
+void benchmark(const Setup &setup)
+{
+  static const char *scenarioNames[] = {"idle", "single", "multi"};
+
+  for (uint8_t scenario = 0; scenario < 3; ++scenario)
+  {
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, setup.scanMode,
+                     setup.chipType);
+    I2cKeypadEventBuffer<64> events;
+    I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> matrix;
+    Results results;
+
+    memset(&results, 0, sizeof(results));
+    switch (setup.chipType)
+    {
+      case KEYPAD_MCP23017:
+        chip = &mcp23017;
+        break;
+      case KEYPAD_PCF8574:
+        chip = &pcf8574;
+        break;
+      case KEYPAD_PCF8575:
+        chip = &pcf8575;
+        break;
+      default:
+        chip = &mcp23008;
+        break;
+    }
+    Wire.attach(KEYPAD_ADDRESS, chip);
+    chip->connectInterruptPin(INT_PIN);
+    chip->releaseAll();
+    chip->powerOnReset();
+    keypad.setEventQueue(events);
+    keypad.setMatrix(&matrix);
+    keypad.begin();
+    if (setup.activeInterval)
+      keypad.setScanRates(setup.activeInterval, setup.idleInterval, setup.idleDelay);
+    if (setup.pressSamples)
+      keypad.setDebounceSamples(setup.pressSamples, setup.releaseSamples);
+    keypad.setScanBudget(setup.scanBudget);
+    if (setup.interrupts)
+      keypad.enableInterrupts(INT_PIN);
+    simMicros += 1000000;             // let the keypad settle into its idle state before measuring
+    run(keypad, results, 1000000);
+    memset(&results, 0, sizeof(results));
+
+    switch (scenario)
+    {
+      case 0:
+        idleScenario(keypad, results);
+        break;
+      case 1:
+        singleScenario(keypad, results);
+        break;
+      default:
+        multiScenario(keypad, results);
+        break;
+    }
+    printResults(setup.name, scenarioNames[scenario], results);
+  }
+}
+
+
+int main()
+{
+  Wire.begin();
+  Wire.setClock(I2C_CLOCK);                   // the simulated bus runs at this clock with either version of the library
+#ifdef KEYPAD_LINUX_I2CDEV
+  KeypadI2cDev.begin("/dev/null");            // any file will do, SimI2cDev.cpp does the transfers
+#endif
+
+  printf("i2c clock %d kHz, loop() time %d us, debounce time %d ms\n\n", I2C_CLOCK / 1000, LOOP_TIME, KEYPAD_DEBOUNCE_TIME);
+  printf("%-22s %-7s %7s  %9s  %11s  %13s  %5s  %5s  %11s\n",
+         "setup", "", "calls", "trans", "bytes", "bus us", "bus %", "found", "latency ms");
+  printf("%-22s %-7s %7s  %5s %3s  %6s %4s  %7s %5s  %5s  %5s  %5s %5s\n",
+         "", "", "", "avg", "max", "avg", "max", "avg", "max", "", "", "avg", "max");
+  for (uint8_t i = 0; i < sizeof(setups) / sizeof(setups[0]); ++i)
+    benchmark(setups[i]);
+  return 0;
+}
@@ -0,0 +1,1220 @@
+/*
+  KeypadCheck.cpp
+
+  Short Description:
+
+    Runs the I2cKeypad library on a host computer against simulated chips, and checks that it saves
+    the right key events in cases that are easy to break (and hard to try by hand on a real keypad).
+    Each check prints passed or FAILED (with the line of each test that failed), and the program
+    exits with 1 if any check failed.
+
+    Everything runs on a simulated clock, so the results are the same on every run.
+
+    To build and run (from the top folder of the library):
+
+      g++ -std=c++11 -O2 -Wall -Iextras/host -Isrc -o keypad_check \
+          extras/host/KeypadCheck.cpp extras/host/HostArduino.cpp extras/host/SimKeypadChip.cpp \
+          extras/host/SimMcp23008.cpp extras/host/SimMcp23017.cpp extras/host/SimPcf8574.cpp \
+          src/I2cKeypad.cpp src/I2cKeypadManager.cpp src/I2cKeypadCodeMatcher.cpp src/I2cKeypadTrace.cpp
+      ./keypad_check
+
+    To check the Linux version of the library (i2c-dev, see src/I2cKeypadI2cDev.h) against the same simulated
+    chips, add -DKEYPAD_LINUX_I2CDEV, extras/host/SimI2cDev.cpp and src/I2cKeypadI2cDev.cpp. The i2c error check
+    is left out then (its faults come from the simulated Wire library), and a check of the I2C_RDWR transfers is added.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimMcp23008.h"
+#include "SimMcp23017.h"
+#include "SimPcf8574.h"
+#include "I2cKeypad.h"
+#include "I2cKeypadManager.h"
+#include "I2cKeypadT.h"
+#include "I2cKeypadCodeMatcher.h"
+#include <string>
+#include <vector>
+
+#define KEYPAD_ADDRESS 0x20           // i2c address of the first simulated chip
+#define I2C_CLOCK 400000              // i2c clock rate (Hz)
+#define KEYPAD_ROWS 4
+#define KEYPAD_COLUMNS 4
+#define KEYPAD_DEBOUNCE_TIME 20       // milliseconds
+#define LOOP_TIME 100                 // microseconds that the rest of loop() takes, between scanKeys() calls
+
+// check a condition, and count it as a failure of the check being run if it is false
+#define CHECK(condition) do { if (!(condition)) { printf("    line %d: %s\n", __LINE__, #condition); ++failures; } } while (0)
+
+char keyMap[KEYPAD_ROWS][KEYPAD_COLUMNS] = {
+  {'1', '2', '3', 'A'},
+  {'4', '5', '6', 'B'},
+  {'7', '8', '9', 'C'},
+  {'0', '-', '.', 'E'}
+};
+uint8_t rowPins[KEYPAD_ROWS] = {0, 1, 2, 3};
+uint8_t colPins[KEYPAD_COLUMNS] = {4, 5, 6, 7};
+
+SimMcp23008 chip;                     // the chip at KEYPAD_ADDRESS
+SimMcp23008 secondChip;               // the chip at KEYPAD_ADDRESS + 1 (for the manager)
+SimMcp23017 mcp23017;
+SimPcf8574 pcf8574(8);
+SimPcf8574 pcf8575(16);
+int failures;                         // failures in the check being run
+
+
+// call scanKeys() like loop() would, for ms milliseconds
+void run(I2cKeypad &keypad, unsigned long ms)
+{
+  uint64_t end = simMicros + ms * 1000ULL;
+  while (simMicros < end)
+  {
+    keypad.scanKeys();
+    simMicros += LOOP_TIME;
+  }
+}
+
+// call the manager's update() like loop() would, for ms milliseconds
+void run(I2cKeypadManager &manager, unsigned long ms)
+{
+  uint64_t end = simMicros + ms * 1000ULL;
+  while (simMicros < end)
+  {
+    manager.update();
+    simMicros += LOOP_TIME;
+  }
+}
+
+// press (or release) a key on a simulated chip
+void press(SimKeypadChip &keypadChip, uint8_t row, uint8_t col, bool down)
+{
+  keypadChip.press(rowPins[row], colPins[col], down);
+}
+
+// run one whole scan (once it is due), and return the number of i2c transactions it took
+unsigned long scanTransactions(I2cKeypad &keypad)
+{
+  simMicros += keypad.timeUntilNextScan() * 1000UL + LOOP_TIME;
+  unsigned long transactions = Wire.transactions;
+  keypad.scanKeys();
+  return Wire.transactions - transactions;
+}
+
+// put both chips back to their power on state, with no keys down
+void resetChips(void)
+{
+  chip.powerOnReset();
+  chip.releaseAll();
+  secondChip.powerOnReset();
+  secondChip.releaseAll();
+}
+
+
+// the manager returns the keys from all of the keypads in the order they were pressed, and skips the release
+// events (KEYPAD_SCAN_MATRIX saves them in the same buffers as the presses)
+void checkManager(void)
+{
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_MATRIX; ++scanMode)
+  {
+    resetChips();
+    I2cKeypad first((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, scanMode);
+    I2cKeypad second((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS + 1, scanMode);
+    I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> firstMatrix, secondMatrix;
+    first.setMatrix(&firstMatrix);
+    second.setMatrix(&secondMatrix);
+    I2cKeypadManager manager(10);
+    manager.addKeypad(first);
+    manager.addKeypad(second);
+    manager.begin(I2C_CLOCK);
+
+    // one key pressed and released on each keypad, then a key held on the first keypad
+    press(chip, 0, 0, true);
+    run(manager, 100);
+    press(chip, 0, 0, false);
+    run(manager, 100);
+    press(secondChip, 1, 1, true);
+    run(manager, 100);
+    press(secondChip, 1, 1, false);
+    run(manager, 100);
+    press(chip, 2, 2, true);
+    run(manager, 100);
+
+    uint8_t source = KEYPAD_MANAGER_FULL;
+    CHECK(manager.getKeyCount() == 3);
+    CHECK(manager.peekKey(&source) == '1' && source == 0);
+    CHECK(manager.getKey(&source) == '1' && source == 0);
+    CHECK(manager.getKeyCount() == 2);
+    CHECK(manager.getKey(&source) == '5' && source == 1);
+    CHECK(manager.getKey(&source) == '9' && source == 0);
+    CHECK(manager.getKeyCount() == 0);
+    CHECK(manager.getKey() == RETURN_NO_KEY_IN_BUFFER);
+
+    // the release of the held key is saved (with KEYPAD_SCAN_MATRIX), but it is not a key
+    press(chip, 2, 2, false);
+    run(manager, 100);
+    CHECK(manager.getKeyCount() == 0);
+    CHECK(first.getKeyCount() == 0);
+    CHECK(manager.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  }
+}
+
+
+// the manager scans each keypad only as often as its own scan rate allows, and merges the keys by the time they were
+// saved, even when some of them were already read from the keypad itself
+void checkManagerSchedule(void)
+{
+  resetChips();
+  I2cKeypad first((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  I2cKeypad second((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS + 1);
+  I2cKeypadManager manager(10);
+  manager.addKeypad(first);
+  manager.addKeypad(second);
+  first.setScanRates(50, 50, 0);
+  manager.begin(I2C_CLOCK);
+  run(manager, 100);
+
+  // idle for a second: a quick check every 50 ms on the first keypad, and every 20 ms (the debounce time) on the second
+  unsigned long transactions = Wire.transactions;
+  run(manager, 1000);
+  CHECK(Wire.transactions - transactions >= 68 && Wire.transactions - transactions <= 72);
+
+  // keys 1, 5 and 9 from the first, second and first keypad, and the first keypad's own getKey() takes the 1
+  press(chip, 0, 0, true);
+  run(manager, 100);
+  press(chip, 0, 0, false);
+  run(manager, 100);
+  press(secondChip, 1, 1, true);
+  run(manager, 100);
+  press(secondChip, 1, 1, false);
+  run(manager, 100);
+  press(chip, 2, 2, true);
+  run(manager, 100);
+  press(chip, 2, 2, false);
+  run(manager, 100);
+  CHECK(first.getKey() == '1');
+  uint8_t source = KEYPAD_MANAGER_FULL;
+  CHECK(manager.getKeyCount() == 2);
+  CHECK(manager.getKey(&source) == '5' && source == 1);
+  CHECK(manager.getKey(&source) == '9' && source == 0);
+  CHECK(manager.getKey() == RETURN_NO_KEY_IN_BUFFER);
+}
+
+
+// a manager with a keypad in interrupt mode that has no keys down only wakes up for the other keypad's scans,
+// and sleeps until the INT pin when every keypad is waiting for it
+void checkManagerIdle(void)
+{
+  resetChips();
+  chip.connectInterruptPin(2);
+  I2cKeypad first((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  I2cKeypad second((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS + 1);
+  I2cKeypadManager manager(10);
+  manager.addKeypad(first);
+  manager.addKeypad(second);
+  manager.begin(I2C_CLOCK);
+  first.enableInterrupts(2);
+  run(manager, 100);
+
+  // sleep for timeUntilNextScan() between calls, for a second: only the second keypad's 50 scans wake the loop up
+  unsigned long updates = 0;
+  uint64_t end = simMicros + 1000000;
+  while (simMicros < end)
+  {
+    uint16_t waitTime = manager.timeUntilNextScan();
+    CHECK(waitTime != KEYPAD_NO_SCAN_SCHEDULED);
+    simMicros += waitTime * 1000ULL + LOOP_TIME;
+    manager.update();
+    ++updates;
+  }
+  CHECK(updates >= 45 && updates <= 55);
+
+  // both keypads in interrupt mode (the second one without an INT pin, see interruptReceived()): nothing is
+  //    scheduled until the first keypad's INT pin goes low, and then it is scanned in its next slot
+  second.enableInterrupts();
+  run(manager, 100);
+  CHECK(manager.timeUntilNextScan() == KEYPAD_NO_SCAN_SCHEDULED);
+  unsigned long transactions = Wire.transactions;
+  run(manager, 1000);
+  CHECK(Wire.transactions == transactions);
+  press(chip, 1, 2, true);
+  CHECK(manager.timeUntilNextScan() <= 10);
+  run(manager, 100);
+  CHECK(manager.getKey() == '6');
+  press(chip, 1, 2, false);
+  run(manager, 100);
+  chip.connectInterruptPin(-1);
+}
+
+
+// the keypad's own buffer is part of the keypad (nothing comes from the heap), it can be swapped for another queue,
+// and a copy of a keypad gets its own empty buffer
+void checkEventQueue(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  I2cKeypadEventBuffer<16> ownBuffer;
+  keypad.begin(I2C_CLOCK);
+
+  const char *queue = (const char *)&keypad.getEventQueue();
+  CHECK(queue >= (const char *)&keypad && queue < (const char *)(&keypad + 1));   // the buffer is part of the keypad
+  CHECK(keypad.getEventQueue().capacity() == KEYPAD_BUFFER_SIZE);
+  press(chip, 0, 0, true);
+  run(keypad, 100);
+  press(chip, 0, 0, false);
+  run(keypad, 100);
+  I2cKeypad copy(keypad);
+  CHECK(&copy.getEventQueue() != &keypad.getEventQueue() && copy.getKeyCount() == 0);
+  CHECK(keypad.getKey() == '1');
+
+
+  keypad.setEventQueue(ownBuffer);
+  CHECK(&keypad.getEventQueue() == &ownBuffer);
+  press(chip, 3, 3, true);
+  run(keypad, 100);
+  press(chip, 3, 3, false);
+  run(keypad, 100);
+  CHECK(ownBuffer.count() == 1);
+  CHECK(keypad.getKey() == 'E');
+}
+
+
+// the queue's 8 bit head and tail counts wrap around at 256, and a full queue either throws away the new event or
+// (with KEYPAD_OVERFLOW_DROP_OLDEST, unless push() is called from an interrupt) the oldest one
+void checkEventRing(void)
+{
+  I2cKeypadEventBuffer<128> ring;
+  KeypadEvent event = {};
+  uint16_t pushed = 0;
+  uint16_t popped = 0;
+
+  for (; pushed < 128; ++pushed)
+  {
+    event.time = pushed;
+    CHECK(ring.push(event));
+  }
+  CHECK(ring.count() == 128);
+  for (int i = 0; i < 300; ++i)     // stays full while the counts wrap around
+  {
+    CHECK(ring.pop(event) && event.time == popped++);
+    event.time = pushed++;
+    CHECK(ring.push(event));
+    CHECK(ring.count() == 128);
+  }
+  CHECK(ring.peek(127, event) && event.time == pushed - 1u && !ring.peek(128, event));
+  event.time = pushed;
+  CHECK(!ring.push(event) && ring.getDroppedCount() == 1);   // KEYPAD_OVERFLOW_DROP_NEWEST is the default
+  CHECK(ring.peek(event) && event.time == popped);
+
+  ring.setOverflowPolicy(KEYPAD_OVERFLOW_DROP_OLDEST);
+  event.time = pushed;
+  CHECK(!ring.push(event) && ring.getDroppedCount() == 2 && ring.count() == 128);
+  CHECK(ring.peek(event) && event.time == popped + 1u);
+  CHECK(ring.peek(127, event) && event.time == pushed);
+
+  ring.setInterruptWriter(true);    // only the reader may move the tail, so the new event is thrown away
+  event.time = pushed + 1u;
+  CHECK(!ring.push(event) && ring.getDroppedCount() == 3);
+  CHECK(ring.peek(event) && event.time == popped + 1u);
+  CHECK(ring.peek(127, event) && event.time == pushed);
+
+  ring.resetDroppedCount();
+  CHECK(ring.getDroppedCount() == 0);
+  ring.flush();
+  CHECK(ring.count() == 0 && !ring.pop(event));
+}
+
+
+// press and release each key by itself, and (with KEYPAD_SCAN_MATRIX) hold pairs of keys down together, and
+// return the events the keypad saved (key, row, column and type of each one) and the number of i2c transactions
+std::string keyEvents(I2cKeypad &keypad, SimKeypadChip &keypadChip, const uint8_t *pins, uint8_t rowNum, uint8_t colNum,
+                      uint8_t scanMode)
+{
+  std::string events;
+  KeypadEvent event;
+  unsigned long transactions = Wire.transactions;
+
+  keypadChip.powerOnReset();
+  keypadChip.releaseAll();
+  simMicros = (simMicros / 1000 + 1) * 1000;    // start on a millisecond, so each keypad's scans line up with millis() the same way
+  keypad.begin(I2C_CLOCK);
+  for (uint8_t key = 0; key < rowNum * colNum; ++key)
+  {
+    const uint8_t *rowPin = &pins[key / colNum];
+    const uint8_t *colPin = &pins[rowNum + key % colNum];
+    uint8_t other = (key + colNum + 1) % (rowNum * colNum);     // a key in another row and column
+    keypadChip.press(*rowPin, *colPin, true);
+    run(keypad, 60);
+    if (scanMode == KEYPAD_SCAN_MATRIX)
+    {
+      keypadChip.press(pins[other / colNum], pins[rowNum + other % colNum], true);
+      run(keypad, 60);
+      keypadChip.press(pins[other / colNum], pins[rowNum + other % colNum], false);
+    }
+    keypadChip.press(*rowPin, *colPin, false);
+    run(keypad, 60);
+    while (keypad.getEvent(event))
+    {
+      events += (char)event.key;
+      events += (char)('0' + event.row);
+      events += (char)('0' + event.col);
+      events += (char)('0' + event.type);
+      events += ' ';
+    }
+  }
+  return events + std::to_string(Wire.transactions - transactions);
+}
+
+// check that a I2cKeypadT saves the same events as a I2cKeypad with the same layout (using the same number of
+// i2c transactions), in each scan mode. The template parameters are the ones for the I2cKeypadT.
+template <uint8_t Rows, uint8_t Cols, uint8_t... Pins>
+void compareLayout(SimKeypadChip &keypadChip, uint8_t chipType, const char *flashKeyMap)
+{
+  uint8_t pins[] = {Pins...};
+
+  Wire.attach(KEYPAD_ADDRESS, &keypadChip);
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_MATRIX; ++scanMode)
+  {
+    I2cKeypad keypad((char *)flashKeyMap, pins, pins + Rows, Rows, Cols, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, scanMode, chipType);
+    I2cKeypadT<Rows, Cols, Pins...> templateKeypad(flashKeyMap, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, scanMode, chipType);
+    I2cKeypadMatrixBuffer<Rows, Cols> matrix, templateMatrix;
+    keypad.setMatrix(&matrix);
+    templateKeypad.setMatrix(&templateMatrix);
+    std::string expected = keyEvents(keypad, keypadChip, pins, Rows, Cols, scanMode);
+    std::string found = keyEvents(templateKeypad, keypadChip, pins, Rows, Cols, scanMode);
+    CHECK(expected.size() > Rows * Cols * 5);
+    CHECK(found == expected);
+  }
+  Wire.attach(KEYPAD_ADDRESS, &chip);
+}
+
+// I2cKeypadT works out its pin tables when it is compiled, and must find the same keys as I2cKeypad does with its arrays
+const char keys4x4[] PROGMEM = "123A456B789C0-.E";
+const char keys4x3[] PROGMEM = "123456789*0#";
+const char keys8x8[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+-";
+
+void checkTemplateKeypad(void)
+{
+  compareLayout<4, 4, 0, 1, 2, 3, 4, 5, 6, 7>(chip, KEYPAD_MCP23008, keys4x4);
+  compareLayout<4, 3, 6, 1, 4, 3, 0, 7, 2>(chip, KEYPAD_MCP23008, keys4x3);           // pins in any order
+  compareLayout<4, 4, 3, 2, 1, 0, 7, 6, 5, 4>(pcf8574, KEYPAD_PCF8574, keys4x4);
+  compareLayout<8, 8, 15, 8, 13, 10, 11, 12, 9, 14, 0, 7, 2, 5, 4, 3, 6, 1>(mcp23017, KEYPAD_MCP23017, keys8x8);
+  compareLayout<4, 4, 0, 9, 2, 11, 12, 5, 14, 7>(pcf8575, KEYPAD_PCF8575, keys4x4);  // rows and columns in both bytes of the port
+}
+
+
+// wait for the next event from the keypad, for up to ms milliseconds, and return how long it took (in ms, or ms + 1 if
+// there was no event)
+unsigned long waitForEvent(I2cKeypad &keypad, KeypadEvent &event, unsigned long ms)
+{
+  for (unsigned long waited = 0; waited <= ms; ++waited)
+  {
+    if (keypad.getEvent(event))
+      return waited;
+    run(keypad, 1);
+  }
+  return ms + 1;
+}
+
+// with KEYPAD_SCAN_MATRIX each key is debounced by itself: a key that keeps bouncing must not hold up the other keys,
+// and keys pressed at different times are each accepted one debounce time after their own press
+void checkMatrixDebounce(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, KEYPAD_SCAN_MATRIX);
+  I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> matrix;
+  KeypadEvent event;
+  keypad.setMatrix(&matrix);
+  keypad.setScanRates(2, 2, 0);       // scan often enough to see the bounces
+  keypad.begin(I2C_CLOCK);
+
+  press(chip, 0, 0, true);
+  CHECK(waitForEvent(keypad, event, 100) <= KEYPAD_DEBOUNCE_TIME + 2);
+  CHECK(event.key == '1' && event.type == KEY_EVENT_PRESSED);
+
+  // key 5 bounces every 5 ms for 200 ms, and key 1 is released in the middle of it
+  unsigned long releaseTime = 0;      // ms from the release of key 1 to its event
+  uint8_t eventCount = 0;
+  for (uint8_t bounce = 0; bounce < 40; ++bounce)
+  {
+    press(chip, 1, 1, bounce % 2 == 0);
+    if (bounce == 10)
+      press(chip, 0, 0, false);
+    for (uint8_t ms = 0; ms < 5; ++ms)
+    {
+      run(keypad, 1);
+      if (keypad.getEvent(event))
+      {
+        ++eventCount;
+        releaseTime = (bounce - 10) * 5 + ms + 1;
+        CHECK(event.key == '1' && event.type == KEY_EVENT_RELEASED);
+      }
+    }
+  }
+  CHECK(eventCount == 1);
+  CHECK(releaseTime >= KEYPAD_DEBOUNCE_TIME - 2 && releaseTime <= KEYPAD_DEBOUNCE_TIME + 4);   // give or take a scan
+
+  // key 5 stops bouncing while it is up, and then stays down
+  press(chip, 1, 1, true);
+  CHECK(waitForEvent(keypad, event, 100) >= KEYPAD_DEBOUNCE_TIME - 4);
+  CHECK(event.key == '5' && event.type == KEY_EVENT_PRESSED);
+
+  // keys 9 and E are pressed 10 ms apart, and each one waits for its own debounce time
+  press(chip, 2, 2, true);
+  run(keypad, 10);
+  press(chip, 3, 3, true);
+  CHECK(waitForEvent(keypad, event, 100) <= KEYPAD_DEBOUNCE_TIME - 10 + 2);
+  CHECK(event.key == '9' && event.type == KEY_EVENT_PRESSED);
+  CHECK(waitForEvent(keypad, event, 100) <= 12);
+  CHECK(event.key == 'E' && event.type == KEY_EVENT_PRESSED);
+  CHECK(!keypad.getEvent(event));
+}
+
+
+// call scanKeys() for ms milliseconds, and add the events it saves to events (the release events are left out)
+void collectEvents(I2cKeypad &keypad, unsigned long ms, std::vector<KeypadEvent> &events)
+{
+  KeypadEvent event;
+  uint64_t end = simMicros + ms * 1000ULL;
+  while (simMicros < end)
+  {
+    run(keypad, 1);
+    while (keypad.getEvent(event))
+    {
+      if (event.type != KEY_EVENT_RELEASED)
+        events.push_back(event);
+    }
+  }
+}
+
+// a held key repeats every repeat rate after the repeat delay, skips the repeats it missed when the scans were late
+// instead of saving them all at once, and has one long press each time it is pressed. With KEYPAD_SCAN_MATRIX only the
+// last key pressed repeats.
+void checkRepeat(void)
+{
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_MATRIX; ++scanMode)
+  {
+    resetChips();
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, scanMode);
+    I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> matrix;
+    std::vector<KeypadEvent> events;
+    keypad.setMatrix(&matrix);
+    keypad.setScanRates(2, 2, 0);
+    keypad.setRepeat(500, 100, "123");
+    keypad.setLongPress(1000, "1");
+    keypad.begin(I2C_CLOCK);
+
+    // key 1 held for 1.5 seconds: the press, 10 repeats 100 ms apart starting 500 ms after it, and a long press at 1 second
+    press(chip, 0, 0, true);
+    collectEvents(keypad, 1500, events);
+    uint8_t repeats = 0;
+    uint8_t longPresses = 0;
+    CHECK(events.size() == 12 && events[0].key == '1' && events[0].type == KEY_EVENT_PRESSED);
+    for (size_t i = 1; i < events.size(); ++i)
+    {
+      unsigned long held = (events[i].time - events[0].time) / 1000;
+      CHECK(events[i].key == '1');
+      if (events[i].type == KEY_EVENT_LONG_PRESS)
+      {
+        ++longPresses;
+        CHECK(held >= 1000 && held <= 1003);
+      }
+      else
+      {
+        CHECK(events[i].type == KEY_EVENT_REPEAT);
+        CHECK(held >= 500 + repeats * 100UL && held <= 503 + repeats * 100UL);
+        ++repeats;
+      }
+    }
+    CHECK(repeats == 10 && longPresses == 1);
+
+    // the loop is busy for 350 ms: one repeat when the scans start again, then back on the 100 ms steps
+    unsigned long pressTime = events[0].time / 1000;
+    events.clear();
+    simMicros += 350000;
+    collectEvents(keypad, 200, events);
+    CHECK(events.size() == 3);
+    for (size_t i = 0; i < events.size(); ++i)
+      CHECK(events[i].key == '1' && events[i].type == KEY_EVENT_REPEAT);
+    if (events.size() == 3)
+    {
+      CHECK(events[0].time / 1000 - pressTime <= 1852);
+      CHECK(events[1].time / 1000 - pressTime >= 1900 && events[1].time / 1000 - pressTime <= 1903);
+    }
+
+    // key 4 doesn't repeat, and key 1 has another long press after it is pressed again
+    press(chip, 0, 0, false);
+    run(keypad, 100);
+    press(chip, 1, 0, true);
+    events.clear();
+    collectEvents(keypad, 1000, events);
+    CHECK(events.size() == 1 && events[0].key == '4' && events[0].type == KEY_EVENT_PRESSED);
+    press(chip, 1, 0, false);
+    run(keypad, 100);
+    press(chip, 0, 0, true);
+    events.clear();
+    collectEvents(keypad, 1100, events);
+    CHECK(events.size() == 8 && events[6].type == KEY_EVENT_LONG_PRESS);
+
+    if (scanMode != KEYPAD_SCAN_MATRIX)
+      continue;
+
+    // key 2 pressed while key 1 is held: key 2 repeats, and key 1 doesn't start again when key 2 is released
+    // (key 2 is still down until its release is debounced, so it may repeat once more before that)
+    press(chip, 0, 1, true);
+    events.clear();
+    collectEvents(keypad, 700, events);
+    CHECK(events.size() == 3 && events[0].key == '2' && events[0].type == KEY_EVENT_PRESSED);
+    for (size_t i = 1; i < events.size(); ++i)
+      CHECK(events[i].key == '2' && events[i].type == KEY_EVENT_REPEAT);
+    press(chip, 0, 1, false);
+    events.clear();
+    collectEvents(keypad, KEYPAD_DEBOUNCE_TIME + 5, events);
+    CHECK(events.size() <= 1);
+    events.clear();
+    collectEvents(keypad, 1000, events);
+    CHECK(events.empty());
+  }
+}
+
+
+// peekKey() leaves the events in front of the next key in the buffer (for getEvent()), and getKey() throws them away
+void checkPeekKey(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS, KEYPAD_SCAN_MATRIX);
+  I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> matrix;
+  KeypadEvent event;
+  keypad.setMatrix(&matrix);
+  keypad.begin(I2C_CLOCK);
+
+  // key 1 pressed and released, then key 5 pressed: the buffer holds PRESSED 1, RELEASED 1, PRESSED 5
+  press(chip, 0, 0, true);
+  run(keypad, 100);
+  press(chip, 0, 0, false);
+  run(keypad, 100);
+  press(chip, 1, 1, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '1');
+  CHECK(keypad.peekKey() == '5');
+  CHECK(keypad.peekKey() == '5');
+  CHECK(keypad.getKeyCount() == 1);
+  CHECK(keypad.getEvent(event) && event.key == '1' && event.type == KEY_EVENT_RELEASED);
+  CHECK(keypad.getEvent(event) && event.key == '5' && event.type == KEY_EVENT_PRESSED);
+
+  // a release with no key after it is left there by peekKey(), and thrown away by getKey()
+  press(chip, 1, 1, false);
+  run(keypad, 100);
+  CHECK(keypad.peekKey() == RETURN_NO_KEY_IN_BUFFER);
+  CHECK(keypad.getEvent(event) && event.key == '5' && event.type == KEY_EVENT_RELEASED);
+  press(chip, 1, 1, true);
+  run(keypad, 100);
+  press(chip, 1, 1, false);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '5');
+  CHECK(keypad.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  CHECK(!keypad.getEvent(event));
+}
+
+
+// KEYPAD_SCAN_LINE_REVERSAL finds any key in the same few transactions (getMaxScanSteps(), less the chip check that
+// is off by default), while KEYPAD_SCAN_COLUMNS takes some for each column
+void checkLineReversal(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS,
+                   KEYPAD_SCAN_LINE_REVERSAL);
+  I2cKeypad columns((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.begin(I2C_CLOCK);
+  columns.begin(I2C_CLOCK);
+  uint8_t keySteps = keypad.getMaxScanSteps() - 1;
+  CHECK(keySteps < columns.getMaxScanSteps() - 1);
+  CHECK(scanTransactions(keypad) == 1);     // no key down: only the quick check
+
+  for (uint8_t row = 0; row < KEYPAD_ROWS; ++row)
+  {
+    for (uint8_t col = 0; col < KEYPAD_COLUMNS; ++col)
+    {
+      press(chip, row, col, true);
+      CHECK(scanTransactions(keypad) == keySteps);
+      run(keypad, 100);
+      CHECK(keypad.getKey() == (uint8_t)keyMap[row][col]);
+      press(chip, row, col, false);
+      run(keypad, 100);
+    }
+  }
+
+  // two keys in one row can't be told apart from ghosting, so neither is saved
+  press(chip, 1, 0, true);
+  press(chip, 1, 3, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  chip.releaseAll();
+  run(keypad, 100);
+
+  press(chip, 1, 0, true);
+  CHECK(scanTransactions(columns) == columns.getMaxScanSteps() - 1u);
+  press(chip, 1, 0, false);
+  run(columns, 100);
+}
+
+
+// with setDebounceSamples(4, 3) a key is saved by the 4th scan in a row that finds it and released by the 3rd scan
+// in a row that does not, however close together the scans are, and a key found by only 3 scans is not saved
+void checkDebounceSamples(void)
+{
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_MATRIX; ++scanMode)
+  {
+    resetChips();
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS,
+                     scanMode);
+    I2cKeypadMatrixBuffer<KEYPAD_ROWS, KEYPAD_COLUMNS> matrix;
+    keypad.setMatrix(&matrix);
+    keypad.begin(I2C_CLOCK);
+    keypad.setScanRates(2, 2, 0);
+    keypad.setDebounceSamples(4, 3);
+    KeypadEvent event;
+
+    press(chip, 2, 1, true);
+    for (uint8_t scan = 1; scan <= 3; ++scan)
+    {
+      scanTransactions(keypad);
+      CHECK(keypad.getKeyCount() == 0);
+    }
+    scanTransactions(keypad);
+    CHECK(keypad.getEvent(event) && event.key == '8' && event.type == KEY_EVENT_PRESSED);
+
+    // up for 2 scans is a bounce, so pressing the key again is not a new press
+    press(chip, 2, 1, false);
+    scanTransactions(keypad);
+    scanTransactions(keypad);
+    press(chip, 2, 1, true);
+    for (uint8_t scan = 1; scan <= 4; ++scan)
+      scanTransactions(keypad);
+    CHECK(keypad.getKeyCount() == 0);
+
+    // up for 3 scans releases it (which only KEYPAD_SCAN_MATRIX saves as an event), so it can be pressed again
+    press(chip, 2, 1, false);
+    for (uint8_t scan = 1; scan <= 3; ++scan)
+      scanTransactions(keypad);
+    if (scanMode == KEYPAD_SCAN_MATRIX)
+      CHECK(keypad.getEvent(event) && event.key == '8' && event.type == KEY_EVENT_RELEASED);
+    CHECK(keypad.getKeyCount() == 0);
+    press(chip, 2, 1, true);
+    for (uint8_t scan = 1; scan <= 4; ++scan)
+      scanTransactions(keypad);
+    CHECK(keypad.getEvent(event) && event.key == '8' && event.type == KEY_EVENT_PRESSED);
+    press(chip, 2, 1, false);
+    run(keypad, 100);
+    keypad.flushKeys();
+
+    press(chip, 0, 2, true);
+    for (uint8_t scan = 1; scan <= 3; ++scan)
+      scanTransactions(keypad);
+    press(chip, 0, 2, false);
+    for (uint8_t scan = 1; scan <= 4; ++scan)
+      scanTransactions(keypad);
+    CHECK(keypad.getKeyCount() == 0);
+  }
+}
+
+
+// with a scan budget of 1, each scanKeys() call does one i2c transaction, and the next call carries on with the scan
+// from there, so a key is found in the same number of transactions as a scan done in one call
+void checkScanBudget(void)
+{
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_LINE_REVERSAL; ++scanMode)
+  {
+    resetChips();
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS,
+                     scanMode);
+    keypad.begin(I2C_CLOCK);
+    keypad.setScanBudget(1);
+    CHECK(scanTransactions(keypad) == 1);     // no key down: the quick check finishes the scan
+
+    for (uint8_t key = 0; key < KEYPAD_ROWS * KEYPAD_COLUMNS; key += 5)
+    {
+      press(chip, key / KEYPAD_COLUMNS, key % KEYPAD_COLUMNS, true);
+      simMicros += keypad.timeUntilNextScan() * 1000UL;
+      unsigned long transactions = Wire.transactions;
+      uint8_t calls = 1;
+      for (; !keypad.scanKeys(); ++calls)
+      {
+        CHECK(Wire.transactions - transactions == calls);
+        CHECK(keypad.timeUntilNextScan() == 0);   // the rest of the scan is not put off
+        simMicros += LOOP_TIME;
+      }
+      CHECK(calls == keypad.getMaxScanSteps() - 1u && Wire.transactions - transactions == calls);
+      run(keypad, 100);
+      CHECK(keypad.getKey() == (uint8_t)keyMap[key / KEYPAD_COLUMNS][key % KEYPAD_COLUMNS]);
+      CHECK(keypad.getKeyCount() == 0);
+      press(chip, key / KEYPAD_COLUMNS, key % KEYPAD_COLUMNS, false);
+      run(keypad, 100);
+    }
+  }
+}
+
+
+// the library keeps a copy of the chip registers, so an idle scan is one read, and a scan that finds a key does not
+// read a register before changing it. resyncRegisters() writes the copy back into a chip that lost its registers.
+void checkRegisterShadow(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.begin(I2C_CLOCK);
+  CHECK(scanTransactions(keypad) == 1);
+
+  // a key down: the quick check, a write and a read for each column, and the write that puts the columns back
+  // (getMaxScanSteps() also counts the chip check, which is off)
+  press(chip, 2, 2, true);
+  CHECK(scanTransactions(keypad) == keypad.getMaxScanSteps() - 1u);
+  run(keypad, 100);
+  press(chip, 2, 2, false);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '9');
+  CHECK(scanTransactions(keypad) == 1);
+
+  // the chip's registers are lost (the copy in the library still has them): resyncRegisters() puts them all back
+  chip.powerOnReset();
+  unsigned long transactions = Wire.transactions;
+  keypad.resyncRegisters();
+  CHECK(Wire.transactions - transactions == 2);      // IOCON, then the rest in one transaction
+  CHECK(chip.registers[SIM_IOCON] == MCP_IOCON_VALUE);
+  CHECK(chip.registers[SIM_IODIR] == 0x0f && chip.registers[SIM_GPPU] == 0xff && chip.registers[SIM_OLAT] == 0);
+  CHECK(scanTransactions(keypad) == 1);
+  press(chip, 0, 3, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == 'A');
+  press(chip, 0, 3, false);
+  run(keypad, 100);
+}
+
+
+// calibrateSettleTime() finds a settle time long enough for slow pullups, so every key is read right, and gives up
+// (without changing the settle time) when a key is down
+void checkSettleTime(void)
+{
+  resetChips();
+  chip.riseTime = 300;
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.begin(I2C_CLOCK);
+  CHECK(keypad.calibrateSettleTime());
+  uint16_t settleTime = keypad.getSettleTime();
+  CHECK(settleTime >= chip.riseTime && settleTime <= 4 * chip.riseTime);
+
+  for (uint8_t row = 0; row < KEYPAD_ROWS; ++row)
+  {
+    for (uint8_t col = 0; col < KEYPAD_COLUMNS; ++col)
+    {
+      press(chip, row, col, true);
+      run(keypad, 100);
+      press(chip, row, col, false);
+      run(keypad, 100);
+      CHECK(keypad.getKey() == (uint8_t)keyMap[row][col]);
+      CHECK(keypad.getKeyCount() == 0);
+    }
+  }
+
+  press(chip, 2, 2, true);
+  CHECK(!keypad.calibrateSettleTime());
+  CHECK(keypad.getSettleTime() == settleTime);
+  press(chip, 2, 2, false);
+  chip.riseTime = 0;
+}
+
+
+// a reset PCF8574 lets go of the pins it was driving low, so the keypad reads as idle: the chip check finds that a
+// driven pin reads high, and drives the pins again, so keys are found again
+void checkPcfReset(void)
+{
+  Wire.attach(KEYPAD_ADDRESS, &pcf8574);
+  pcf8574.powerOnReset();
+  pcf8574.releaseAll();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS,
+                   KEYPAD_SCAN_COLUMNS, KEYPAD_PCF8574);
+  keypad.begin(I2C_CLOCK);
+  run(keypad, 100);
+  uint16_t port = pcf8574.port;
+
+  // without the chip check, the reset chip misses the key
+  pcf8574.powerOnReset();
+  CHECK(pcf8574.port != port);
+  press(pcf8574, 1, 2, true);
+  run(keypad, 1000);
+  CHECK(keypad.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  press(pcf8574, 1, 2, false);
+
+  keypad.setChipCheckInterval(200);
+  run(keypad, 250);
+  CHECK(pcf8574.port == port);
+  press(pcf8574, 1, 2, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '6');
+  press(pcf8574, 1, 2, false);
+  run(keypad, 100);
+
+  pcf8574.powerOnReset();
+  press(pcf8574, 3, 0, true);
+  run(keypad, 300);
+  CHECK(keypad.getKey() == '0');
+  press(pcf8574, 3, 0, false);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  Wire.attach(KEYPAD_ADDRESS, &chip);
+}
+
+
+#ifdef KEYPAD_LINUX_I2CDEV
+// on Linux each column is driven and read in one I2C_RDWR transfer, unless the settle time is too long to fit in the read
+void checkCombinedTransfers(void)
+{
+  for (uint8_t scanMode = KEYPAD_SCAN_COLUMNS; scanMode <= KEYPAD_SCAN_LINE_REVERSAL; ++scanMode)
+  {
+    resetChips();
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS,
+                     scanMode);
+    keypad.begin(I2C_CLOCK);
+    uint8_t lines = scanMode == KEYPAD_SCAN_COLUMNS ? KEYPAD_COLUMNS : 1;
+    CHECK(keypad.getMaxScanSteps() == 3 + lines);
+    keypad.setSettleTime(500);
+    CHECK(keypad.getMaxScanSteps() == 3 + 2 * lines);
+    keypad.setSettleTime(KEYPAD_SETTLE_TIME);
+
+    for (uint8_t row = 0; row < KEYPAD_ROWS; ++row)
+    {
+      for (uint8_t col = 0; col < KEYPAD_COLUMNS; ++col)
+      {
+        press(chip, row, col, true);
+        CHECK(scanTransactions(keypad) == 2u + lines);    // the quick check, a transfer for each line, and the restore
+        run(keypad, 100);
+        CHECK(keypad.getKey() == (uint8_t)keyMap[row][col]);
+        press(chip, row, col, false);
+        run(keypad, 100);
+      }
+    }
+  }
+}
+#endif
+
+
+// begin() writes IOCON (which turns on sequential mode), and then every register in one transaction. This works even
+// if other code left the chip in byte mode, where the address pointer does not move on after each byte.
+void checkBurstWrites(void)
+{
+  for (int byteMode = 0; byteMode < 2; ++byteMode)
+  {
+    resetChips();
+    memset(chip.registers, 0x55, sizeof(chip.registers));
+    chip.registers[SIM_IOCON] = byteMode ? SIM_IOCON_SEQOP : 0;
+    I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+    unsigned long transactions = Wire.transactions;
+    unsigned long bytes = Wire.bytes;
+    keypad.begin(I2C_CLOCK);
+    CHECK(Wire.transactions - transactions == 2);
+    CHECK(Wire.bytes - bytes == 3 + 2 + SIM_OLAT + 1);   // address, register, data
+    CHECK(chip.registers[SIM_IOCON] == MCP_IOCON_VALUE);
+    CHECK(chip.registers[SIM_IODIR] == 0x0f && chip.registers[SIM_IPOL] == 0 && chip.registers[SIM_GPINTEN] == 0);
+    CHECK(chip.registers[SIM_DEFVAL] == 0 && chip.registers[SIM_INTCON] == 0);
+    CHECK(chip.registers[SIM_GPPU] == 0xff && chip.registers[SIM_OLAT] == 0);
+    press(chip, 3, 1, true);
+    run(keypad, 100);
+    CHECK(keypad.getKey() == '-');
+    press(chip, 3, 1, false);
+    run(keypad, 100);
+  }
+}
+
+
+// an idle keypad in interrupt mode leaves the i2c bus alone (the chip check is off until setChipCheckInterval() is called)
+void checkIdleBus(void)
+{
+  resetChips();
+  chip.connectInterruptPin(2);
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.begin(I2C_CLOCK);
+  keypad.enableInterrupts(2);
+  run(keypad, 100);
+
+  unsigned long transactions = Wire.transactions;
+  run(keypad, 10000);
+  CHECK(Wire.transactions == transactions);
+  CHECK(keypad.timeUntilNextScan() == KEYPAD_NO_SCAN_SCHEDULED);
+
+  // a key press still wakes it up
+  press(chip, 1, 2, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '6');
+  press(chip, 1, 2, false);
+  run(keypad, 100);
+
+  keypad.setChipCheckInterval(1000);
+  transactions = Wire.transactions;
+  run(keypad, 10000);
+  CHECK(Wire.transactions - transactions >= 10 && Wire.transactions - transactions <= 30);    // one short check a second
+  chip.connectInterruptPin(-1);
+}
+
+
+// enableInterrupts() sets up the row pins to interrupt on change in one transaction, a press wakes the keypad (reading
+// INTF and INTCAP clears the INT pin), and once the key is released the bus is left alone again
+void checkInterruptScan(void)
+{
+  resetChips();
+  chip.connectInterruptPin(2);
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.begin(I2C_CLOCK);
+
+  unsigned long transactions = Wire.transactions;
+  keypad.enableInterrupts(2);
+  CHECK(Wire.transactions - transactions == 1);
+  CHECK(chip.registers[SIM_GPINTEN] == 0x0f && chip.registers[SIM_DEFVAL] == 0 && chip.registers[SIM_INTCON] == 0);
+  run(keypad, 100);
+
+  transactions = Wire.transactions;
+  press(chip, 2, 1, true);
+  CHECK(chip.interruptAsserted());
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '8');
+  press(chip, 2, 1, false);
+  run(keypad, 100);
+  CHECK(!chip.interruptAsserted());
+  CHECK(Wire.transactions - transactions <= 70);      // 100 ms of scans while the key is down, and the release
+  transactions = Wire.transactions;
+  run(keypad, 1000);
+  CHECK(Wire.transactions == transactions);
+  CHECK(keypad.getKey() == RETURN_NO_KEY_IN_BUFFER);
+  chip.connectInterruptPin(-1);
+}
+
+
+#ifndef KEYPAD_LINUX_I2CDEV   // the faults are put on the bus by the simulated Wire library
+// a failed i2c transaction is tried again, the bus is only freed (by clocking SCL) after a timeout or with SDA held low,
+// never after a NACK, and a chip that was reset is set up again
+void checkI2cErrors(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  keypad.setBusRecoveryPins(20, 21);
+  simSdaPin = 20;
+  simSclPin = 21;
+  keypad.begin(I2C_CLOCK);
+  run(keypad, 100);
+  unsigned long ends = Wire.ends;
+
+  // one NACK: the transaction is tried again, and the scan works
+  Wire.failTransactions(1, 2);
+  run(keypad, KEYPAD_DEBOUNCE_TIME + 1);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NONE);
+
+  // a NACK on every try: the scan is given up without touching the bus, and the next scans set the chip up again
+  Wire.failTransactions(3, 2);
+  run(keypad, KEYPAD_DEBOUNCE_TIME + 1);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NACK);
+  CHECK(Wire.ends == ends);
+  run(keypad, 100);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NONE);
+
+  // two timeouts: the bus is freed before the last try, which works
+  Wire.failTransactions(2, 5);
+  run(keypad, KEYPAD_DEBOUNCE_TIME + 1);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NONE);
+  CHECK(Wire.ends == ++ends);
+
+  // a chip holding SDA low lets go after 4 clocks
+  simSdaHeld = 4;
+  run(keypad, KEYPAD_DEBOUNCE_TIME + 1);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NONE);
+  CHECK(Wire.ends == ++ends && simSdaHeld == 0);
+
+  // one that doesn't let go after 9 clocks leaves the bus stuck, until it does
+  simSdaHeld = 20;
+  run(keypad, KEYPAD_DEBOUNCE_TIME + 1);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_BUS_STUCK);
+  CHECK(Wire.ends == ++ends);
+  simSdaHeld = 0;
+  run(keypad, 100);
+  CHECK(keypad.getErrorState() == KEYPAD_ERROR_NONE);
+
+  // the chip is reset (a power glitch): the chip check finds it, and sets it up again so keys work
+  keypad.setChipCheckInterval(100);
+  chip.powerOnReset();
+  run(keypad, 200);
+  press(chip, 1, 2, true);
+  run(keypad, 100);
+  CHECK(keypad.getKey() == '6');
+  press(chip, 1, 2, false);
+  run(keypad, 100);
+  simSdaPin = -1;
+  simSclPin = -1;
+}
+#endif
+
+
+// getKeysUntil() never writes past keys[maxKeys]. With maxKeys of 0 keys only holds the 0 at the end, so the entry is
+// finished right away and the keys are left in the buffer.
+void checkKeysUntil(void)
+{
+  resetChips();
+  I2cKeypad keypad((char *)keyMap, rowPins, colPins, KEYPAD_ROWS, KEYPAD_COLUMNS, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+  char keys[3] = {'x', 'x', 'x'};
+  keypad.begin(I2C_CLOCK);
+
+  press(chip, 0, 1, true);
+  run(keypad, 100);
+  press(chip, 0, 1, false);
+  run(keypad, 100);
+  CHECK(keypad.getKeysUntil(keys, 0, 0, '#') == MAX_NUM_CHARACTERS_REACHED);
+  CHECK(keys[0] == 0 && keys[1] == 'x');
+  CHECK(keypad.getKeyCount() == 1);
+  CHECK(keypad.getKeysUntil(keys, 1, 0, '#') == MAX_NUM_CHARACTERS_REACHED);
+  CHECK(keys[0] == '2' && keys[1] == 0 && keys[2] == 'x');
+}
+
+
+// number of the code the matcher should find after the keys in history (the longest code that history ends with, or
+// with a terminator key, the code that is all of history), found the slow way
+uint8_t expectedCode(const std::vector<std::string> &codes, const std::string &history, bool terminated)
+{
+  uint8_t code = KEYPAD_NO_CODE;
+  size_t codeLength = 0;
+  for (size_t i = 0; i < codes.size(); ++i)
+  {
+    size_t length = codes[i].size();
+    bool found = terminated ? history == codes[i] :
+                 length <= history.size() && history.compare(history.size() - length, length, codes[i]) == 0;
+    if (found && (code == KEYPAD_NO_CODE || length > codeLength))
+    {
+      code = i + 1;
+      codeLength = length;
+    }
+  }
+  return code;
+}
+
+// the code matcher's table finds the same codes as comparing the keys with each code, for random lists of codes
+// (with and without a terminator key), and begin() turns down codes that don't fit
+void checkCodeMatcher(void)
+{
+  const char codeKeys[] = "0123456*";         // keys used in the codes
+  const char typedKeys[] = "0123456*89";      // keys typed ('8' and '9' are not in any code)
+  uint32_t random = 1;                        // simple generator, so the codes are the same on every host
+
+  for (uint8_t round = 0; round < 200; ++round)
+  {
+    std::vector<std::string> codes;
+    std::string list;
+    for (uint8_t i = 1 + round % 20; i; --i)
+    {
+      std::string code;
+      for (uint8_t length = 1 + (random = random * 1103515245 + 12345) / 65536 % 6; length; --length)
+        code += codeKeys[(random = random * 1103515245 + 12345) / 65536 % (round % 2 ? 2 : 8)];
+      codes.push_back(code);
+      list += code + '\0';
+    }
+    list += '\0';
+    I2cKeypadCodeMatcherBuffer<128, 8> matcher;
+    bool terminated = round % 4 >= 2;
+    CHECK(matcher.begin(list.data()));
+    CHECK(matcher.getCodeCount() == codes.size());
+    matcher.setTerminatorKey(terminated ? '#' : 0);
+    std::string history;
+    for (uint16_t i = 0; i < 300; ++i)
+    {
+      uint8_t key = (random = random * 1103515245 + 12345) / 65536 % 12;
+      key = key < 10 ? typedKeys[key] : '#';
+      uint8_t expected = KEYPAD_NO_CODE;
+      if (key == '#' && terminated)
+      {
+        expected = expectedCode(codes, history, true);
+        history.clear();
+      }
+      else if (!terminated)
+        expected = expectedCode(codes, history += key, false);
+      else
+        history += key;
+      if (matcher.feed(key) != expected)
+      {
+        CHECK(!"feed() found the wrong code");
+        break;
+      }
+    }
+  }
+
+  // the example from setTerminatorKey()
+  I2cKeypadCodeMatcherBuffer<8, 4> door;
+  CHECK(door.begin("1234\0"));
+  CHECK(door.getKeyCount() == 4 && door.getNodeCount() == 5);
+  std::string found;
+  for (const char *key = "99991234#"; *key; ++key)
+    found += (char)('0' + door.feed(*key));
+  CHECK(found == "000000010");
+  door.setTerminatorKey('#');
+  found.clear();
+  for (const char *key = "99991234#1234#"; *key; ++key)
+    found += (char)('0' + door.feed(*key));
+  CHECK(found == "00000000000001");
+
+  // codes that don't fit: too many nodes, too many different keys, a key that is not ASCII
+  CHECK(!door.begin("12345\0"));
+  CHECK(!door.begin("123\0" "45\0"));
+  CHECK(door.getCodeCount() == 0 && door.feed('1') == KEYPAD_NO_CODE);
+  CHECK(!door.begin("1\x81\0"));
+  CHECK(door.begin("4321\0"));
+}
+
+
+// run one check, and print how it went
+void check(const char *name, void (*function)(void), int &failedChecks)
+{
+  failures = 0;
+  printf("%-40s", name);
+  fflush(stdout);
+  function();
+  printf("%s\n", failures ? "FAILED" : "passed");
+  if (failures)
+    ++failedChecks;
+}
+
+int main()
+{
+  int failedChecks = 0;
+
+  Wire.begin();
+  Wire.setClock(I2C_CLOCK);
+  Wire.attach(KEYPAD_ADDRESS, &chip);
+  Wire.attach(KEYPAD_ADDRESS + 1, &secondChip);
+#ifdef KEYPAD_LINUX_I2CDEV
+  KeypadI2cDev.begin("/dev/null");            // any file will do, SimI2cDev.cpp does the transfers
+#endif
+
+  check("manager with press and release events", checkManager, failedChecks);
+  check("manager scan rates and key order", checkManagerSchedule, failedChecks);
+  check("manager with an idle interrupt keypad", checkManagerIdle, failedChecks);
+  check("keypad buffer and setEventQueue()", checkEventQueue, failedChecks);
+  check("event queue wrap around and overflow", checkEventRing, failedChecks);
+  check("I2cKeypadT matches I2cKeypad", checkTemplateKeypad, failedChecks);
+  check("matrix keys debounced one at a time", checkMatrixDebounce, failedChecks);
+  check("key repeat and long press", checkRepeat, failedChecks);
+  check("peekKey() leaves other events alone", checkPeekKey, failedChecks);
+  check("line reversal scan cost", checkLineReversal, failedChecks);
+  check("debounce by counting scans", checkDebounceSamples, failedChecks);
+  check("scan budget of one transaction", checkScanBudget, failedChecks);
+  check("register copy and resyncRegisters()", checkRegisterShadow, failedChecks);
+  check("calibrateSettleTime() with slow pullups", checkSettleTime, failedChecks);
+  check("PCF8574 reset found by the chip check", checkPcfReset, failedChecks);
+  check("chip setup in one burst write", checkBurstWrites, failedChecks);
+  check("idle keypad in interrupt mode", checkIdleBus, failedChecks);
+  check("interrupt setup and wake up", checkInterruptScan, failedChecks);
+#ifdef KEYPAD_LINUX_I2CDEV
+  check("one I2C_RDWR transfer for each column", checkCombinedTransfers, failedChecks);
+#else
+  check("i2c retries, recovery and chip reset", checkI2cErrors, failedChecks);
+#endif
+  check("getKeysUntil() with maxKeys of 0", checkKeysUntil, failedChecks);
+  check("code matcher", checkCodeMatcher, failedChecks);
+
+  printf("\n%d check%s failed\n", failedChecks, failedChecks == 1 ? "" : "s");
+  return failedChecks ? 1 : 0;
+}
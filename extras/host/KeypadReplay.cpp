@@ -0,0 +1,963 @@
+/*
+  KeypadReplay.cpp
+
+  Short Description:
+
+    Runs a trace saved by a keypad (see src/I2cKeypadTrace.h) back through the I2cKeypad library on a
+    host computer, so a missed or doubled key from the field can be seen again, and a change to the scan
+    or debounce code can be tried against real key bounce.
+
+    The samples in the trace tell when each key was seen down or up. Those become key changes on a
+    simulated chip (set up the same way as the keypad in the trace), each one half way between the last
+    sample that saw the key's old state and the first sample that saw its new state. The library then
+    scans the simulated chip like loop() would, on a simulated clock that is set to the keypad's micros()
+    time at the first scan, so the scans (and the chip checks) start on the same millis() ticks as they did
+    in the field. The results are the same on every run. The key events the replay saves are printed next
+    to the events the keypad saved in the field.
+
+    Some key changes have to be guessed:
+      - A quick check only tells which rows are low. If no column read in the scan found the key that made
+        a row low (the scan stopped early, or the key bounced), the key that is down in the row, the key
+        that was just released, or the next key found in the row is used.
+      - In interrupt mode a key that goes down while the keypad waits is put just before the INT pin was
+        seen low. If the key had bounced back up by the time the scan read it, the same guesses are used.
+      - With line reversal, a key is only found if one row was low.
+    So with three or more keys down (or a scan that was given up after an i2c error, which the replay
+    does not repeat), the replay can be different from the trace even when the library has not changed.
+
+    The program exits with 0 if the replay saved the same key events (key and type, in the same order)
+    as the trace, 1 if they are different, and 2 if the trace can't be read. Only the press and release
+    events are compared, since the replay does not have the keypad's codes, or its repeat and long press
+    settings (KEY_EVENT_CODE, KEY_EVENT_REPEAT and KEY_EVENT_LONG_PRESS).
+
+    To build (from the top folder of the library, with the trace put in) and run:
+
+      g++ -std=c++11 -O2 -Wall -DKEYPAD_TRACE=1 -Iextras/host -Isrc -o keypad_replay \
+          extras/host/KeypadReplay.cpp extras/host/HostArduino.cpp extras/host/SimKeypadChip.cpp \
+          extras/host/SimMcp23008.cpp extras/host/SimMcp23017.cpp extras/host/SimPcf8574.cpp \
+          src/I2cKeypad.cpp src/I2cKeypadManager.cpp src/I2cKeypadCodeMatcher.cpp src/I2cKeypadTrace.cpp
+      ./keypad_replay [-l loopMicros] [-v] trace.bin
+      ./keypad_replay [-l loopMicros] -s
+
+      -l  microseconds between scanKeys() calls (the rest of loop()), 100 by default
+      -v  print the key changes worked out from the trace, and the first pins the replay read differently
+      -s  record a trace of random key presses (with bouncing contacts) on the simulated chip for each of a few
+          keypad setups, and replay it, to check the trace and the replay against each other. The program exits
+          with 0 if every replay saved the same key events as its trace.
+
+    trace.bin is the bytes read by I2cKeypad::readTrace(), for example saved from the serial port.
+    Anything before the trace's header (other things the sketch printed) is skipped.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "SimMcp23008.h"
+#include "SimMcp23017.h"
+#include "SimPcf8574.h"
+#include "I2cKeypad.h"
+#include "I2cKeypadTrace.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#if !KEYPAD_TRACE
+#error "Build the replay with -DKEYPAD_TRACE=1"
+#endif
+
+#define KEYPAD_ADDRESS 0x20           // i2c address of the simulated chip
+#define I2C_CLOCK 100000              // i2c clock rate (Hz)
+#define INT_PIN 2                     // microcontroller pin the chip's INT pin is connected to
+#define LOOP_TIME 100                 // default microseconds that the rest of loop() takes, between scanKeys() calls
+#define TAIL_TIME 500000              // microseconds the replay keeps running after the last sample
+#define MAX_LINES 16                  // max number of rows (or columns)
+#define LOOK_AHEAD 64                 // max number of samples looked through to find the key that made a row low
+#define BOUNCE_TIME 50000             // microseconds a key's contacts may bounce after it is released
+#define BEGIN_TIME 100000             // microseconds before the first scan that begin() is called
+#define MAX_LEAD 10000                // max microseconds a scan's first read may take
+
+// the keypad's setup, from the header of the trace
+struct TraceSetup {
+  uint8_t rowNum;
+  uint8_t colNum;
+  uint8_t scanMode;
+  uint8_t chipType;
+  uint16_t debounceTime;
+  uint16_t activeInterval;
+  uint16_t idleInterval;
+  uint16_t idleDelay;
+  uint8_t pressSamples;
+  uint8_t releaseSamples;
+  bool interrupts;
+  uint16_t settleTime;
+  uint16_t sampleCount;
+  unsigned long startTime;
+  uint16_t chipCheckInterval;
+  uint8_t rowPins[MAX_LINES];
+  uint8_t colPins[MAX_LINES];
+};
+
+// a sample of the trace, with the time counted from the first sample
+struct Sample {
+  unsigned long time;
+  uint16_t pins;
+  uint8_t what;
+  uint8_t state;
+};
+
+// a key change worked out from the samples
+struct KeyChange {
+  unsigned long time;
+  uint8_t row;
+  uint8_t col;
+  bool down;
+};
+
+// a key event saved by the keypad in the field, or by the replay
+struct Event {
+  unsigned long time;
+  uint8_t keyIndex;
+  uint8_t type;
+};
+
+TraceSetup setup;
+std::vector<Sample> samples;
+std::vector<KeyChange> changes;
+
+// what is known about each key while the samples are worked through
+bool keyDown[MAX_LINES][MAX_LINES];       // last state the key was seen in
+unsigned long keySeen[MAX_LINES][MAX_LINES];  // time the key was last seen in that state
+bool keyKnown[MAX_LINES][MAX_LINES];      // false until the key has been seen
+bool keyIdle[MAX_LINES][MAX_LINES];       // true if the key was up until keySeen, when the INT pin started a scan
+uint8_t releasedRow, releasedCol;         // the key that was released last
+unsigned long releasedTime = 0;           // time it was seen up
+
+SimMcp23008 mcp23008;
+SimMcp23017 mcp23017;
+SimPcf8574 pcf8574(8);
+SimPcf8574 pcf8575(16);
+
+
+// return a little endian word from the trace
+uint16_t readWord(const uint8_t *data)
+{
+  return data[0] | (data[1] << 8);
+}
+
+// forget the trace that was read, and the key changes worked out from it
+void clearTrace(void)
+{
+  samples.clear();
+  changes.clear();
+  memset(keyDown, 0, sizeof(keyDown));
+  memset(keySeen, 0, sizeof(keySeen));
+  memset(keyKnown, 0, sizeof(keyKnown));
+  memset(keyIdle, 0, sizeof(keyIdle));
+  releasedTime = 0;
+}
+
+// read the setup and the samples from the bytes of a trace
+// parameters
+//    data - the bytes read by I2cKeypad::readTrace() (anything before the header is skipped)
+//    fileName - where the bytes came from (for the messages)
+// returns
+//    false if there is no trace in the bytes (a message is printed)
+bool parseTrace(const std::vector<uint8_t> &data, const char *fileName)
+{
+  // skip anything before the header
+  size_t start = 0;
+  while (start + KEYPAD_TRACE_HEADER_SIZE <= data.size() &&
+         !(data[start] == 'K' && data[start + 1] == 'T' && data[start + 2] == KEYPAD_TRACE_VERSION &&
+           data[start + 3] == KEYPAD_TRACE_SAMPLE_SIZE))
+    ++start;
+  if (start + KEYPAD_TRACE_HEADER_SIZE > data.size())
+  {
+    fprintf(stderr, "%s does not have a version %d trace in it\n", fileName, KEYPAD_TRACE_VERSION);
+    return false;
+  }
+  const uint8_t *header = &data[start];
+  setup.rowNum = header[4];
+  setup.colNum = header[5];
+  setup.scanMode = header[6];
+  setup.chipType = header[7];
+  setup.debounceTime = readWord(header + 8);
+  setup.activeInterval = readWord(header + 10);
+  setup.idleInterval = readWord(header + 12);
+  setup.idleDelay = readWord(header + 14);
+  setup.pressSamples = header[16];
+  setup.releaseSamples = header[17];
+  setup.interrupts = header[18];
+  setup.settleTime = readWord(header + 20);
+  setup.sampleCount = readWord(header + 22);
+  setup.startTime = readWord(header + 24) | ((unsigned long)readWord(header + 26) << 16);
+  setup.chipCheckInterval = readWord(header + 28);
+  memcpy(setup.rowPins, header + 32, MAX_LINES);
+  memcpy(setup.colPins, header + 48, MAX_LINES);
+  if (!setup.rowNum || setup.rowNum > MAX_LINES || !setup.colNum || setup.colNum > MAX_LINES)
+  {
+    fprintf(stderr, "the trace has a %dx%d keypad\n", setup.rowNum, setup.colNum);
+    return false;
+  }
+
+  // the samples, with the time counted from the first one (a long gap is saved as a KEYPAD_TRACE_TIME sample)
+  size_t available = (data.size() - start - KEYPAD_TRACE_HEADER_SIZE) / KEYPAD_TRACE_SAMPLE_SIZE;
+  if (available < setup.sampleCount)
+  {
+    fprintf(stderr, "the trace is cut off after %zu of its %u samples\n", available, setup.sampleCount);
+    setup.sampleCount = available;
+  }
+  unsigned long time = 0;
+  for (uint16_t i = 0; i < setup.sampleCount; ++i)
+  {
+    const uint8_t *bytes = header + KEYPAD_TRACE_HEADER_SIZE + i * KEYPAD_TRACE_SAMPLE_SIZE;
+    Sample sample;
+    sample.pins = readWord(bytes + 2);
+    sample.what = bytes[4];
+    sample.state = bytes[5];
+    if (KEYPAD_TRACE_KIND(sample.what) == KEYPAD_TRACE_TIME)
+    {
+      if (!samples.empty())           // the time before the first sample doesn't matter
+        time += readWord(bytes) | ((unsigned long)sample.pins << 16);
+      continue;
+    }
+    if (!samples.empty())
+      time += readWord(bytes);
+    sample.time = time;
+    samples.push_back(sample);
+  }
+  return true;
+}
+
+// read a trace file
+// parameters
+//    fileName - the file
+// returns
+//    false if there is no trace in the file (a message is printed)
+bool readTrace(const char *fileName)
+{
+  FILE *file = fopen(fileName, "rb");
+  if (!file)
+  {
+    fprintf(stderr, "can't open %s\n", fileName);
+    return false;
+  }
+  std::vector<uint8_t> data;
+  int c;
+  while ((c = fgetc(file)) != EOF)
+    data.push_back(c);
+  fclose(file);
+  return parseTrace(data, fileName);
+}
+
+// a key was seen down (or up) in a sample. If it changed, the change is put half way since it was last seen.
+void seeKey(unsigned long time, uint8_t row, uint8_t col, bool down)
+{
+  if (!keyKnown[row][col])
+  {
+    keyKnown[row][col] = true;
+    if (down)                         // it was down when the trace started
+      changes.push_back({0, row, col, true});
+  }
+  else if (keyDown[row][col] != down && keyIdle[row][col])
+    changes.push_back({keySeen[row][col], row, col, down});    // it went down just before the INT pin started the scan
+  else if (keyDown[row][col] != down)
+    changes.push_back({keySeen[row][col] + (time - keySeen[row][col]) / 2, row, col, down});
+  if (keyDown[row][col] && !down)
+  {
+    releasedRow = row;
+    releasedCol = col;
+    releasedTime = time;
+  }
+  keyIdle[row][col] = false;
+  keyDown[row][col] = down;
+  keySeen[row][col] = time;
+}
+
+// return true if the row (or column) pin is low in the pins read from the chip
+bool rowLow(uint16_t pins, uint8_t row)
+{
+  return !bitRead(pins, setup.rowPins[row]);
+}
+bool colLow(uint16_t pins, uint8_t col)
+{
+  return !bitRead(pins, setup.colPins[col]);
+}
+
+// return the rows that are low in the pins read by a quick check (or the rows in INTF, for a KEYPAD_TRACE_INTERRUPT sample)
+uint16_t lowRows(uint16_t pins)
+{
+  uint16_t rows = 0;
+  for (uint8_t row = 0; row < setup.rowNum; ++row)
+  {
+    if (rowLow(pins, row))
+      bitSet(rows, row);
+  }
+  return rows;
+}
+
+// in interrupt mode the keypad is not scanned while it waits for a key press, until the chip's INT pin goes low. So the
+// keys that were up at the last scan stayed up until just before the INT pin was seen low.
+void idleUntil(unsigned long time)
+{
+  for (uint8_t row = 0; row < setup.rowNum; ++row)
+  {
+    for (uint8_t col = 0; col < setup.colNum; ++col)
+    {
+      if (keyKnown[row][col] && !keyDown[row][col])
+      {
+        keySeen[row][col] = time;
+        keyIdle[row][col] = true;
+      }
+    }
+  }
+}
+
+// look through the samples after a sample for the next key seen down in one of some rows
+// parameters
+//    index - the sample to start after
+//    rows - bit set for each row to look in
+//    thisScan - true to only look in the rest of the scan
+//    row, col - the key that was found
+// returns
+//    false if no key was found (in the next LOOK_AHEAD samples)
+bool nextKeyDown(size_t index, uint16_t rows, bool thisScan, uint8_t &row, uint8_t &col)
+{
+  uint16_t scanRows = thisScan ? lowRows(samples[index].pins) : 0;  // rows that were low at the last quick check
+
+  for (size_t i = index + 1; i < samples.size() && i <= index + LOOK_AHEAD; ++i)
+  {
+    const Sample &sample = samples[i];
+    switch (KEYPAD_TRACE_KIND(sample.what))
+    {
+      case KEYPAD_TRACE_QUICK_CHECK:
+      case KEYPAD_TRACE_WAKE:
+      case KEYPAD_TRACE_INTERRUPT:
+        if (thisScan)
+          return false;
+        if (KEYPAD_TRACE_KIND(sample.what) == KEYPAD_TRACE_QUICK_CHECK)
+          scanRows = lowRows(sample.pins);
+        break;
+
+      case KEYPAD_TRACE_COLUMN:
+        col = KEYPAD_TRACE_INDEX(sample.what);
+        for (row = 0; row < setup.rowNum && col < setup.colNum; ++row)
+        {
+          if (bitRead(rows, row) && rowLow(sample.pins, row))
+            return true;
+        }
+        break;
+
+      case KEYPAD_TRACE_REVERSED:
+        if (!(scanRows & rows) || (scanRows & (scanRows - 1)))
+          break;
+        for (row = 0; !bitRead(scanRows, row); ++row)
+          ;
+        for (col = 0; col < setup.colNum; ++col)
+        {
+          if (colLow(sample.pins, col))
+            return true;
+        }
+        break;
+    }
+  }
+  return false;
+}
+
+// a row was low (or the INT pin went low), but the sample does not tell which key it was. Use the key that is down in
+// the row, or the key the rest of the scan found down in the row, or the key that was just released (its contacts are
+// still bouncing), or the next key found down in the row, or else the first key in the row (any key in the row gives the
+// same quick check).
+// parameters
+//    index - the sample (a quick check)
+//    rows - bit set for each row the key may be in (not 0)
+//    row, col - the key that was picked
+// returns
+//    nothing
+void guessKey(size_t index, uint16_t rows, uint8_t &row, uint8_t &col)
+{
+  bool found = false;
+
+  for (uint8_t r = 0; r < setup.rowNum; ++r)
+  {
+    for (uint8_t c = 0; c < setup.colNum && bitRead(rows, r); ++c)
+    {
+      if (keyKnown[r][c] && keyDown[r][c] && (!found || keySeen[r][c] > keySeen[row][col]))
+      {
+        row = r;
+        col = c;
+        found = true;
+      }
+    }
+  }
+  if (found || nextKeyDown(index, rows, true, row, col))
+    return;
+  if (releasedTime && samples[index].time - releasedTime < BOUNCE_TIME && bitRead(rows, releasedRow))
+  {
+    row = releasedRow;
+    col = releasedCol;
+    return;
+  }
+  if (nextKeyDown(index, rows, false, row, col))
+    return;
+  for (row = 0; !bitRead(rows, row); ++row)
+    ;
+  col = 0;
+}
+
+// work out when each key went down and up from the samples, and get the key events the keypad saved
+// parameters
+//    events - the key events in the trace are added here
+// returns
+//    nothing
+void findKeyChanges(std::vector<Event> &events)
+{
+  uint16_t scanRows = 0;              // rows that were low at the last quick check
+  uint16_t wakeRows = 0;              // rows that may have made the INT pin go low, until the quick check after it
+  unsigned long wakeTime = 0;         // time the INT pin was seen low
+  uint8_t row, col;
+
+  // if no key was down when the trace started, every key is known to be up from the start
+  if (!samples.empty() && samples[0].state == WAITING_FOR_NEW_KEY_PRESS)
+  {
+    for (row = 0; row < setup.rowNum; ++row)
+    {
+      for (col = 0; col < setup.colNum; ++col)
+        keyKnown[row][col] = true;
+    }
+  }
+
+  for (size_t i = 0; i < samples.size(); ++i)
+  {
+    const Sample &sample = samples[i];
+    switch (KEYPAD_TRACE_KIND(sample.what))
+    {
+      case KEYPAD_TRACE_WAKE:
+        wakeTime = sample.time;
+        wakeRows = (1U << setup.rowNum) - 1;
+        idleUntil(sample.time > 0 ? sample.time - 1 : 0);
+        break;
+
+      case KEYPAD_TRACE_INTERRUPT:
+        if (wakeRows)
+          wakeRows = lowRows(~sample.pins);   // INTF has a bit set for each pin that changed
+        break;
+
+      case KEYPAD_TRACE_QUICK_CHECK:
+        scanRows = lowRows(sample.pins);
+        // if the INT pin went low but no row is low now, a key went down and bounced back up before the scan read it
+        if (wakeRows && !scanRows)
+        {
+          guessKey(i, wakeRows, row, col);
+          seeKey(wakeTime, row, col, true);
+        }
+        wakeRows = 0;
+        for (row = 0; row < setup.rowNum; ++row)
+        {
+          uint8_t guessRow;
+          if (!bitRead(scanRows, row))
+          {
+            for (col = 0; col < setup.colNum; ++col)
+              seeKey(sample.time, row, col, false);   // no key in this row is down
+          }
+          else
+          {
+            guessKey(i, 1U << row, guessRow, col);
+            seeKey(sample.time, row, col, true);      // the column reads after this may find more keys in the row
+          }
+        }
+        break;
+
+      case KEYPAD_TRACE_COLUMN:
+        {
+          // the other columns are inputs with pullups, so a key between a low row and another column pulls that column low
+          uint8_t driven = KEYPAD_TRACE_INDEX(sample.what);
+          uint16_t rows = driven < setup.colNum ? lowRows(sample.pins) : 0;
+          for (row = 0; row < setup.rowNum && driven < setup.colNum; ++row)
+          {
+            seeKey(sample.time, row, driven, bitRead(rows, row));
+            for (col = 0; col < setup.colNum && bitRead(rows, row); ++col)
+            {
+              if (col != driven && (!colLow(sample.pins, col) || !(rows & (rows - 1))))
+                seeKey(sample.time, row, col, colLow(sample.pins, col));
+            }
+          }
+        }
+        break;
+
+      case KEYPAD_TRACE_REVERSED:
+        // the rows are driven low, so a low column can only be told apart if one row was low in the quick check
+        if (scanRows && !(scanRows & (scanRows - 1)))
+        {
+          for (row = 0; !bitRead(scanRows, row); ++row)
+            ;
+          for (col = 0; col < setup.colNum; ++col)
+            seeKey(sample.time, row, col, colLow(sample.pins, col));
+        }
+        break;
+
+      case KEYPAD_TRACE_EVENT:
+        if ((sample.pins >> 8) == KEY_EVENT_PRESSED || (sample.pins >> 8) == KEY_EVENT_RELEASED)
+          events.push_back({sample.time, (uint8_t)sample.pins, (uint8_t)(sample.pins >> 8)});
+        break;
+
+      default:                        // KEYPAD_TRACE_STATE, KEYPAD_TRACE_CHECK, KEYPAD_TRACE_ERROR
+        break;
+    }
+  }
+  std::stable_sort(changes.begin(), changes.end(),
+                   [](const KeyChange &a, const KeyChange &b) { return a.time < b.time; });
+}
+
+// add the samples in a trace to a list, and empty the trace
+// parameters
+//    trace - the trace
+//    start - time (micros) that the sample times are counted from
+//    list - the samples are added here
+// returns
+//    nothing
+void takeSamples(I2cKeypadTrace &trace, unsigned long start, std::vector<Sample> &list)
+{
+  unsigned long time = trace.startTime() - start;
+  KeypadTraceSample sample;
+
+  for (uint16_t i = 0; trace.getSample(i, sample); ++i)
+  {
+    if (i)
+      time += sample.time;
+    if (KEYPAD_TRACE_KIND(sample.what) == KEYPAD_TRACE_TIME)
+    {
+      if (i)
+        time += (unsigned long)sample.pins << 16;
+      continue;
+    }
+    list.push_back({time, sample.pins, sample.what, sample.state});
+  }
+  trace.clear();
+}
+
+// run the library against the simulated chip, making the key changes on time
+// parameters
+//    loopTime - microseconds between scanKeys() calls
+//    first - time of the replay's first scan (counted from the first sample)
+//    lead - microseconds the scans start before the samples' times (a sample is saved after the pins are read)
+//    events - the key events saved by the replay are added here
+//    replaySamples - the samples taken by the replay are added here
+// returns
+//    nothing
+void replay(unsigned long loopTime, unsigned long first, unsigned long lead, std::vector<Event> &events,
+            std::vector<Sample> &replaySamples)
+{
+  static char keyMap[MAX_LINES * MAX_LINES];
+  static I2cKeypadTraceBuffer<KEYPAD_TRACE_MAX_SAMPLES> trace;
+  SimKeypadChip *chip;
+
+  switch (setup.chipType)
+  {
+    case KEYPAD_MCP23017:
+      chip = &mcp23017;
+      break;
+    case KEYPAD_PCF8574:
+      chip = &pcf8574;
+      break;
+    case KEYPAD_PCF8575:
+      chip = &pcf8575;
+      break;
+    default:
+      chip = &mcp23008;
+      break;
+  }
+  // the keypad is set up a little before the first scan, then the clock is set to the keypad's clock at the first scan, so
+  // the scans start on the same millis() ticks as in the field
+  unsigned long start = setup.startTime;
+  simMicros = start + first > BEGIN_TIME ? start + first - BEGIN_TIME : 0;
+  chip->releaseAll();
+  chip->powerOnReset();
+  Wire.begin();
+  Wire.setClock(I2C_CLOCK);
+  Wire.attach(KEYPAD_ADDRESS, chip);
+  chip->connectInterruptPin(INT_PIN);
+
+  I2cKeypad keypad(keyMap, setup.rowPins, setup.colPins, setup.rowNum, setup.colNum, setup.debounceTime, KEYPAD_ADDRESS,
+                   setup.scanMode, setup.chipType);
+  I2cKeypadEventBuffer<128> eventBuffer;
+  static I2cKeypadMatrixBuffer<16, 16> matrix;
+  keypad.setEventQueue(eventBuffer);
+  keypad.setMatrix(&matrix);
+  keypad.begin();
+  keypad.setScanRates(setup.activeInterval, setup.idleInterval, setup.idleDelay);
+  keypad.setDebounceSamples(setup.pressSamples, setup.releaseSamples);
+  keypad.setSettleTime(setup.settleTime);
+  if (setup.interrupts)
+    keypad.enableInterrupts(INT_PIN);
+  keypad.setTrace(&trace);
+
+  // the chip is checked at the same time as the first check in the trace, then every chip check interval after it like
+  // in the field (no checks if there are none in the trace)
+  size_t check = 0;
+  while (check < samples.size() && KEYPAD_TRACE_KIND(samples[check].what) != KEYPAD_TRACE_CHECK)
+    ++check;
+  bool checkSet = check == samples.size();
+  if (checkSet)
+    keypad.setChipCheckInterval(0);
+  else
+    keypad.setChipCheckInterval((start + samples[check].time - lead) / 1000 - millis());
+  simMicros = start + first;
+  trace.clear();
+
+  unsigned long end = (samples.empty() ? 0 : samples.back().time) + TAIL_TIME;
+  size_t next = 0;                    // next key change to put in the chip's script
+  KeypadEvent event;
+
+  while ((long)(micros() - start) <= (long)end)
+  {
+    // the chip's script is kept full, so it makes the changes at their exact time, even in the middle of a scan
+    while (next < changes.size() &&
+           chip->schedule(start + changes[next].time, setup.rowPins[changes[next].row], setup.colPins[changes[next].col],
+                          changes[next].down))
+      ++next;
+    keypad.scanKeys();
+    while (keypad.getEvent(event))
+      events.push_back({event.time - start, (uint8_t)(event.row * setup.colNum + event.col), event.type});
+    if (!checkSet && micros() - start > samples[check].time + MAX_LEAD)
+    {
+      keypad.setChipCheckInterval(setup.chipCheckInterval);
+      checkSet = true;
+    }
+    if (trace.count() > trace.capacity() / 2)
+      takeSamples(trace, start, replaySamples);
+    simMicros += loopTime;            // the rest of loop()
+  }
+  takeSamples(trace, start, replaySamples);
+  keypad.setTrace(0);
+}
+
+// return true if a sample has pins read from the chip
+bool readSample(const Sample &sample)
+{
+  uint8_t kind = KEYPAD_TRACE_KIND(sample.what);
+  return kind == KEYPAD_TRACE_QUICK_CHECK || kind == KEYPAD_TRACE_COLUMN || kind == KEYPAD_TRACE_REVERSED ||
+         kind == KEYPAD_TRACE_INTERRUPT;
+}
+
+// print an event (or spaces if there is none)
+void printEvent(const std::vector<Event> &events, size_t i)
+{
+  static const char *types[] = {"", "pressed", "released", "code", "repeat", "long"};
+  if (i >= events.size())
+  {
+    printf("%-27s", "");
+    return;
+  }
+  const Event &event = events[i];
+  printf("%9.1f  r%-2uc%-2u  %-8s  ", event.time / 1000.0, event.keyIndex / setup.colNum, event.keyIndex % setup.colNum,
+         event.type <= KEY_EVENT_LONG_PRESS ? types[event.type] : "?");
+}
+
+// if a key was down when the trace started (the state machine was not waiting for a key press), the keypad saved its press
+// before the trace, so the replay's press of the key is left out (if it comes before the key is released)
+// parameters
+//    events - the events saved by the replay
+// returns
+//    the number of presses left out
+size_t dropStartPresses(std::vector<Event> &events)
+{
+  bool downAtStart[MAX_LINES * MAX_LINES] = {false};
+  size_t dropped = 0;
+
+  if (samples.empty() || samples[0].state == WAITING_FOR_NEW_KEY_PRESS)
+    return 0;
+  for (size_t i = 0; i < changes.size() && changes[i].time == 0; ++i)
+  {
+    if (changes[i].down)
+      downAtStart[changes[i].row * setup.colNum + changes[i].col] = true;
+  }
+  for (size_t i = 0; i < events.size(); )
+  {
+    uint8_t key = events[i].keyIndex;
+    if (key < MAX_LINES * MAX_LINES && downAtStart[key])
+    {
+      downAtStart[key] = false;
+      if (events[i].type == KEY_EVENT_PRESSED)
+      {
+        events.erase(events.begin() + i);
+        ++dropped;
+        continue;
+      }
+    }
+    ++i;
+  }
+  return dropped;
+}
+
+// print the first pins read by the replay that are different from the pins in the trace
+// parameters
+//    replaySamples - the samples taken by the replay
+//    i - the sample in the trace that the replay's first sample goes with
+// returns
+//    nothing
+void printDifferentSample(const std::vector<Sample> &replaySamples, size_t i)
+{
+  size_t j = 0;
+
+  for (;;)
+  {
+    while (i < samples.size() && !readSample(samples[i]))
+      ++i;
+    while (j < replaySamples.size() && !readSample(replaySamples[j]))
+      ++j;
+    if (i >= samples.size() || j >= replaySamples.size())
+      break;
+    if (samples[i].what != replaySamples[j].what || samples[i].pins != replaySamples[j].pins)
+    {
+      printf("the first pins read differently: trace %.3f ms what %02x pins %04x, replay %.3f ms what %02x pins %04x\n",
+             samples[i].time / 1000.0, samples[i].what, samples[i].pins,
+             replaySamples[j].time / 1000.0, replaySamples[j].what, replaySamples[j].pins);
+      return;
+    }
+    ++i;
+    ++j;
+  }
+  printf("the replay read the same pins as the trace\n");
+}
+
+// work out the key changes from the trace that was read, replay them, and print the events next to the trace's events
+// parameters
+//    loopTime - microseconds between scanKeys() calls
+//    verbose - true to print the key changes, and the first pins the replay read differently
+// returns
+//    true if the replay saved the same key events as the trace
+bool replayTrace(unsigned long loopTime, bool verbose)
+{
+  static const char *scanModes[] = {"columns", "line reversal", "matrix"};
+  static const char *chipTypes[] = {"MCP23008", "MCP23017", "PCF8574", "PCF8575"};
+  std::vector<Event> recorded;
+  std::vector<Event> replayed;
+  findKeyChanges(recorded);
+
+  printf("%ux%u keypad, %s scan, %s%s, debounce %u ms", setup.rowNum, setup.colNum,
+         setup.scanMode < 3 ? scanModes[setup.scanMode] : "?", setup.chipType < 4 ? chipTypes[setup.chipType] : "?",
+         setup.interrupts ? " with interrupts" : "", setup.debounceTime);
+  if (setup.pressSamples)
+    printf(" (%u press, %u release samples)", setup.pressSamples, setup.releaseSamples);
+  printf(", scans every %u/%u ms\n", setup.activeInterval, setup.idleInterval);
+  printf("%zu samples over %.1f ms, %zu key changes\n", samples.size(), samples.empty() ? 0.0 : samples.back().time / 1000.0,
+         changes.size());
+  if (verbose)
+  {
+    for (size_t i = 0; i < changes.size(); ++i)
+      printf("  %9.1f ms  r%-2uc%-2u  %s\n", changes[i].time / 1000.0, changes[i].row, changes[i].col,
+             changes[i].down ? "down" : "up");
+  }
+
+  // a sample is saved after the pins are read, and a trace may start in the middle of a scan. So the first replay finds how
+  // long the first read of a scan takes, and the second replay starts its first scan that long before the first quick check
+  // in the trace (unless the keypad was waiting for the INT pin then).
+  std::vector<Sample> replaySamples;
+  size_t first = 0;
+  while (first < samples.size() && KEYPAD_TRACE_KIND(samples[first].what) != KEYPAD_TRACE_QUICK_CHECK)
+    ++first;
+  bool align = first < samples.size() && !(setup.interrupts && samples[first].state == WAITING_FOR_NEW_KEY_PRESS);
+  unsigned long firstTime = align ? samples[first].time : 0;
+  replay(loopTime, firstTime, 0, replayed, replaySamples);
+  if (align && !replaySamples.empty() && replaySamples[0].what == KEYPAD_TRACE_QUICK_CHECK &&
+      replaySamples[0].time - firstTime < MAX_LEAD)
+  {
+    unsigned long lead = replaySamples[0].time - firstTime;
+    replayed.clear();
+    replaySamples.clear();
+    replay(loopTime, firstTime - lead, lead, replayed, replaySamples);
+  }
+  if (verbose)
+    printDifferentSample(replaySamples, align ? first : 0);
+  size_t dropped = dropStartPresses(replayed);
+  if (dropped)
+    printf("the trace starts while keys are down, so %zu presses saved by the replay (before the trace) are left out\n", dropped);
+
+  printf("\n  %-25s  %-25s\n  %9s  %-6s %-8s  %9s  %-6s %-8s\n", "trace", "replay", "ms", "key", "event", "ms", "key", "event");
+  size_t same = 0;
+  while (same < recorded.size() && same < replayed.size() &&
+         recorded[same].keyIndex == replayed[same].keyIndex && recorded[same].type == replayed[same].type)
+    ++same;
+  for (size_t i = 0; i < recorded.size() || i < replayed.size(); ++i)
+  {
+    printEvent(recorded, i);
+    printEvent(replayed, i);
+    printf("%s\n", i == same ? "<- first difference" : "");
+  }
+  if (same == recorded.size() && same == replayed.size())
+  {
+    printf("\nthe replay saved the same %zu events as the trace\n", same);
+    return true;
+  }
+  printf("\nthe replay is different from the trace at event %zu\n", same + 1);
+  return false;
+}
+
+// record a trace on the simulated chip, of a keypad pressed at random (with bouncing contacts, some short taps, and
+// sometimes a second key held down at the same time)
+// parameters
+//    keypadSetup - how the keypad is set up (the pins, the scan mode, the chip and the scan settings)
+//    data - the bytes read by I2cKeypad::readTrace() are put here
+// returns
+//    nothing
+void recordTrace(const TraceSetup &keypadSetup, std::vector<uint8_t> &data)
+{
+  static char keyMap[MAX_LINES * MAX_LINES];
+  static I2cKeypadTraceBuffer<KEYPAD_TRACE_MAX_SAMPLES> trace;
+  static I2cKeypadMatrixBuffer<16, 16> matrix;
+  SimKeypadChip *chip = keypadSetup.chipType == KEYPAD_MCP23017 ? (SimKeypadChip *)&mcp23017 :
+                        keypadSetup.chipType == KEYPAD_PCF8574 ? (SimKeypadChip *)&pcf8574 :
+                        keypadSetup.chipType == KEYPAD_PCF8575 ? (SimKeypadChip *)&pcf8575 : (SimKeypadChip *)&mcp23008;
+  const uint8_t *rowPins = keypadSetup.rowPins;
+  const uint8_t *colPins = keypadSetup.colPins;
+
+  chip->releaseAll();
+  chip->powerOnReset();
+  Wire.begin();
+  Wire.setClock(I2C_CLOCK);
+  Wire.attach(KEYPAD_ADDRESS, chip);
+  chip->connectInterruptPin(INT_PIN);
+  I2cKeypad keypad(keyMap, (uint8_t *)rowPins, (uint8_t *)colPins, keypadSetup.rowNum, keypadSetup.colNum,
+                   keypadSetup.debounceTime, KEYPAD_ADDRESS, keypadSetup.scanMode, keypadSetup.chipType);
+  I2cKeypadEventBuffer<128> eventBuffer;
+  keypad.setEventQueue(eventBuffer);
+  keypad.setMatrix(&matrix);
+  keypad.begin();
+  if (keypadSetup.activeInterval)
+    keypad.setScanRates(keypadSetup.activeInterval, keypadSetup.idleInterval, keypadSetup.idleDelay);
+  keypad.setDebounceSamples(keypadSetup.pressSamples, keypadSetup.releaseSamples);
+  if (keypadSetup.interrupts)
+    keypad.enableInterrupts(INT_PIN);
+  trace.clear();
+  keypad.setTrace(&trace);
+
+  unsigned long time = micros() + 5000;
+  KeypadEvent event;
+  for (int press = 0; press < 25; ++press)
+  {
+    uint8_t row = rand() % keypadSetup.rowNum;
+    uint8_t col = rand() % keypadSetup.colNum;
+    uint8_t bounces = rand() % 4;
+    unsigned long bounceTime = 100 + rand() % 900;
+    unsigned long hold = rand() % 3 ? 40000 + rand() % 150000 : 8000 + rand() % 20000;
+    chip->scheduleBounce(time, rowPins[row], colPins[col], true, bounces, bounceTime);
+    if (rand() % 4 == 0)
+    {
+      uint8_t otherRow = rand() % keypadSetup.rowNum;
+      uint8_t otherCol = rand() % keypadSetup.colNum;
+      chip->scheduleBounce(time + 20000, rowPins[otherRow], colPins[otherCol], true, 1, 300);
+      chip->scheduleBounce(time + hold, rowPins[otherRow], colPins[otherCol], false, 1, 300);
+    }
+    chip->scheduleBounce(time + hold + 2000, rowPins[row], colPins[col], false, bounces, bounceTime);
+    unsigned long end = time + hold + 32000 + rand() % 200000;
+    if (press == 7)
+      end += 300000;                  // a long gap between samples
+    while ((long)(micros() - end) < 0)
+    {
+      keypad.scanKeys();
+      while (keypad.getEvent(event))
+        ;
+      simMicros += LOOP_TIME;
+    }
+    time = micros() + rand() % 3000;
+  }
+
+  uint8_t bytes[64];
+  uint16_t count;
+  data.clear();
+  while ((count = keypad.readTrace(bytes, sizeof(bytes))))
+    data.insert(data.end(), bytes, bytes + count);
+  keypad.setTrace(0);
+}
+
+// record a trace for each of a few keypad setups, and replay it
+// parameters
+//    loopTime - microseconds between scanKeys() calls in the replay
+// returns
+//    the number of replays that saved different key events than their trace
+int selfCheck(unsigned long loopTime)
+{
+  // scan mode, chip, fast scan rates and debounce samples, and interrupts
+  static const struct {
+    uint8_t scanMode;
+    uint8_t chipType;
+    bool samples;
+    bool interrupts;
+  } setups[] = {
+    {KEYPAD_SCAN_COLUMNS, KEYPAD_MCP23008, false, false},
+    {KEYPAD_SCAN_LINE_REVERSAL, KEYPAD_MCP23008, false, false},
+    {KEYPAD_SCAN_MATRIX, KEYPAD_MCP23008, false, false},
+    {KEYPAD_SCAN_COLUMNS, KEYPAD_MCP23008, true, false},
+    {KEYPAD_SCAN_COLUMNS, KEYPAD_MCP23008, false, true},
+    {KEYPAD_SCAN_COLUMNS, KEYPAD_MCP23017, false, true},
+    {KEYPAD_SCAN_COLUMNS, KEYPAD_PCF8574, false, false},
+    {KEYPAD_SCAN_LINE_REVERSAL, KEYPAD_PCF8574, false, true},
+    {KEYPAD_SCAN_MATRIX, KEYPAD_PCF8575, true, false},
+  };
+  static const uint8_t rowPins[] = {3, 1, 2, 0};
+  static const uint8_t colPins[] = {7, 5, 4, 6};
+  std::vector<uint8_t> data;
+  int different = 0;
+
+  srand(3);
+  for (size_t i = 0; i < sizeof(setups) / sizeof(setups[0]); ++i)
+  {
+    TraceSetup keypadSetup = TraceSetup();
+    keypadSetup.rowNum = sizeof(rowPins);
+    keypadSetup.colNum = sizeof(colPins);
+    keypadSetup.scanMode = setups[i].scanMode;
+    keypadSetup.chipType = setups[i].chipType;
+    keypadSetup.debounceTime = 20;
+    if (setups[i].samples)
+    {
+      keypadSetup.activeInterval = 2;
+      keypadSetup.idleInterval = 50;
+      keypadSetup.idleDelay = 500;
+      keypadSetup.pressSamples = 4;
+      keypadSetup.releaseSamples = 3;
+    }
+    keypadSetup.interrupts = setups[i].interrupts;
+    memcpy(keypadSetup.rowPins, rowPins, sizeof(rowPins));
+    memcpy(keypadSetup.colPins, colPins, sizeof(colPins));
+    recordTrace(keypadSetup, data);
+    clearTrace();
+    printf("\n");
+    if (!parseTrace(data, "the recorded trace") || !replayTrace(loopTime, false))
+      ++different;
+  }
+  printf("\n%d of the %zu replays were different from their trace\n", different, sizeof(setups) / sizeof(setups[0]));
+  return different;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned long loopTime = LOOP_TIME;
+  bool verbose = false;
+  bool record = false;
+  const char *fileName = 0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "-l") && i + 1 < argc)
+      loopTime = strtoul(argv[++i], 0, 0);
+    else if (!strcmp(argv[i], "-v"))
+      verbose = true;
+    else if (!strcmp(argv[i], "-s"))
+      record = true;
+    else
+      fileName = argv[i];
+  }
+  if ((!fileName && !record) || !loopTime)
+  {
+    fprintf(stderr, "usage: %s [-l loopMicros] [-v] trace.bin\n       %s [-l loopMicros] -s\n", argv[0], argv[0]);
+    return 2;
+  }
+  if (record)
+    return selfCheck(loopTime) ? 1 : 0;
+  if (!readTrace(fileName))
+    return 2;
+  return replayTrace(loopTime, verbose) ? 0 : 1;
+}
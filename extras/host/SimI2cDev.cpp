@@ -0,0 +1,73 @@
+/*
+  SimI2cDev.cpp
+
+  Short Description:
+
+    Stand-in for the kernel's i2c-dev interface, so the Linux version of the library (KEYPAD_LINUX_I2CDEV,
+    see src/I2cKeypadI2cDev.h) can be run against the simulated chips. The i2c-stub kernel module can't be
+    used for this, since it only does SMBus transfers, and the library needs plain i2c transfers (I2C_RDWR).
+
+    ioctl() is replaced: I2C_FUNCS says the bus can do plain i2c transfers, and each message of an I2C_RDWR
+    transfer is passed to the simulated device at its address (see Wire.h). The whole transfer counts as one
+    transaction on the simulated bus. Any other ioctl() goes to the kernel. Open any file as the bus,
+    for example KeypadI2cDev.begin("/dev/null").
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "Wire.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+
+// do a simulated I2C_RDWR transfer
+// parameters
+//    request - the messages to send
+// returns
+//    the number of messages sent, or -1 (errno = ENXIO) if there is no device at an address
+static int simTransfer(struct i2c_rdwr_ioctl_data *request)
+{
+  uint8_t bytes = 0;
+
+  for (uint32_t i = 0; i < request->nmsgs; ++i)
+  {
+    struct i2c_msg *message = &request->msgs[i];
+    SimDevice *device = Wire.device(message->addr);
+    if (!device)
+    {
+      Wire.countTransaction(bytes + 1);       // only the address byte is sent if it is not acknowledged
+      errno = ENXIO;
+      return -1;
+    }
+    if (message->flags & I2C_M_RD)
+      device->read(message->buf, message->len);   // a short read from a device is not seen on a real bus either
+    else
+      device->write(message->buf, message->len);
+    bytes += message->len + 1;                // address, data
+  }
+  Wire.countTransaction(bytes);
+  return request->nmsgs;
+}
+
+extern "C" int ioctl(int fd, unsigned long request, ...)
+{
+  va_list args;
+  va_start(args, request);
+  void *arg = va_arg(args, void *);
+  va_end(args);
+
+  if (request == I2C_FUNCS)
+  {
+    *(unsigned long *)arg = I2C_FUNC_I2C;
+    return 0;
+  }
+  if (request == I2C_RDWR)
+    return simTransfer((struct i2c_rdwr_ioctl_data *)arg);
+  return syscall(SYS_ioctl, fd, request, arg);
+}
@@ -0,0 +1,201 @@
+/*
+  SimKeypadChip.cpp
+
+  Short Description:
+
+    The keypad and pin levels of a simulated i2c interface chip.
+    See SimKeypadChip.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "SimKeypadChip.h"
+
+
+// class constructor
+SimKeypadChip::SimKeypadChip()
+{
+  riseTime = 0;
+  _lastLevels = 0xffff;
+  _rising = 0;
+  releaseAll();
+}
+
+// press (or release) a key right now
+// parameters
+//    rowPin, colPin - the two chip pins (0-15) the key joins
+//    down - true to press the key, false to release it
+// returns
+//    nothing
+void SimKeypadChip::press(uint8_t rowPin, uint8_t colPin, bool down)
+{
+  _keys[rowPin][colPin] = down;
+  _keys[colPin][rowPin] = down;
+  update();
+}
+
+// release every key, and throw away any scripted key changes
+void SimKeypadChip::releaseAll(void)
+{
+  memset(_keys, 0, sizeof(_keys));
+  _scriptLength = 0;
+}
+
+// press or release a key at a later time
+// parameters
+//    time - simulated time (micros) of the change
+//    rowPin, colPin - the two chip pins (0-15) the key joins
+//    down - true to press the key, false to release it
+// returns
+//    false if the script is full
+bool SimKeypadChip::schedule(unsigned long time, uint8_t rowPin, uint8_t colPin, bool down)
+{
+  if (_scriptLength >= SIM_SCRIPT_SIZE)
+    return false;
+  // keep the script in time order (changes at the same time stay in the order they were added)
+  uint8_t i = _scriptLength++;
+  for (; i && (long)(_script[i - 1].time - time) > 0; --i)
+    _script[i] = _script[i - 1];
+  _script[i].time = time;
+  _script[i].rowPin = rowPin;
+  _script[i].colPin = colPin;
+  _script[i].down = down;
+  return true;
+}
+
+// press or release a key at a later time, with contact bounce: the key goes back and forth before it settles
+// parameters
+//    time - simulated time (micros) the key first changes
+//    rowPin, colPin - the two chip pins (0-15) the key joins
+//    down - true to press the key, false to release it
+//    bounces - number of times the key goes back before it settles
+//    bounceTime - microseconds between each change while it bounces
+// returns
+//    false if the script is full
+bool SimKeypadChip::scheduleBounce(unsigned long time, uint8_t rowPin, uint8_t colPin, bool down,
+                                   uint8_t bounces, unsigned long bounceTime)
+{
+  for (uint8_t i = 0; i < bounces; ++i)
+  {
+    if (!schedule(time, rowPin, colPin, down) || !schedule(time + bounceTime, rowPin, colPin, !down))
+      return false;
+    time += 2 * bounceTime;
+  }
+  return schedule(time, rowPin, colPin, down);
+}
+
+// returns true if every scripted key change has happened
+bool SimKeypadChip::scriptDone(void)
+{
+  runScript();
+  return _scriptLength == 0;
+}
+
+// connect this chip's INT pin to a microcontroller pin, so digitalRead(pin) returns LOW while the interrupt is active
+// parameters
+//    pin - the microcontroller pin number
+// returns
+//    nothing
+void SimKeypadChip::connectInterruptPin(int pin)
+{
+  simIntPin = pin;
+  simIntDevice = this;
+}
+
+
+// protected functions ********************************
+
+// work out the level of each pin
+// parameters
+//    outputs - bit n is set if pin n is driven
+//    latch - level that each driven pin is driven to
+// returns
+//    bit n is set if pin n is high
+uint16_t SimKeypadChip::levels(uint16_t outputs, uint16_t latch)
+{
+  // group the pins that are joined by keys that are down (each group is named by its lowest pin)
+  uint8_t group[SIM_MAX_PINS];
+  for (uint8_t i = 0; i < SIM_MAX_PINS; ++i)
+    group[i] = i;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (uint8_t a = 0; a < SIM_MAX_PINS; ++a)
+    {
+      for (uint8_t b = 0; b < SIM_MAX_PINS; ++b)
+      {
+        if (_keys[a][b] && group[a] != group[b])
+        {
+          group[a] = group[b] = group[a] < group[b] ? group[a] : group[b];
+          changed = true;
+        }
+      }
+    }
+  }
+
+  // a group is low if any output pin in it is driving low
+  uint16_t lowGroups = 0;
+  for (uint8_t i = 0; i < SIM_MAX_PINS; ++i)
+  {
+    if (((outputs & ~latch) >> i) & 0x01)
+      lowGroups |= 1 << group[i];
+  }
+
+  uint16_t value = 0;
+  for (uint8_t i = 0; i < SIM_MAX_PINS; ++i)
+  {
+    bool high = ((outputs >> i) & 0x01) ? ((latch >> i) & 0x01) : !((lowGroups >> group[i]) & 0x01);
+    if (high)
+      value |= 1 << i;
+  }
+
+  // a pin that just went high is still low until its rise time is up
+  unsigned long now = micros();
+  for (uint8_t i = 0; i < SIM_MAX_PINS; ++i)
+  {
+    uint16_t bit = 1 << i;
+    if (!(value & bit))
+      _rising &= ~bit;
+    else if (!(_lastLevels & bit))
+    {
+      _rising |= bit;
+      _riseStart[i] = now;
+    }
+    if ((_rising & bit) && now - _riseStart[i] >= riseTime)
+      _rising &= ~bit;
+  }
+  _lastLevels = value;
+  return value & ~_rising;
+}
+
+// make any scripted key changes that are due, then sample the pins
+void SimKeypadChip::update(void)
+{
+  runScript();
+  sample();
+}
+
+
+// private functions ********************************
+
+// make the scripted key changes whose time has come. The pins (and the interrupt) are sampled after each one, so
+// a short bounce is not lost.
+void SimKeypadChip::runScript(void)
+{
+  uint8_t done = 0;
+  while (done < _scriptLength && (long)(micros() - _script[done].time) >= 0)
+  {
+    _keys[_script[done].rowPin][_script[done].colPin] = _script[done].down;
+    _keys[_script[done].colPin][_script[done].rowPin] = _script[done].down;
+    ++done;
+    sample();
+  }
+  if (done)
+  {
+    _scriptLength -= done;
+    memmove(_script, _script + done, _scriptLength * sizeof(KeyChange));
+  }
+}
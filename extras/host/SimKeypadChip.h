@@ -0,0 +1,75 @@
+/*
+  SimKeypadChip.h
+
+  Short Description:
+
+    The parts of a simulated i2c interface chip that don't depend on the chip: a keypad wired
+    to up to 16 pins, the key presses (right away or scripted), and working out the level of
+    each pin. SimMcp23008, SimMcp23017 and SimPcf8574 add the chip's registers.
+
+    Each key joins two pins when it is down. A pin that is an output drives every pin joined to
+    it, and an input pin with nothing driving it low reads high (the pullups are assumed to be on),
+    so ghosting with three keys down works the same as on a real keypad without diodes.
+    A pin that is let go rises through its pullup: it reads low until riseTime microseconds after
+    it was let go (0 by default, so pins change right away).
+
+    Key presses can be changed right away with press(), or scripted ahead of time with schedule()
+    and scheduleBounce(). Scripted changes happen when the simulated clock reaches their time.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef SIM_KEYPAD_CHIP_H
+#define SIM_KEYPAD_CHIP_H
+
+#include "Wire.h"
+
+#define SIM_SCRIPT_SIZE 64            // max number of scripted key changes waiting to happen
+#define SIM_MAX_PINS 16               // max number of pins on a chip
+
+
+class SimKeypadChip : public SimDevice {
+public:
+  SimKeypadChip();
+
+  void press(uint8_t rowPin, uint8_t colPin, bool down);  // press (or release) the key joining these two pins now
+  void releaseAll(void);                                  // release every key now, and throw away the script
+  bool schedule(unsigned long time, uint8_t rowPin, uint8_t colPin, bool down);  // press or release a key at time (micros)
+  bool scheduleBounce(unsigned long time, uint8_t rowPin, uint8_t colPin, bool down,
+                      uint8_t bounces, unsigned long bounceTime);  // the key changes at time, but bounces back and forth first
+  bool scriptDone(void);                                  // true if every scripted change has happened
+
+  virtual bool interruptAsserted(void) = 0;  // true if the INT pin is low
+  virtual void powerOnReset(void) = 0;       // set the chip to its power on state (like it was power cycled)
+  void connectInterruptPin(int pin);         // digitalRead(pin) reads this chip's INT pin
+
+  unsigned long riseTime;             // microseconds a pin takes to go high after it is let go
+
+protected:
+  uint16_t levels(uint16_t outputs, uint16_t latch);  // level of each pin (bit set if high), with these pins driven to their latch bit
+  void update(void);                  // make the scripted changes that are due, and sample the pins
+  virtual void sample(void) {}        // called after each key change (so a chip can catch a short bounce for its interrupt)
+
+private:
+  struct KeyChange {
+    unsigned long time;
+    uint8_t rowPin;
+    uint8_t colPin;
+    bool down;
+  };
+
+  void runScript(void);               // make the scripted changes that are due
+
+  bool _keys[SIM_MAX_PINS][SIM_MAX_PINS];  // _keys[a][b] is true if a key joining pins a and b is down
+  uint16_t _lastLevels;               // levels() the last time it was worked out, before the rise time
+  uint16_t _rising;                   // pins that were let go, but have not reached high yet
+  unsigned long _riseStart[SIM_MAX_PINS];  // time (micros) each rising pin was let go
+  KeyChange _script[SIM_SCRIPT_SIZE]; // scripted key changes, in time order
+  uint8_t _scriptLength;
+};
+
+extern SimKeypadChip *simIntDevice;   // chip whose INT pin is connected to simIntPin
+
+#endif
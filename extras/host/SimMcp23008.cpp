@@ -0,0 +1,111 @@
+/*
+  SimMcp23008.cpp
+
+  Short Description:
+
+    A simulated MCP23008 chip with a keypad wired to its pins.
+    See SimMcp23008.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "SimMcp23008.h"
+
+
+// class constructor
+SimMcp23008::SimMcp23008()
+{
+  powerOnReset();
+}
+
+// an i2c write transaction: the first byte sets the address pointer, and the rest are written to the registers
+// parameters
+//    data - bytes sent by the microcontroller (after the address byte)
+//    length - number of bytes
+// returns
+//    true (the chip always acknowledges)
+bool SimMcp23008::write(const uint8_t *data, uint8_t length)
+{
+  if (!length)
+    return true;
+  _pointer = data[0];
+  for (uint8_t i = 1; i < length; ++i)
+  {
+    uint8_t reg = _pointer == SIM_GPIO ? SIM_OLAT : _pointer;    // writing GPIO writes OLAT
+    if (reg <= SIM_OLAT && reg != SIM_INTF && reg != SIM_INTCAP)  // INTF and INTCAP are read only
+      registers[reg] = data[i];
+    if (!(registers[SIM_IOCON] & SIM_IOCON_SEQOP))
+      _pointer = _pointer >= SIM_OLAT ? 0 : _pointer + 1;
+  }
+  update();
+  return true;
+}
+
+// an i2c read transaction, starting at the address pointer
+// parameters
+//    data - the register values are copied here
+//    length - number of bytes to read
+// returns
+//    the number of bytes read
+uint8_t SimMcp23008::read(uint8_t *data, uint8_t length)
+{
+  update();
+  for (uint8_t i = 0; i < length; ++i)
+  {
+    data[i] = _pointer <= SIM_OLAT ? registers[_pointer] : 0;
+    if (_pointer == SIM_INTCAP || _pointer == SIM_GPIO)
+      registers[SIM_INTF] = 0;        // reading INTCAP or GPIO clears the interrupt
+    if (!(registers[SIM_IOCON] & SIM_IOCON_SEQOP))
+      _pointer = _pointer >= SIM_OLAT ? 0 : _pointer + 1;
+  }
+  update();
+  return length;
+}
+
+// work out the level of each pin
+// parameters
+//    none
+// returns
+//    bit n is set if pin n is high
+uint8_t SimMcp23008::pins(void)
+{
+  return levels(~registers[SIM_IODIR] & 0xff, registers[SIM_OLAT]) ^ (registers[SIM_IPOL] & registers[SIM_IODIR]);   // IPOL only inverts input pins
+}
+
+// returns true if the INT pin is low (open drain, active low)
+bool SimMcp23008::interruptAsserted(void)
+{
+  update();
+  return registers[SIM_INTF] != 0;
+}
+
+// set the registers to their power on values
+void SimMcp23008::powerOnReset(void)
+{
+  memset(registers, 0, sizeof(registers));
+  registers[SIM_IODIR] = 0xff;
+  _pointer = 0;
+  _lastGpio = pins();
+  registers[SIM_GPIO] = _lastGpio;
+}
+
+
+// protected functions ********************************
+
+// work out GPIO from the pins, and capture an interrupt if an enabled pin changed
+// (INTCON = 0 compares each pin with its last value, INTCON = 1 compares it with DEFVAL)
+void SimMcp23008::sample(void)
+{
+  uint8_t gpio = pins();
+  uint8_t compare = (registers[SIM_INTCON] & registers[SIM_DEFVAL]) | (~registers[SIM_INTCON] & _lastGpio);
+  uint8_t interrupts = (gpio ^ compare) & registers[SIM_GPINTEN];
+  if (interrupts && !registers[SIM_INTF])
+  {
+    registers[SIM_INTF] = interrupts;
+    registers[SIM_INTCAP] = gpio;
+  }
+  _lastGpio = gpio;
+  registers[SIM_GPIO] = gpio;
+}
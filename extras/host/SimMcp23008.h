@@ -0,0 +1,61 @@
+/*
+  SimMcp23008.h
+
+  Short Description:
+
+    A simulated MCP23008 chip with a keypad wired to its pins, for running the I2cKeypad library
+    on a host computer.
+
+    The register file works like the real chip: IODIR, IPOL, GPINTEN, DEFVAL, INTCON, IOCON (SEQOP),
+    GPPU, INTF, INTCAP, GPIO and OLAT. Writing GPIO writes OLAT, reading GPIO or INTCAP clears the
+    interrupt, and the address pointer increments unless SEQOP is set.
+
+    The keypad and the key presses are handled by SimKeypadChip.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef SIM_MCP23008_H
+#define SIM_MCP23008_H
+
+#include "SimKeypadChip.h"
+
+// registers in the MCP23008 chip
+#define SIM_IODIR     0x00
+#define SIM_IPOL      0x01
+#define SIM_GPINTEN   0x02
+#define SIM_DEFVAL    0x03
+#define SIM_INTCON    0x04
+#define SIM_IOCON     0x05
+#define SIM_GPPU      0x06
+#define SIM_INTF      0x07
+#define SIM_INTCAP    0x08
+#define SIM_GPIO      0x09
+#define SIM_OLAT      0x0A
+#define SIM_IOCON_SEQOP 0x20
+
+
+class SimMcp23008 : public SimKeypadChip {
+public:
+  SimMcp23008();
+
+  bool write(const uint8_t *data, uint8_t length);
+  uint8_t read(uint8_t *data, uint8_t length);
+
+  uint8_t pins(void);                 // level of each pin right now (bit set if high)
+  bool interruptAsserted(void);       // true if the INT pin is low
+  void powerOnReset(void);            // set the registers to their power on values (like the chip was power cycled)
+
+  uint8_t registers[SIM_OLAT + 1];    // the register file
+
+protected:
+  void sample(void);                  // work out GPIO, and set INTF and INTCAP if an interrupt pin changed
+
+private:
+  uint8_t _pointer;                   // register address pointer
+  uint8_t _lastGpio;                  // GPIO the last time it was worked out (for interrupt on change)
+};
+
+#endif
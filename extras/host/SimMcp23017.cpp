@@ -0,0 +1,134 @@
+/*
+  SimMcp23017.cpp
+
+  Short Description:
+
+    A simulated MCP23017 chip with a keypad wired to its pins.
+    See SimMcp23017.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "SimMcp23017.h"
+
+
+// class constructor
+SimMcp23017::SimMcp23017()
+{
+  powerOnReset();
+}
+
+// an i2c write transaction: the first byte sets the address pointer, and the rest are written to the registers
+// parameters
+//    data - bytes sent by the microcontroller (after the address byte)
+//    length - number of bytes
+// returns
+//    true (the chip always acknowledges)
+bool SimMcp23017::write(const uint8_t *data, uint8_t length)
+{
+  if (!length)
+    return true;
+  _pointer = data[0];
+  for (uint8_t i = 1; i < length; ++i)
+  {
+    uint8_t reg = _pointer >> 1;
+    uint8_t shift = (_pointer & 0x01) * 8;         // port B is the high byte
+    if (reg == SIM_GPIO)
+      reg = SIM_OLAT;                              // writing GPIO writes OLAT
+    if (reg == SIM_IOCON)
+      registers[reg] = data[i] | (data[i] << 8);   // both IOCON addresses are the same register
+    else if (reg <= SIM_OLAT && reg != SIM_INTF && reg != SIM_INTCAP)  // INTF and INTCAP are read only
+      registers[reg] = (registers[reg] & ~(0xff << shift)) | (data[i] << shift);
+    nextAddress();
+  }
+  update();
+  return true;
+}
+
+// an i2c read transaction, starting at the address pointer
+// parameters
+//    data - the register values are copied here
+//    length - number of bytes to read
+// returns
+//    the number of bytes read
+uint8_t SimMcp23017::read(uint8_t *data, uint8_t length)
+{
+  update();
+  for (uint8_t i = 0; i < length; ++i)
+  {
+    uint8_t reg = _pointer >> 1;
+    uint8_t shift = (_pointer & 0x01) * 8;
+    data[i] = reg <= SIM_OLAT ? registers[reg] >> shift : 0;
+    if (reg == SIM_INTCAP || reg == SIM_GPIO)
+      registers[SIM_INTF] &= ~(0xff << shift);     // reading INTCAP or GPIO clears the interrupt of that port
+    nextAddress();
+  }
+  update();
+  return length;
+}
+
+// work out the level of each pin
+// parameters
+//    none
+// returns
+//    bit n is set if pin n is high
+uint16_t SimMcp23017::pins(void)
+{
+  return levels(~registers[SIM_IODIR], registers[SIM_OLAT]) ^ (registers[SIM_IPOL] & registers[SIM_IODIR]);   // IPOL only inverts input pins
+}
+
+// returns true if the INTA pin is low (open drain, active low). With MIRROR set it shows the interrupts of both ports.
+bool SimMcp23017::interruptAsserted(void)
+{
+  update();
+  if (registers[SIM_IOCON] & SIM_IOCON_MIRROR)
+    return registers[SIM_INTF] != 0;
+  return (registers[SIM_INTF] & 0xff) != 0;
+}
+
+// set the registers to their power on values
+void SimMcp23017::powerOnReset(void)
+{
+  memset(registers, 0, sizeof(registers));
+  registers[SIM_IODIR] = 0xffff;
+  _pointer = 0;
+  _lastGpio = pins();
+  registers[SIM_GPIO] = _lastGpio;
+}
+
+
+// protected functions ********************************
+
+// work out GPIO from the pins, and capture an interrupt if an enabled pin changed. Each port has its own INTF and INTCAP.
+// (INTCON = 0 compares each pin with its last value, INTCON = 1 compares it with DEFVAL)
+void SimMcp23017::sample(void)
+{
+  uint16_t gpio = pins();
+  uint16_t compare = (registers[SIM_INTCON] & registers[SIM_DEFVAL]) | (~registers[SIM_INTCON] & _lastGpio);
+  uint16_t interrupts = (gpio ^ compare) & registers[SIM_GPINTEN];
+  for (uint8_t shift = 0; shift <= 8; shift += 8)
+  {
+    uint16_t port = 0xff << shift;
+    if ((interrupts & port) && !(registers[SIM_INTF] & port))
+    {
+      registers[SIM_INTF] |= interrupts & port;
+      registers[SIM_INTCAP] = (registers[SIM_INTCAP] & ~port) | (gpio & port);
+    }
+  }
+  _lastGpio = gpio;
+  registers[SIM_GPIO] = gpio;
+}
+
+
+// private functions ********************************
+
+// move the address pointer to the next register, or to the other port of the same register if SEQOP is set
+void SimMcp23017::nextAddress(void)
+{
+  if (registers[SIM_IOCON] & SIM_IOCON_SEQOP)
+    _pointer ^= 0x01;
+  else
+    _pointer = _pointer >= SIM_MCP23017_LAST_ADDRESS ? 0 : _pointer + 1;
+}
@@ -0,0 +1,55 @@
+/*
+  SimMcp23017.h
+
+  Short Description:
+
+    A simulated MCP23017 chip with a keypad wired to its pins, for running the I2cKeypad library
+    on a host computer.
+
+    The MCP23017 has the same registers as the MCP23008 for each of its two ports. Only IOCON.BANK = 0
+    (the power on value) is simulated: the port A register is at (register number * 2), and the port B
+    register is at the next address. Each register is kept as a 16 bit word, with port A in the low byte.
+    The address pointer increments unless SEQOP is set (then it toggles between the A and B registers),
+    reading GPIO or INTCAP clears the interrupt of that port, and with IOCON.MIRROR set the INTA pin
+    is low while either port has an interrupt.
+
+    The keypad and the key presses are handled by SimKeypadChip.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef SIM_MCP23017_H
+#define SIM_MCP23017_H
+
+#include "SimMcp23008.h"              // the register numbers are the same
+
+#define SIM_IOCON_MIRROR 0x40
+#define SIM_MCP23017_LAST_ADDRESS 0x15  // address of OLATB
+
+
+class SimMcp23017 : public SimKeypadChip {
+public:
+  SimMcp23017();
+
+  bool write(const uint8_t *data, uint8_t length);
+  uint8_t read(uint8_t *data, uint8_t length);
+
+  uint16_t pins(void);                // level of each pin right now (bit set if high, port B in the high byte)
+  bool interruptAsserted(void);       // true if the INTA pin is low
+  void powerOnReset(void);            // set the registers to their power on values (like the chip was power cycled)
+
+  uint16_t registers[SIM_OLAT + 1];   // the register file (port A in the low byte, port B in the high byte)
+
+protected:
+  void sample(void);                  // work out GPIO, and set INTF and INTCAP if an interrupt pin changed
+
+private:
+  void nextAddress(void);             // move the address pointer after a byte
+
+  uint8_t _pointer;                   // register address pointer
+  uint16_t _lastGpio;                 // GPIO the last time it was worked out (for interrupt on change)
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+  SimPcf8574.cpp
+
+  Short Description:
+
+    A simulated PCF8574 or PCF8575 chip with a keypad wired to its pins.
+    See SimPcf8574.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "SimPcf8574.h"
+
+
+// class constructor
+// parameters
+//    pinCount - 8 for a PCF8574, 16 for a PCF8575
+SimPcf8574::SimPcf8574(uint8_t pinCount)
+{
+  _portBytes = pinCount > 8 ? 2 : 1;
+  powerOnReset();
+}
+
+// an i2c write transaction: the bytes set the pins, one port after another
+// parameters
+//    data - bytes sent by the microcontroller (after the address byte)
+//    length - number of bytes
+// returns
+//    true (the chip always acknowledges)
+bool SimPcf8574::write(const uint8_t *data, uint8_t length)
+{
+  for (uint8_t i = 0; i < length; ++i)
+  {
+    uint8_t shift = (i % _portBytes) * 8;
+    port = (port & ~(0xff << shift)) | (data[i] << shift);
+  }
+  update();
+  _lastPins = pins();
+  return true;
+}
+
+// an i2c read transaction: the level of the pins, one port after another
+// parameters
+//    data - the pin levels are copied here
+//    length - number of bytes to read
+// returns
+//    the number of bytes read
+uint8_t SimPcf8574::read(uint8_t *data, uint8_t length)
+{
+  update();
+  uint16_t levels = pins();
+  for (uint8_t i = 0; i < length; ++i)
+    data[i] = levels >> ((i % _portBytes) * 8);
+  _lastPins = levels;
+  return length;
+}
+
+// work out the level of each pin (a pin written 0 is driven low, the others are pulled up weakly)
+// parameters
+//    none
+// returns
+//    bit n is set if pin n is high
+uint16_t SimPcf8574::pins(void)
+{
+  uint16_t mask = _portBytes > 1 ? 0xffff : 0x00ff;
+  return levels(~port & mask, 0) & mask;
+}
+
+// returns true if the INT pin is low (open drain, active low)
+bool SimPcf8574::interruptAsserted(void)
+{
+  update();
+  return ((pins() ^ _lastPins) & port) != 0;
+}
+
+// set every pin high
+void SimPcf8574::powerOnReset(void)
+{
+  port = 0xffff;
+  _lastPins = pins();
+}
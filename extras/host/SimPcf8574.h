@@ -0,0 +1,46 @@
+/*
+  SimPcf8574.h
+
+  Short Description:
+
+    A simulated PCF8574 (8 pins) or PCF8575 (16 pins) chip with a keypad wired to its pins, for
+    running the I2cKeypad library on a host computer.
+
+    These chips have no registers. Each byte written sets the pins of the next port (P0-P7, then
+    P10-P17 on the PCF8575): a 0 drives the pin low, and a 1 turns on a weak pullup, so the pin can
+    be used as an input. A read returns the level of the pins the same way. The power on value is
+    all 1s. The INT pin goes low when an input pin is different than it was at the last read or write
+    (and goes high again if the pin changes back).
+
+    The keypad and the key presses are handled by SimKeypadChip.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef SIM_PCF8574_H
+#define SIM_PCF8574_H
+
+#include "SimKeypadChip.h"
+
+
+class SimPcf8574 : public SimKeypadChip {
+public:
+  SimPcf8574(uint8_t pinCount = 8);   // 8 for a PCF8574, 16 for a PCF8575
+
+  bool write(const uint8_t *data, uint8_t length);
+  uint8_t read(uint8_t *data, uint8_t length);
+
+  uint16_t pins(void);                // level of each pin right now (bit set if high)
+  bool interruptAsserted(void);       // true if the INT pin is low
+  void powerOnReset(void);            // set every pin high (like the chip was power cycled)
+
+  uint16_t port;                      // the value last written to the pins
+
+private:
+  uint8_t _portBytes;                 // 1 for a PCF8574, 2 for a PCF8575
+  uint16_t _lastPins;                 // the pins at the last read or write (for the INT pin)
+};
+
+#endif
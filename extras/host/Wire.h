@@ -0,0 +1,84 @@
+/*
+  Wire.h (host version)
+
+  Short Description:
+
+    Stand-in for the Arduino Wire library. Each i2c transaction is passed to the simulated
+    device at that address (see SimDevice), and the simulated clock is moved forward by the time
+    the transaction would take on a real bus at the current clock rate (9 bit times per byte,
+    plus the start and stop conditions).
+
+    The number of transactions, the number of bytes (including the address byte) and the bus
+    time are counted, so the cost of a scan can be measured.
+
+    Errors can be made on purpose: failTransactions() makes the next transactions fail, and simSdaHeld
+    (see Arduino.h) makes every transaction time out until SCL has been clocked enough times.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+#define WIRE_BUFFER_SIZE 32           // same as the AVR Wire library
+
+// a simulated chip on the i2c bus
+class SimDevice {
+public:
+  virtual ~SimDevice() {}
+  virtual bool write(const uint8_t *data, uint8_t length) = 0;     // a write transaction (data[0] is usually the register address)
+  virtual uint8_t read(uint8_t *data, uint8_t length) = 0;         // a read transaction, returns the number of bytes read
+};
+
+
+class TwoWire {
+public:
+  TwoWire();
+
+  void begin(void) {}
+  void end(void) { ++ends; }
+  void setClock(uint32_t clock);
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  size_t write(uint8_t data);
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t address, uint8_t quantity);
+  uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+  int available(void);
+  int read(void);
+
+  void attach(uint8_t address, SimDevice *device);   // put a simulated chip on the bus at this address
+  void resetCounters(void);                          // set transactions, bytes and busMicros back to 0
+  SimDevice *device(uint8_t address);                // the simulated chip at this address (0 if there is none)
+  void countTransaction(uint8_t byteCount);          // count a transaction made without the Wire functions (see SimI2cDev.cpp)
+  void failTransactions(uint8_t count, uint8_t error);  // make the next count transactions fail, with endTransmission() returning error
+                                                     //    (2 = address NACK, 5 = timeout). A read that fails returns no bytes.
+
+  unsigned long transactions;         // number of i2c transactions (a write followed by a repeated start read counts as one)
+  unsigned long bytes;                // number of bytes on the bus, including the address bytes
+  unsigned long busMicros;            // simulated time the bus was busy
+  unsigned long ends;                 // number of end() calls (a bus recovery takes the pins back from the i2c hardware)
+
+private:
+  void busTime(uint8_t byteCount);    // count the bytes and move the simulated clock
+  uint8_t failure(void);              // the error for a transaction that fails on purpose, or 0
+
+  SimDevice *_devices[128];
+  uint32_t _clock;
+  uint8_t _address;
+  uint8_t _txBuffer[WIRE_BUFFER_SIZE];
+  uint8_t _txLength;
+  uint8_t _rxBuffer[WIRE_BUFFER_SIZE];
+  uint8_t _rxLength;
+  uint8_t _rxIndex;
+  uint8_t _failCount;                 // transactions left to fail (see failTransactions())
+  uint8_t _failError;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -21,6 +21,8 @@
 
   The keypad must connect to the I2C bus using a MCP23008 8 bit interface chip.
   A backback board with the MCP23008 chip is available and details are in the link below.
+  Bigger keypads (up to 16 row and column pins, like 8x8) can use a MCP23017 16 bit interface chip,
+  and a PCF8574 (8 bit) or PCF8575 (16 bit) chip can be used too (see the chipType parameter of the constructor).
 
 
   https://www.dcity.org/portfolio/i2c-keypad-library/
@@ -53,120 +55,711 @@
 #else                          // if using something else then this may work
 #include "I2cKeypad.h"
 #endif
+#include "I2cKeypadCodeMatcher.h"
+#include "I2cKeypadTrace.h"
 
 
 // class constructor
-I2cKeypad::I2cKeypad(char *keyMap, uint8_t *rowPins, uint8_t *colPins,  uint8_t rowNum, uint8_t colNum, uint16_t debounceTime, uint8_t i2cAddress)
+// parameters
+//    keyMap - array with the ASCII character for each key, one row after another
+//    rowPins, colPins - the chip pin (0-7, or 0-15 for a 16 bit chip) for each row and each column
+//    rowNum, colNum - number of rows and columns
+//    debounceTime - milliseconds a key must be down before it is saved
+//    i2cAddress - i2c address of the chip
+//    scanMode - KEYPAD_SCAN_COLUMNS, KEYPAD_SCAN_LINE_REVERSAL or KEYPAD_SCAN_MATRIX (which also needs setMatrix())
+//    chipType - KEYPAD_MCP23008, KEYPAD_MCP23017, KEYPAD_PCF8574 or KEYPAD_PCF8575
+I2cKeypad::I2cKeypad(char *keyMap, uint8_t *rowPins, uint8_t *colPins,  uint8_t rowNum, uint8_t colNum, uint16_t debounceTime, uint8_t i2cAddress,
+                     uint8_t scanMode, uint8_t chipType, KEYPAD_LAYOUT)
 {
   // save the provided parameters into private variables
   _keyMap = keyMap;
+  _pinTables = 0;                   // look up the pins in the arrays (I2cKeypadT gives the keypad its tables)
   _rowPins = rowPins;
   _colPins = colPins;
   _rowNum = rowNum;
   _colNum = colNum;
   _debounceTime = debounceTime;
+  _activeInterval = debounceTime;   // scan once each debounce time, until setScanRates() is called
+  _idleInterval = debounceTime;
+  _idleDelay = 0;
+  _pressSamples = 0;                // debounce by time, until setDebounceSamples() is called
+  _releaseSamples = 1;
+  _repeatDelay = 0;                 // no repeat or long press, until setRepeat() or setLongPress() is called
+  _repeatRate = 0;
+  _longPressTime = 0;
+  _repeatKeys = 0;
+  _longPressKeys = 0;
+  _heldKey = NO_KEYS_PRESSED;
   _i2cAddress = i2cAddress;
+  _scanMode = scanMode;
+  _chipType = chipType;
+  _portBytes = (chipType == KEYPAD_MCP23017 || chipType == KEYPAD_PCF8575) ? 2 : 1;
+
+  _eventQueue = 0;                // use the keypad's own buffer, until setEventQueue() is called
+  _matrix = 0;
+  _codeMatcher = 0;
+#if KEYPAD_TRACE
+  _trace = 0;
+  _traceReadPosition = 0;
+#endif
+
+  _mcpRegistersValid = 0;         // we don't know what is in the chip's registers yet
+
+  _interruptMode = false;
+  _interruptPin = KEYPAD_NO_INTERRUPT_PIN;
+  _interruptPending = false;
+
+  _isrProducer = false;
+  _waitHook = 0;
+
+  _inputActive = false;
+
+  _scanStep = SCAN_STEP_IDLE;
+  _scanBudget = 0;
 
-  _keyBufferHead = 0;
-  _keyBufferTail = 0;
+  _errorState = KEYPAD_ERROR_NONE;
+  _retries = KEYPAD_I2C_RETRIES;
+  _retryTime = KEYPAD_RETRY_TIME;
+  _sdaPin = KEYPAD_NO_PIN;          // no bus recovery, until setBusRecoveryPins() is called
+  _sclPin = KEYPAD_NO_PIN;
+  _chipCheckInterval = KEYPAD_CHIP_CHECK_INTERVAL;
+  _settleTime = KEYPAD_SETTLE_TIME;
+  _i2cClock = KEYPAD_I2C_CLOCK;   // we don't know the i2c clock (unless the transport does), until it is given to begin()
 }
 
 
 // public functions
 
 // perform setup needed for this library - the user should call this function once during setup()
-void I2cKeypad::begin()
+// parameters
+//    i2cClock - i2c clock rate in Hz (like 400000), or 0 to leave the clock as it is. The clock is set again after a bus
+//               recovery (see setBusRecoveryPins()), and knowing it lets the scan leave out the part of the settle time
+//               that the i2c read already takes. On Linux the clock can't be changed here, so give the clock the bus runs at.
+// returns
+//    nothing
+void I2cKeypad::begin(uint32_t i2cClock)
 {
-  // create a mask byte where each row pin will have a high bit in _inputPinsMask (keypad rows are inputs on the MCP23008 chip)
-  _inputPinsMask = 0;
-  for (uint8_t r = 0; r < _rowNum; ++r)
-    bitSet(_inputPinsMask, _rowPins[r]);     // set the bit for each pin that is in the row array
-
-  // set up registers in the MCP230008
-  mcpWriteByte(MCP_IODIR, _inputPinsMask);   // write 1's for the bits that are inputs
-  mcpWriteByte(MCP_IPOL, 0);                 // don't invert the polarity of any input pins
-  mcpWriteByte(MCP_GPINTEN, 0);              // no interrupt pins are enabled
-  mcpWriteByte(MCP_DEFVAL, 0);               // we are not defining a default value for interrupts
-  mcpWriteByte(MCP_INTCON, 0);               // interrupt control register... not used
-  mcpWriteByte(MCP_IOCON, MCP_IOCON_VALUE);  // configuration register... see the I2cKeypad.h file for info on MCP_IOCON_VALUE
-  mcpWriteByte(MCP_GPPU, 0xff);              // set all input pins to have pullup resistor
-  // mcpWriteByte(MCP_INTF, 0);              // Interrupt Flag is read only... no need to initialize it
-  // mcpWriteByte(MCP_INTCAP, 0);            // Interrupt Capture is read only... no need to initialize it
-  // mcpWriteByte(MCP_GPIO, 0);              // GPIO is read only... no need to initialize it
-  mcpWriteByte(MCP_OLAT, 0);                 // Output Latch: set all the output pins low initially
+  if (i2cClock)
+  {
+    _i2cClock = i2cClock;
+#ifndef KEYPAD_LINUX_I2CDEV
+    Wire.setClock(i2cClock);
+#endif
+  }
+  updateColumnWait();
+
+  // create a mask where each row pin will have a high bit in _inputPinsMask (keypad rows are inputs on the chip)
+  _inputPinsMask = rowPinsMask();
+#if KEYPAD_STATISTICS
+  resetStatistics();
+#endif
+
+#if defined(WIRE_HAS_TIMEOUT) && KEYPAD_WIRE_TIMEOUT
+  Wire.setWireTimeout(KEYPAD_WIRE_TIMEOUT, true);  // give up on a stuck i2c transaction instead of waiting forever
+#endif
+
+  // set up registers in the chip. If the chip does not answer, the error state is set and the first
+  //    scan that reaches it sets up the registers.
+  _errorState = KEYPAD_ERROR_NONE;
+  expanderSetup();
 
   _lastScanTime = millis();                  // set the current time
+  _lastActivityTime = _lastScanTime;
+  _lastChipCheckTime = _lastScanTime;
   _keypadState = WAITING_FOR_NEW_KEY_PRESS;  // set our state variable used in scanKeys()
+  _heldKey = NO_KEYS_PRESSED;
+  _scanStep = SCAN_STEP_IDLE;                // no scan in progress
+  if (_scanMode == KEYPAD_SCAN_MATRIX && !_matrix)
+    _scanMode = KEYPAD_SCAN_COLUMNS;         // there is nowhere to keep the state of each key
+  if (_matrix)
+    _matrix->clear();
 
 }
 
 
 
 
-// Scans the keypad for valid keys, and puts valid keys into _keyBuffer[] (which is a private buffer used by this library)
+// Scans the keypad for valid keys, and puts valid keys into the keypad buffer (which is a private buffer used by this library)
 // This function is called by most of the functions in this library to check if there are any keys being pressed.
 // The user should call this function (or one of the functions that calls this function) often (every 10ms or less), so that keys are not missed.
 // This function should be run often in loop(), unless you are using some timer feature that calls this function often (every 10ms is a good period).
+// If setScanBudget() was used, a scan that needs more i2c transactions than the budget is finished by the next calls.
+// If the chip can't be reached, the scan is given up without changing the keys (see getErrorState()).
+// parameters
+//    none
+// returns
+//    true if a full scan of the keypad was finished (or given up because of an i2c error) by this call
+// new key presses are added to the keypad buffer.
+bool I2cKeypad::scanKeys(void)
+{
+  if (_scanStep == SCAN_STEP_IDLE)
+  {
+    if (!startScan())
+      return false;
+#if KEYPAD_STATISTICS
+    _scanTime = 0;
+#endif
+  }
+#if KEYPAD_STATISTICS
+  unsigned long startTime = micros();
+#endif
+  for (uint8_t steps = 1; !scanStep(); ++steps)
+  {
+    if (_scanBudget && steps >= _scanBudget)
+    {
+#if KEYPAD_STATISTICS
+      _scanTime += micros() - startTime;
+#endif
+      return false;             // out of i2c transactions for this call... continue the scan next time
+    }
+  }
+  if (_errorState != KEYPAD_ERROR_NONE)
+  {
+    KEYPAD_COUNT(failedScans);
+    return true;
+  }
+  KEYPAD_COUNT(scans);
+#if KEYPAD_STATISTICS
+  countScanTime(_scanTime + micros() - startTime);
+#endif
+  return true;
+}
+
+// limit the time one scanKeys() call can take. Finding which key is pressed can take a lot of i2c transactions
+// (2 for each column with KEYPAD_SCAN_COLUMNS), so a big keypad can hold up loop() for a few milliseconds.
+// With a budget, each call does at most this many i2c transactions, and the scan picks up where it left off on
+// the next call. A key is found after getMaxScanSteps() / steps calls.
+// parameters
+//    steps - max number of i2c transactions in one call (0 = finish the whole scan in one call, the default)
+// returns
+//    nothing
+void I2cKeypad::setScanBudget(uint8_t steps)
+{
+  _scanBudget = steps;
+}
+
+// return the most i2c transactions that one full scan can take, so you can work out the worst case time
+// for a scan (each transaction is at most 4 bytes on the bus).
+// parameters
+//    none
+// returns
+//    max number of scan steps (i2c transactions) for one scan
+// Note: the check that the chip was not reset is counted. Setting up its registers again after a reset (or after an i2c error)
+//          takes 2 more, and each failed transaction can be tried again (see setRetries()).
+uint8_t I2cKeypad::getMaxScanSteps(void)
+{
+  uint8_t steps = (_interruptMode && mcpChip()) ? 3 : 2;  // the chip check, reading INTF and INTCAP, and the quick check
+  uint8_t lineSteps = combinedTransfers() ? 1 : 2;        // drive some lines and read the others (in one transfer if they can be)
+  if (_scanMode == KEYPAD_SCAN_LINE_REVERSAL)
+    return steps + lineSteps + 1;             // drive the rows, read the columns, restore
+  return steps + lineSteps * _colNum + 1;     // drive and read each column, restore
+}
+
+// return the time until scanKeys() will scan the keypad again. Calling scanKeys() before then does not use the i2c bus,
+// so the program can sleep (or do other work) until then without finding keys any later.
 // parameters
 //    none
 // returns
+//    milliseconds until the next scan, 0 if one is due (or a scan is in progress, see setScanBudget())
+//    KEYPAD_NO_SCAN_SCHEDULED in interrupt mode while no keys are down, and no chip check is due (only the INT pin starts a scan)
+uint16_t I2cKeypad::timeUntilNextScan(void)
+{
+  unsigned long currentTime = millis();
+  unsigned long elapsed;
+  unsigned long interval;
+
+  if (_scanStep != SCAN_STEP_IDLE)
+    return 0;
+  if (_interruptMode && _keypadState == WAITING_FOR_NEW_KEY_PRESS && _errorState == KEYPAD_ERROR_NONE)
+  {
+    if (interruptPending())
+      return 0;
+    if (!_chipCheckInterval)
+      return KEYPAD_NO_SCAN_SCHEDULED;
+    elapsed = currentTime - _lastChipCheckTime;
+    interval = _chipCheckInterval;
+  }
+  else
+  {
+    elapsed = currentTime - _lastScanTime;
+    interval = scanInterval();
+  }
+  if (elapsed >= interval)
+    return 0;
+  interval -= elapsed;
+  return interval < KEYPAD_NO_SCAN_SCHEDULED ? interval : KEYPAD_NO_SCAN_SCHEDULED - 1;
+}
+
+// set how often scanKeys() scans the keypad. While a key is down (or being debounced) the keypad is scanned every
+// activeInterval, so key presses and releases are found quickly. Once no keys have been down for idleDelay, it is only
+// scanned every idleInterval, which saves i2c bus time (a new key press is found within idleInterval, and then the
+// debounce time). Until this is called, both intervals are the debounce time.
+// The debounce time is not changed by this... a key still has to be pressed for the debounce time before it is saved.
+// parameters
+//    activeInterval - milliseconds between scans while keys are active
+//    idleInterval - milliseconds between scans while the keypad is idle
+//    idleDelay - milliseconds with no keys down before switching to idleInterval
+// returns
 //    nothing
-// new key presses are added to the _keyBuffer[] array.
-void I2cKeypad::scanKeys(void)
+void I2cKeypad::setScanRates(uint16_t activeInterval, uint16_t idleInterval, uint16_t idleDelay)
 {
-  int key;    // value returned from checkForKeyPress()
-  // just return if we have not waited debounce time, since the last time we were in this function
-  if ((millis() - _lastScanTime) <= _debounceTime)
-    return;
+  _activeInterval = activeInterval;
+  _idleInterval = idleInterval;
+  _idleDelay = idleDelay;
+}
+
+// debounce keys by counting scans instead of by time. A key is saved once pressSamples scans in a row have found it,
+// and it is released once releaseSamples scans in a row have found no keys (with KEYPAD_SCAN_MATRIX each key keeps
+// its own history, so the counts are for that key). A short active scan interval (see setScanRates()) with a few
+// samples finds keys much sooner than the debounce time, while a bouncing key still restarts the count.
+// For example setScanRates(2, 20, 500) with setDebounceSamples(4, 3) saves a key after 4 scans that are 2ms apart
+// (plus the time the scans take), instead of after one to two debounce times.
+// parameters
+//    pressSamples - scans in a row that must find the key pressed (2-8), or 0 to go back to using the debounce time
+//    releaseSamples - scans in a row that must find the key released (1-8)
+// returns
+//    nothing
+void I2cKeypad::setDebounceSamples(uint8_t pressSamples, uint8_t releaseSamples)
+{
+  if (pressSamples)
+  {
+    _pressSamples = constrain(pressSamples, 2, 8);
+    _releaseSamples = constrain(releaseSamples, 1, 8);
+  }
+  else
+  {
+    _pressSamples = 0;
+    _releaseSamples = 1;      // a key is released by the first scan that finds no keys
+  }
+  if (_matrix)
+    _matrix->clear();
+  _sampleCount = 0;
+}
+
+// make keys repeat while they are held down (like a computer keyboard). Once a key has been held for repeatDelay, a
+// KEY_EVENT_REPEAT event is saved every repeatRate, which getKey() returns like another press of the key. The repeats
+// come from the scans that already run while the key is down (at the active scan interval, see setScanRates()), so they
+// don't use the i2c bus, and they are only as exact as that interval. With KEYPAD_SCAN_MATRIX only the last key pressed
+// repeats while it is held, like a computer keyboard (pressing another key stops it, and releasing that one doesn't start it again).
+// For example setRepeat(500, 100, "0123456789") repeats the number keys 10 times a second after half a second.
+// parameters
+//    repeatDelay - milliseconds a key is held before the first repeat, or 0 for no repeat
+//    repeatRate - milliseconds between repeats after that
+//    keys - the ASCII values (from the keyMap array) of the keys that repeat, or 0 for all of the keys. The string is
+//           read while the keys are held (it is not copied), so it must stay there: a string constant is fine.
+// returns
+//    nothing
+void I2cKeypad::setRepeat(uint16_t repeatDelay, uint16_t repeatRate, const char *keys)
+{
+  _repeatDelay = repeatDelay;
+  _repeatRate = repeatRate ? repeatRate : 1;
+  _repeatKeys = keys;
+}
+
+// save a KEY_EVENT_LONG_PRESS event once a key has been held down for longPressTime (once for each press). getKey()
+// skips these events, so read them with getKeyEvent() or getEvent(). Like the repeats, long presses come from the scans
+// that already run while the key is down. With KEYPAD_SCAN_MATRIX only the last key pressed has a long press (see setRepeat()).
+// parameters
+//    longPressTime - milliseconds a key is held before the long press is saved, or 0 for no long presses
+//    keys - the ASCII values (from the keyMap array) of the keys that have long presses, or 0 for all of the keys
+//           (like setRepeat(), the string is not copied)
+// returns
+//    nothing
+void I2cKeypad::setLongPress(uint16_t longPressTime, const char *keys)
+{
+  _longPressTime = longPressTime;
+  _longPressKeys = keys;
+}
+
+// give the keypad somewhere to keep the state of each key for KEYPAD_SCAN_MATRIX (the other scan modes don't use it).
+// A keypad with KEYPAD_SCAN_MATRIX and no matrix is scanned with KEYPAD_SCAN_COLUMNS by begin(). The matrix can't be
+// shared with another keypad. For example:
+//     I2cKeypadMatrixBuffer<4, 4> matrix;
+//     keypad.setMatrix(&matrix);          // then keypad.begin()
+// parameters
+//    matrix - the matrix, with room for at least the keypad's rows and columns (0 = none)
+// returns
+//    true if the matrix was saved, false if it is too small for the keypad
+bool I2cKeypad::setMatrix(I2cKeypadMatrix *matrix)
+{
+  if (matrix && (matrix->_maxRows < _rowNum || matrix->_maxCols < _colNum))
+    return false;
+  _matrix = matrix;
+  if (!_matrix && _scanMode == KEYPAD_SCAN_MATRIX)
+    _scanMode = KEYPAD_SCAN_COLUMNS;
+  return true;
+}
+
+
+// return the time to wait between scans, which depends on whether keys have been active lately (see setScanRates())
+// parameters
+//    none
+// returns
+//    milliseconds between scans
+uint16_t I2cKeypad::scanInterval(void)
+{
+  if (_keypadState != WAITING_FOR_NEW_KEY_PRESS || (millis() - _lastActivityTime) < _idleDelay)
+    return _activeInterval;
+  return _idleInterval;
+}
+
+// start a new keypad scan, if it is time for one
+// parameters
+//    none
+// returns
+//    true if a scan was started
+bool I2cKeypad::startScan(void)
+{
+  // the scan starts by checking that the chip was not reset, every _chipCheckInterval and after each i2c error
+  bool checkChip = _errorState != KEYPAD_ERROR_NONE ||
+                   (_chipCheckInterval && (millis() - _lastChipCheckTime) >= _chipCheckInterval);
+
+  // In interrupt mode we don't touch the i2c bus while waiting for a new key press, unless the chip has
+  // signaled a change on the INT pin (or it is time for the chip check). When it has, we start scanning right away
+  // instead of waiting for the debounce time. After an i2c error we poll, until the chip answers again.
+  if (_interruptMode && _keypadState == WAITING_FOR_NEW_KEY_PRESS && _errorState == KEYPAD_ERROR_NONE)
+  {
+    if (interruptPending())
+    {
+      _interruptPending = false;
+      KEYPAD_RECORD(KEYPAD_TRACE_WAKE, 0);
+    }
+    else if (!checkChip)
+      return false;
+    _scanStep = mcpChip() ? SCAN_STEP_READ_INTERRUPT : SCAN_STEP_QUICK_CHECK;  // reading a PCF chip's pins clears its interrupt
+  }
+  // just return if we have not waited the scan interval, since the last scan
+  else if ((millis() - _lastScanTime) < scanInterval())
+    return false;
+  else
+  {
+    // While a key is down we are polling. Clear the interrupt flag before the quick check reads GPIO (which clears
+    //    the INT pin), so that a change after that read will set the flag again.
+    _interruptPending = false;
+    _scanStep = SCAN_STEP_QUICK_CHECK;
+  }
+  if (checkChip)
+    _scanStep = SCAN_STEP_CHECK_CHIP;
 
   _lastScanTime = millis();     // save _lastScanTime with the current time now
+  return true;
+}
+
+// run one step of the keypad scan. Each step uses the i2c bus at most once (plus retries), so the time it takes is known.
+// When the last step is done, the keys that were found are given to the keypad state machine (or to updateMatrix()).
+// If an i2c transaction fails, the scan is given up and the keys are not changed.
+// parameters
+//    none
+// returns
+//    true if the scan is finished
+// Note: The scan expects the IODIR register to have the value of _inputPinsMask (which is all 1s for inputs and 0s for the other bits)
+//          and the OLAT register to be set to 0 (all 0s on the output pins) when it starts, and leaves them that way when it is done.
+//          This is so that we can quickly check for key presses with one read of GPIO.
+bool I2cKeypad::scanStep(void)
+{
+  uint16_t inputPort;    // value read from the chip's input pins
+  uint16_t bits;         // bit set for each row (or column) that is low
+
+  switch (_scanStep)
+  {
+    case SCAN_STEP_CHECK_CHIP:
+      {
+        // If the chip was reset (a power glitch, or its RESET pin), it lost the setup from begin(). After an i2c error
+        //    we can't be sure of any of its registers either. Either way the chip is set up again, which is the only time
+        //    a step uses the i2c bus more than once.
+        bool wasReset;
+        _lastChipCheckTime = millis();
+        if (!expanderCheck(wasReset))
+          return scanFailed();
+        KEYPAD_RECORD(KEYPAD_TRACE_CHECK, wasReset);
+        if (wasReset)
+          KEYPAD_COUNT(chipResets);
+        if ((wasReset || _errorState != KEYPAD_ERROR_NONE) && !expanderSetup())
+          return scanFailed();
+        // go on with the scan startScan() would have started (after an error we poll, since an interrupt may have been missed)
+        if (_interruptMode && _keypadState == WAITING_FOR_NEW_KEY_PRESS && _errorState == KEYPAD_ERROR_NONE && mcpChip())
+          _scanStep = SCAN_STEP_READ_INTERRUPT;
+        else
+          _scanStep = SCAN_STEP_QUICK_CHECK;
+        return false;
+      }
+
+    case SCAN_STEP_READ_INTERRUPT:
+      {
+        // read INTF and INTCAP in one transaction (reading INTCAP clears the interrupt in the MCP chip).
+        // If no row pin caused the interrupt, then there is nothing to scan.
+        uint16_t interruptRegisters[2];
+        if (!mcpReadRegisters(MCP_INTF, interruptRegisters, 2))
+          return scanFailed();
+        KEYPAD_RECORD(KEYPAD_TRACE_INTERRUPT, interruptRegisters[0]);
+        if (!(interruptRegisters[0] & _inputPinsMask))
+        {
+          _scanStep = SCAN_STEP_IDLE;
+          return true;
+        }
+        _scanStep = SCAN_STEP_QUICK_CHECK;
+        return false;
+      }
+
+    case SCAN_STEP_QUICK_CHECK:
+      _scanResult = NO_KEYS_PRESSED;
+      _scanColumn = 0;
+      if (_scanMode == KEYPAD_SCAN_MATRIX)
+        memset(_matrix->_scanKeys, 0, _rowNum * sizeof(uint16_t));
+      // we do a quick check here to see if any keys are pressed... that way we don't have to do the more complicated check below
+      //     in the case where no keys are pressed (which is most of the time).
+      // If any GPIO pins (that are configured as inputs) are low, then we must have some switch pressed. If they are all high, then no key is pressed, and we are done.
+      //    To test this, we see if this is true (meaning no keys pressed):    !(GPIO port & _inputPinsMask) ^ _inputPinsMask
+      //    We read the input port, AND it with  _inputPinsMask and then XOR the result with _inputPinsMask (which checks if any of the inputs pins are not high)
+      //    After the ^ XOR operation the result will be non-zero if one of the input pins does not match the mask (meaning some key is pressed). We negate it (using !) to get a 0 result if no key pressed.
+      if (!expanderReadPins(inputPort))
+        return scanFailed();
+      KEYPAD_RECORD(KEYPAD_TRACE_QUICK_CHECK, inputPort);
+      if ( !((inputPort & _inputPinsMask) ^ _inputPinsMask)   )
+      {
+        KEYPAD_COUNT(quickChecks);
+        break;                                 // no keys pressed
+      }
+      KEYPAD_COUNT(sweeps);
+      if (_scanMode == KEYPAD_SCAN_LINE_REVERSAL)
+      {
+        // find the row that is low... if more than one row is low, then more than one key is pressed
+        _scanRows = decodeRows(inputPort);
+        if (_scanRows & (_scanRows - 1))
+        {
+          _scanResult = MULTIPLE_KEYS_PRESSED; // we have not changed any MCP registers yet, so nothing to restore
+          break;
+        }
+        _scanStep = SCAN_STEP_REVERSE_LINES;
+      }
+      else
+        _scanStep = SCAN_STEP_DRIVE_COLUMN;
+      return false;
+
+    // find the pressed key by driving one column low at a time, and reading the row pins for each column
+    case SCAN_STEP_DRIVE_COLUMN:
+      if (!combinedTransfers())
+      {
+        if (!expanderWriteDirection(columnDirection(_scanColumn)))  // write to the MCP IODIR register to make this one pin an output
+          return scanFailed();
+                                               //     We make only one pin be an output so that if multiple keys
+                                               //     are pressed we don't get two output pins shorted together
+                                               //     (and they could be at different levels)
+                                               // The output latch is already 0 from the quick check state, which makes the one output pin low
+                                               //     (the latch bits of the input pins don't matter)
+        _columnTime = micros();
+        _scanStep = SCAN_STEP_READ_COLUMN;
+        return false;
+      }
+      // the rows settle before the read samples them, so drive the column and read the rows in one transfer
+      if (!expanderWriteReadPins(columnDirection(_scanColumn), inputPort))
+        return scanFailed();
+      // fall through - the rows have been read
+
+    case SCAN_STEP_READ_COLUMN:
+      if (_scanStep == SCAN_STEP_READ_COLUMN)
+      {
+        waitToSettle();                        // wait for the latch signal to propagate to the input pins
+        if (!expanderReadPins(inputPort))
+          return scanFailed();
+      }
+      KEYPAD_RECORD(KEYPAD_TRACE_COLUMN | _scanColumn, inputPort);
+      bits = decodeRows(inputPort);            // find the row pins that are low, meaning a key is pressed for this column/row
+      if (_scanMode == KEYPAD_SCAN_MATRIX)
+      {
+        for (uint8_t row = 0; bits; ++row, bits >>= 1)
+        {
+          if (bits & 0x01)
+            bitSet(_matrix->_scanKeys[row], _scanColumn);
+        }
+      }
+      else if (bits)
+      {
+        // we have a key press at this col
+        // check if some other key has already been detected (or two rows are low)... if so the result is MULTIPLE_KEYS_PRESSED,
+        //    and there is no need to read the rest of the columns.
+        if (_scanResult != NO_KEYS_PRESSED || (bits & (bits - 1)))
+        {
+          _scanResult = MULTIPLE_KEYS_PRESSED;
+          _scanStep = SCAN_STEP_RESTORE;
+          return false;
+        }
+        // else we have a new key being pressed
+        _scanResult = lowestBit(bits) * _colNum + _scanColumn;   // index of the key in the _keyMap array
+      }
+      _scanStep = (++_scanColumn < _colNum) ? SCAN_STEP_DRIVE_COLUMN : SCAN_STEP_RESTORE;
+      return false;
+
+    // KEYPAD_SCAN_LINE_REVERSAL: the rows have already been read (with all the columns low), so now we make the rows
+    //    outputs (they are driven low, since OLAT is 0) and read the columns. The row and column that are low give us the key.
+    //    This takes the same number of i2c transactions no matter how big the keypad is.
+    //    Driving all the rows low at once is safe, since every output pin is at the same level.
+    case SCAN_STEP_REVERSE_LINES:
+      if (!combinedTransfers())
+      {
+        if (!expanderWriteDirection(~_inputPinsMask))  // make the rows outputs (low), and the columns inputs with pullups
+          return scanFailed();
+        _columnTime = micros();
+        _scanStep = SCAN_STEP_READ_REVERSED;
+        return false;
+      }
+      if (!expanderWriteReadPins(~_inputPinsMask, inputPort))  // reverse the lines and read the columns in one transfer
+        return scanFailed();
+      // fall through - the columns have been read
+
+    case SCAN_STEP_READ_REVERSED:
+      if (_scanStep == SCAN_STEP_READ_REVERSED)
+      {
+        waitToSettle();                        // the columns that were low have to rise through their pullups
+        if (!expanderReadPins(inputPort))
+          return scanFailed();
+      }
+      KEYPAD_RECORD(KEYPAD_TRACE_REVERSED, inputPort);
+      bits = decodeColumns(inputPort);                   // read the columns
+      // find the column that is low... if more than one column is low, then more than one key is pressed in this row
+      if (bits & (bits - 1))
+        _scanResult = MULTIPLE_KEYS_PRESSED;
+      else if (_scanRows && bits)
+        _scanResult = lowestBit(_scanRows) * _colNum + lowestBit(bits);
+      // else the key was released while we were scanning
+      _scanStep = SCAN_STEP_RESTORE;
+      return false;
+
+    case SCAN_STEP_RESTORE:
+      // Return the MCP to it's quick key checking state, so that the next scan can quickly check for a key press
+      if (!expanderWriteDirection(_inputPinsMask))   // set all input pins to be inputs, and the rest to be outputs (OLAT is still 0, so they are low)
+        return scanFailed();
+      // A PCF chip only pulls its INT pin low when a pin is different than at the last read or write, so a key that
+      //    settled after its column was read would not be seen. One more quick check makes sure.
+      if (_interruptMode && !mcpChip())
+        _interruptPending = true;
+      break;
 
+    default:                    // SCAN_STEP_IDLE
+      return true;
+  }
+
+  // the scan is finished
+  _scanStep = SCAN_STEP_IDLE;
+  _errorState = KEYPAD_ERROR_NONE;
+#if KEYPAD_TRACE
+  uint8_t lastState = _keypadState;
+#endif
+  if (_scanMode == KEYPAD_SCAN_MATRIX)
+    updateMatrix();             // every key is debounced on it's own, so the state machine is not used
+  else
+    updateKeyState(_scanResult);
+#if KEYPAD_TRACE
+  if (_keypadState != lastState)
+    KEYPAD_RECORD(KEYPAD_TRACE_STATE, _scanResult);
+#endif
+  if (_keypadState != WAITING_FOR_NEW_KEY_PRESS)
+    _lastActivityTime = millis();   // keys are down (or bouncing), so keep scanning fast
+  return true;
+}
+
+// give up the scan in progress because an i2c transaction failed (the error state has already been set).
+// The keys are not changed, since we don't know what the keypad did. The next scan starts with the chip check,
+// which sets up the chip again (a failed write may have left a column driven low).
+// parameters
+//    none
+// returns
+//    true (the scan is over)
+bool I2cKeypad::scanFailed(void)
+{
+  KEYPAD_RECORD(KEYPAD_TRACE_ERROR, _errorState);
+  _scanStep = SCAN_STEP_IDLE;
+  return true;
+}
+
+// This is the keypad state machine, which runs after each scan (except with KEYPAD_SCAN_MATRIX)
+// parameters
+//    key - the key found by the scan: the index in _keyMap[] (row * _colNum + col), NO_KEYS_PRESSED or MULTIPLE_KEYS_PRESSED
+// returns
+//    nothing
+// new key presses are added to the keypad buffer.
+void I2cKeypad::updateKeyState(int key)
+{
   // this is a state machine, where we jump to a different case depending on what we are waiting for to happen
   switch(_keypadState)
   {
     case WAITING_FOR_NEW_KEY_PRESS:         // this state is waiting for a new keypress to occur
-      key = checkForKeyPress();
       // check if we have a valid key pressed, and only 1 key pressed
       if (key >= 0)
       {
         // we have a valid key
         _keypadState = WAITING_DEBOUNCE_TIME;   // go to waiting for debounce time state
+        _debounceStartTime = _lastScanTime;     // the key has to stay pressed for the debounce time from this scan
+        _sampleCount = 1;                       // (or for _pressSamples scans, counting this one)
       }
       // check if multiple keys are pressed (which we don't allow... it is considered the same as no keys pressed)
       else if (key == MULTIPLE_KEYS_PRESSED)
       {
         _keypadState = WAITING_FOR_NO_KEYS_PRESSED;   // go to waiting for no keys to be pressed, since we have to many keys pressed
+        _sampleCount = 0;
       }
       // else we have no keys pressed, so we will stay in this state
       break;
     case WAITING_DEBOUNCE_TIME:           // this state is used after a key was pressed and we are waiting for the debounce time to have passed.
-      key = checkForKeyPress();
-      // check if the same key is pressed as in the previous state... if so then we have a valid key with enough debounce time
+      // check if the same key is pressed as in the previous state... if so then we have a valid key once it has been pressed for the debounce time
       if (key == _lastKeyPressed)
       {
-        // we have a valid key
-        _keyBuffer[_keyBufferHead] = key;                   // save key in _keyBuffer[]
-        _keyBufferHead = (_keyBufferHead + 1) % KEYPAD_BUFFER_SIZE; // increment the index in the buffer array
-        _keypadState = WAITING_FOR_NO_KEYS_PRESSED;   // go to waiting for no keys to be pressed
+        ++_sampleCount;
+        if (_pressSamples ? _sampleCount >= _pressSamples : (_lastScanTime - _debounceStartTime) >= _debounceTime)
+        {
+          // we have a valid key
+          addKeyEvent(key, KEY_EVENT_PRESSED);            // save key in the keypad buffer
+          _keypadState = WAITING_FOR_NO_KEYS_PRESSED;   // go to waiting for no keys to be pressed
+          _sampleCount = 0;
+          _heldKey = key;                               // the repeats and long press are timed from this scan
+          _holdStartTime = _lastScanTime;
+          _nextRepeat = _repeatDelay;
+          _longPressSaved = false;
+        }
       }
       // check if multiple keys are pressed
       else if (key == MULTIPLE_KEYS_PRESSED)
       {
         _keypadState = WAITING_FOR_NO_KEYS_PRESSED;   // go to waiting for no keys to be pressed, since we have to many keys pressed
+        _sampleCount = 0;
       }
       // check if no keys are pressed
       else if (key == NO_KEYS_PRESSED)
       {
         _keypadState = WAITING_FOR_NEW_KEY_PRESS;   // go to waiting for new keys to be pressed, since we have no keys pressed
+        KEYPAD_COUNT(bouncesRejected);
+      }
+      // else a different key is pressed, so the debounce time starts over for that key
+      else
+      {
+        _debounceStartTime = _lastScanTime;
+        _sampleCount = 1;
+        KEYPAD_COUNT(bouncesRejected);
       }
       break;
     case WAITING_FOR_NO_KEYS_PRESSED:               // this state is used when we are waiting for the last keypress to be released.
-      key = checkForKeyPress();
-      // change state only if no keys are pressed
+      // change state only if no keys are pressed (in _releaseSamples scans in a row)
       if (key == NO_KEYS_PRESSED)
       {
         // we have no keys pressed
-        _keypadState = WAITING_FOR_NEW_KEY_PRESS;   // go to waiting for debounce time state
+        if (++_sampleCount >= _releaseSamples)
+        {
+          _keypadState = WAITING_FOR_NEW_KEY_PRESS;   // go to waiting for debounce time state
+          _heldKey = NO_KEYS_PRESSED;
+        }
+      }
+      else
+      {
+        if (_sampleCount)
+        {
+          _sampleCount = 0;           // a key bounced, so start counting again
+          KEYPAD_COUNT(bouncesRejected);
+        }
+        // the scans that wait for the key to be released also time its repeats and long press
+        if (key == _heldKey)
+          holdKey();
+        else
+          _heldKey = NO_KEYS_PRESSED; // another key (or more than one) is down, so the held key stops repeating
       }
       break;
     default:
@@ -186,12 +779,14 @@ void I2cKeypad::scanKeys(void)
 //    else returns the number of keys available to read from the buffer
 uint8_t I2cKeypad::getKeyCount(void)
 {
-  scanKeys();             // scan keypad for more keys to be pressed
-  return (KEYPAD_BUFFER_SIZE + _keyBufferHead - _keyBufferTail) % KEYPAD_BUFFER_SIZE;
+  if (!_isrProducer)
+    scanKeys();           // scan keypad for more keys to be pressed
+  return keyBufferCount();
 }
 
 
-// peek at the key in the keypad buffer, but don't remove it from the buffer (you can still run getKey() to retreive it)
+// peek at the key in the keypad buffer, but don't remove it from the buffer (you can still run getKey() to retreive it).
+// Nothing is removed from the buffer, so the release, code and long press events in front of the key are still there for getEvent().
 // parameters
 //    none
 // returns
@@ -199,15 +794,14 @@ uint8_t I2cKeypad::getKeyCount(void)
 //    the ASCII value of the next key (from the keyMap array)
 uint8_t I2cKeypad::peekKey(void)
 {
-  scanKeys();             // scan keypad for more keys to be pressed
-  if (_keyBufferHead == _keyBufferTail) {
-    return RETURN_NO_KEY_IN_BUFFER;
-  } else {
-    return _keyBuffer[_keyBufferTail];
-  }
+  if (!_isrProducer)
+    scanKeys();           // scan keypad for more keys to be pressed
+  return readKeyBuffer(false);
 }
 
-// get the next key from the keypad buffer
+// get the next key from the keypad buffer. The release, code and long press events in front of the key are thrown away
+// (they are only saved with KEYPAD_SCAN_MATRIX, setCodeMatcher() or setLongPress()), so read those with getEvent() instead
+// of getKey() when you want them.
 // parameters
 //    none
 // returns
@@ -215,32 +809,113 @@ uint8_t I2cKeypad::peekKey(void)
 //     the ASCII value of the next key pressed (from the keyMap array)
 uint8_t I2cKeypad::getKey(void)
 {
-  scanKeys();             // scan keypad for more keys to be pressed
-  // if the head isn't ahead of the tail, we don't have any characters
-  if (_keyBufferHead == _keyBufferTail) {
+  if (!_isrProducer)
+    scanKeys();           // scan keypad for more keys to be pressed
+  return readKeyBuffer(true);
+}
+
+// get the next key event from the keypad buffer. With KEYPAD_SCAN_MATRIX there are events for keys being released,
+// as well as for keys being pressed, with setCodeMatcher() there are events for codes being entered, and with
+// setRepeat() and setLongPress() there are events for keys being held down (getKey() and peekKey() return the
+// repeats like presses, and skip over the release, code and long press events, which getKey() throws away).
+// parameters
+//    eventType - set to KEY_EVENT_PRESSED, KEY_EVENT_RELEASED, KEY_EVENT_CODE, KEY_EVENT_REPEAT or KEY_EVENT_LONG_PRESS
+//                (not changed if there is no key in the buffer)
+// returns
+//     RETURN_NO_KEY_IN_BUFFER if there is no key in the buffer
+//     the ASCII value of the key (from the keyMap array), or the number of the code for KEY_EVENT_CODE
+uint8_t I2cKeypad::getKeyEvent(uint8_t *eventType)
+{
+  KeypadEvent event;
+  if (!getEvent(event))
     return RETURN_NO_KEY_IN_BUFFER;
-  } else {
-    uint8_t c = _keyBuffer[_keyBufferTail];
-    _keyBufferTail = (_keyBufferTail + 1) % KEYPAD_BUFFER_SIZE;
-    return c;
-  }
+  *eventType = event.type;
+  return event.key;
+}
+
+// get the next event from the keypad buffer. Each event has the key, it's row and column, the type of event,
+// and the time it was saved (micros()).
+// parameters
+//    event - the event is copied here
+// returns
+//    true if there was an event, false if the buffer is empty
+bool I2cKeypad::getEvent(KeypadEvent &event)
+{
+  if (!_isrProducer)
+    scanKeys();           // scan keypad for more keys to be pressed
+  return eventQueue().pop(event);
+}
+
+// save key events in your own queue instead of the keypad's own buffer (for example one that holds more events, or
+// one that is shared by several keypads). Events already in the keypad's own buffer (or in a queue that was given to
+// an earlier call) are left there. Set KEYPAD_BUFFER_SIZE to make the keypad's own buffer smaller or bigger.
+// Call this before scanKeys() runs from a timer (see setIsrProducerMode()).
+// parameters
+//    eventQueue - the queue to use (for example an I2cKeypadEventBuffer<64>)
+// returns
+//    nothing
+void I2cKeypad::setEventQueue(I2cKeypadEventQueue &eventQueue)
+{
+  _eventQueue = &eventQueue;
+  _eventQueue->setInterruptWriter(_isrProducer);
+}
+
+// tell the library that scanKeys() is being called from a timer (or an interrupt routine), instead of from loop().
+// The functions that read keys (getKey(), peekKey(), getKeyCount(), flushKeys(), getEvent(), getKeyEvent(), getKeyUntil())
+// then only read the keypad buffer. They don't call scanKeys() themselves, so they never use the i2c bus and can't
+// run at the same time as the timer's scan. The keypad buffer can be written by the timer and read in loop() without
+// turning off interrupts.
+// Note: scanKeys() uses the i2c bus, so the timer must be one that allows that (for example a Particle software Timer).
+// parameters
+//    enable - true if scanKeys() is called from a timer
+// returns
+//    nothing
+void I2cKeypad::setIsrProducerMode(bool enable)
+{
+  _isrProducer = enable;
+  eventQueue().setInterruptWriter(enable);
+}
+
+// check the keys pressed for any of a list of codes. scanKeys() feeds each key pressed to the matcher, and when a key
+// finishes a code, a KEY_EVENT_CODE event is saved right after the key's own event. The code event has the number of
+// the code (from 1) as its key, and the row, column and time of the key that finished it.
+// parameters
+//    codeMatcher - the matcher, with its codes already set up by I2cKeypadCodeMatcher::begin() (0 = stop checking for codes)
+// returns
+//    nothing
+void I2cKeypad::setCodeMatcher(I2cKeypadCodeMatcher *codeMatcher)
+{
+  _codeMatcher = codeMatcher;
+}
+
+// return the queue that key events are saved in, so its overflow policy and dropped event count can be used
+// parameters
+//    none
+// returns
+//    the event queue
+I2cKeypadEventQueue &I2cKeypad::getEventQueue(void)
+{
+  return eventQueue();
 }
 
-// flush out the _keyBuffer  (removes all previous unread keys from the keypad buffer)
+// flush out the keypad buffer  (removes all previous unread keys from the keypad buffer)
 // parameters
 //    none
 // returns
 //    nothing
 void I2cKeypad::flushKeys(void)
 {
-  scanKeys();             // scan keypad for more keys to be pressed
-  _keyBufferTail = _keyBufferHead;  // empty the buffer
+  if (!_isrProducer)
+    scanKeys();           // scan keypad for more keys to be pressed
+  flushKeyBuffer();
 }
 
 
 
 
 // get one keypad character or wait UNTIL one key is pressed OR we timeout
+// Between scans, the wait hook (see setWaitHook()) is called with the time until the next scan. Without a wait hook,
+// this keeps checking the keypad (calling yield() so other tasks can run), and uses all of the CPU while it waits.
 // parameters
 //    timeoutPeriod - amount of time we will wait for one keypad character in milliseconds. If 0, then we
 //                      will wait forever for a key press
@@ -260,154 +935,1585 @@ uint8_t I2cKeypad::getKeyUntil(uint16_t timeoutPeriod)
     // could take a long time to finish if no keys are pressed on the keypad.
     #ifdef PARTICLE
       Particle.process();           // keep particle happy if we block for a long time
+    #else
+      yield();                      // let other tasks run (and keep the watchdog happy on boards like the ESP8266)
     #endif
 
     // check if the timeout feature is enabled (i.e. timeoutPeriod > 0) and if we have timed out
-    if (timeoutPeriod && (millis() - currentTime) >= timeoutPeriod)
+    unsigned long waited = millis() - currentTime;
+    if (timeoutPeriod && waited >= timeoutPeriod)
     {
       return RETURN_NO_KEY_IN_BUFFER;                       // return RETURN_NO_KEY_IN_BUFFER of we timed out before key was pressed.
     }
     key = getKey(); // read a key from the keypad buffer, this function also calls scanKeys() to check for more keypresses
-    // if there aren't any chars in the keypad buffer, then just continue to try again
+    // if there aren't any chars in the keypad buffer, then give the time until the next scan to the wait hook, and try again
     if (key == RETURN_NO_KEY_IN_BUFFER)
     {
+      if (_waitHook)
+      {
+        uint16_t waitTime = timeUntilNextScan();
+        if (timeoutPeriod && waitTime > timeoutPeriod - waited)
+          waitTime = timeoutPeriod - waited;
+        if (waitTime)
+          _waitHook(waitTime);
+      }
       continue;                 // no keys to read
     }
     return key;   // return the ASCII keypad value
   }
 }
 
+// give getKeyUntil() a function to call while it waits for the next scan, instead of checking the keypad over and over.
+// The function is called with the milliseconds until the next scan (see timeUntilNextScan()), or until the timeout if
+// that is sooner. It can sleep (or run other tasks) for that long, so keys are found just as soon as without it.
+// In interrupt mode the wait can be long (KEYPAD_NO_SCAN_SCHEDULED), so the function must return when the INT pin
+// wakes the processor up. The same goes for setIsrProducerMode(), where the timer's scan finds the keys.
+// For example on an ESP32 (without interrupt mode), this lets the other FreeRTOS tasks run until the next scan:
+//    void keypadWait(uint16_t waitTime) { vTaskDelay(pdMS_TO_TICKS(waitTime)); }
+// parameters
+//    waitHook - the function to call, or 0 to go back to checking the keypad until a key is found
+// returns
+//    nothing
+void I2cKeypad::setWaitHook(I2cKeypadWaitHook waitHook)
+{
+  _waitHook = waitHook;
+}
 
 
 
+// get a string of keys (for example a code or a PIN), without waiting for it. Call this from loop() until it returns
+// something other than WAITING_FOR_MORE_KEYS. Each call adds the keys that have been pressed since the last call to the
+// keys array (which always ends with a 0, so it can be shown while it is being typed). The first call starts a new entry.
+// Only the entry in progress is kept by the library, so the same array must be used for each call of one entry.
+// parameters
+//    keys - array where the keys are saved. It must hold maxKeys + 1 chars.
+//    maxKeys - the entry is finished when this many keys have been entered (with 0 it is finished right away, and no keys are used)
+//    timeoutPeriod - the entry is finished this many milliseconds after the first call (0 = no timeout)
+//    terminatorKey - the entry is finished when this key is pressed (it is not saved in keys). 0 = no terminator key.
+//    backspaceKey - this key removes the last key that was entered. 0 = no backspace key.
+// returns
+//    WAITING_FOR_MORE_KEYS if the entry is not finished
+//    TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED when it is finished (keys has the entry)
+int I2cKeypad::getKeysUntil(char *keys, uint8_t maxKeys, uint16_t timeoutPeriod, uint8_t terminatorKey, uint8_t backspaceKey)
+{
+  uint8_t key;      // key read from the keypad buffer (getKey() never returns 0, so a key that is 0 never matches)
 
-
-// private functions ********************************
-
-// check keypad for key presses
-// parameters:
-//    none
-// return:
-//    NO_KEYS_PRESSED (-1)  if no keys pressed
-//    MULTIPLE_KEYS_PRESSED (-2)  if multiple keys pressed
-//    else if there is a valid key it returns the value from _keyMap[] for the key that is pressed (0-255)
-//  Note: This code expects that the IODIR register to have the value of _inputPinsMask (which is all 1s for inputs and 0s for the other bits).
-//          and the OLAT register to be set to 0 (all 0s on the output pins).
-//          This so so that we can quickly check of any key presses with the first line of code in this function.
-int I2cKeypad::checkForKeyPress(void)
-{
-  bool keyPressed = 0;      // set if a key is pressed
-  int  key = NO_KEYS_PRESSED;            // returned key value
-  uint8_t outputLatch;   // value to write to the mcp output latch
-  uint8_t inputPort;     // value read from the mcp input pins
-
-  // we do a quick check here to see if any keys are pressed... that way we don't have to do the more complicated check below
-  //     in the case where no keys are pressed (which is most of the time).
-  // If any GPIO pins (that are configured as inputs) are low, then we must have some switch pressed. If they are all high, then no key is pressed, and we just return.
-  //    To test this, we see if this is true (meaning no keys pressed):    !(GPIO port & _inputPinsMask) ^ _inputPinsMask
-  //    We read the input port, AND it with  _inputPinsMask and then XOR the result with _inputPinsMask (which checks if any of the inputs pins are not high)
-  //    After the ^ XOR operation the result will be non-zero if one of the input pins does not match the mask (meaning some key is pressed). We negate it (using !) to get a 0 result if no key pressed.
-  // we do not have a key pressed if the follwing is true (note the negation operator)
-  if ( !((mcpReadByte(MCP_GPIO) & _inputPinsMask) ^ _inputPinsMask)   )
-    return NO_KEYS_PRESSED;
-
-  // for each column, check if any row pins are low
-  for (uint8_t col = 0; col < _colNum; ++col)
+  if (!maxKeys)
   {
-    outputLatch = 0xff;
-    bitClear(outputLatch, _colPins[col]);      // clear the bit for this column output pin
-    mcpWriteByte(MCP_IODIR, outputLatch);      // write to the MCP IODIR register to make this one pin an output
-                                               //     We make only one pin be an output so that if multiple keys
-                                               //     are pressed we don't get two output pins shorted together
-                                               //     (and they could be at different levels)
-    mcpWriteByte(MCP_OLAT, outputLatch);       // write to the MCP output latch to make the one output pin low
-    delayMicroseconds(10);                     // wait for the latch signal to propagate to the input pins
-    inputPort = mcpReadByte(MCP_GPIO);         // read the input port
-    // for each row pin, check if the pin is low, meaning a key is pressed for this column/row
-    for (uint8_t row = 0; row < _rowNum; ++row)
+    keys[0] = 0;    // keys only has room for the 0 at the end
+    return MAX_NUM_CHARACTERS_REACHED;
+  }
+  if (startInput())
+    keys[0] = 0;
+  while ((key = getKey()) != RETURN_NO_KEY_IN_BUFFER)
+  {
+    if (key == terminatorKey)
+      return endInput(TERMINATOR_CHAR_RECEIVED);
+    if (key == backspaceKey)
     {
-      // check if this row pin is low
-      if (bitRead(inputPort, _rowPins[row]) == 0)
-      {
-        // we have a key press at this row and col
-        // check if some other key has already been detected... if so return MULTIPLE_KEYS_PRESSED.
-        if (keyPressed)
-        {
-          // Return the MCP to it's quick key checking state, so that when we come back to the function we can quickly check for a key press
-          // Set all input pins to be inputs, and the rest to be outputs...
-          mcpWriteByte(MCP_IODIR, _inputPinsMask);   // set all input pins to be inputs, and the rest to be outputs
-          // write all output pins to LOW so we can check if any of the input pins are not low later on (meaning a key is pressed)
-          mcpWriteByte(MCP_OLAT, 0);
-          return MULTIPLE_KEYS_PRESSED;
-        }
-        // else we have a new key being pressed
-        else
-        {
-          keyPressed = 1;
-          key = _keyMap[row * _colNum + col];                // get the key out of the
-        }
+      if (_inputLength)
+        keys[--_inputLength] = 0;
+      continue;
+    }
+    keys[_inputLength++] = key;
+    keys[_inputLength] = 0;
+    if (_inputLength >= maxKeys)
+      return endInput(MAX_NUM_CHARACTERS_REACHED);
+  }
+  if (timeoutPeriod && (millis() - _inputStartTime) >= timeoutPeriod)
+    return endInput(TIMEOUT_PERIOD_EXCEEDED);
+  return WAITING_FOR_MORE_KEYS;
+}
+
+// get a whole number from the digit keys ('0' to '9'), without waiting for it. This works like getKeysUntil(), but each
+// key is added to the number as it arrives, so no string is saved. Keys that are not digits (or one of the keys below) are ignored.
+// parameters
+//    value - set to the number entered so far on each call
+//    maxDigits - the entry is finished when this many digits have been entered (at most KEYPAD_MAX_DIGITS)
+//    timeoutPeriod - the entry is finished this many milliseconds after the first call (0 = no timeout)
+//    terminatorKey - the entry is finished when this key is pressed. 0 = no terminator key.
+//    backspaceKey - this key removes the last digit (or the minus sign). 0 = no backspace key.
+//    minusKey - this key makes the number negative (only before the first digit). 0 = no minus key.
+// returns
+//    WAITING_FOR_MORE_KEYS if the entry is not finished
+//    TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED when it is finished
+int I2cKeypad::getIntUntil(long &value, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                           uint8_t backspaceKey, uint8_t minusKey)
+{
+  maxDigits = constrain(maxDigits, 1, KEYPAD_MAX_DIGITS);
+  int status = readNumber(maxDigits, maxDigits, 0, timeoutPeriod, terminatorKey, 0, backspaceKey, minusKey);
+  value = _inputNegative ? -_inputValue : _inputValue;
+  return status;
+}
+
+// get a number with a decimal point as a fixed point whole number, without waiting for it (and without using floating point,
+// which is slow and large on small microcontrollers). The number is returned times 10^decimals, so with decimals = 2
+// "12.5" is returned as 1250 and "7" as 700. Digits after the first decimals digits following the decimal point are ignored.
+// This works like getIntUntil() otherwise.
+// parameters
+//    value - set to the number entered so far on each call (times 10^decimals)
+//    decimals - number of digits after the decimal point that are kept (maxDigits - decimals digits are left before it)
+//    maxDigits - the entry is finished when this many digits have been entered (at most KEYPAD_MAX_DIGITS)
+//    timeoutPeriod - the entry is finished this many milliseconds after the first call (0 = no timeout)
+//    terminatorKey - the entry is finished when this key is pressed. 0 = no terminator key.
+//    decimalPointKey - the key used for the decimal point (only the first one counts)
+//    backspaceKey - this key removes the last digit, decimal point or minus sign. 0 = no backspace key.
+//    minusKey - this key makes the number negative (only before the first digit). 0 = no minus key.
+// returns
+//    WAITING_FOR_MORE_KEYS if the entry is not finished
+//    TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED when it is finished
+int I2cKeypad::getFixedUntil(long &value, uint8_t decimals, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                             uint8_t decimalPointKey, uint8_t backspaceKey, uint8_t minusKey)
+{
+  maxDigits = constrain(maxDigits, 1, KEYPAD_MAX_DIGITS);
+  decimals = constrain(decimals, 0, maxDigits);
+  int status = readNumber(maxDigits, maxDigits - decimals, decimals, timeoutPeriod, terminatorKey, decimalPointKey, backspaceKey, minusKey);
+  value = _inputValue;
+  // scale up by the decimal places that were not entered (the whole number can only have maxDigits - decimals digits,
+  //    so this can't overflow)
+  for (int8_t i = _inputDecimals < 0 ? 0 : _inputDecimals; i < decimals; ++i)
+    value *= 10;
+  if (_inputNegative)
+    value = -value;
+  return status;
+}
+
+// get a number with a decimal point, without waiting for it. The digits are kept as a whole number and a count of the
+// digits after the decimal point, and only turned into a float once on each call (no string or atof() is needed).
+// This works like getIntUntil() otherwise.
+// parameters
+//    value - set to the number entered so far on each call
+//    maxDigits - the entry is finished when this many digits have been entered (at most KEYPAD_MAX_DIGITS)
+//    timeoutPeriod - the entry is finished this many milliseconds after the first call (0 = no timeout)
+//    terminatorKey - the entry is finished when this key is pressed. 0 = no terminator key.
+//    decimalPointKey - the key used for the decimal point (only the first one counts)
+//    backspaceKey - this key removes the last digit, decimal point or minus sign. 0 = no backspace key.
+//    minusKey - this key makes the number negative (only before the first digit). 0 = no minus key.
+// returns
+//    WAITING_FOR_MORE_KEYS if the entry is not finished
+//    TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED when it is finished
+int I2cKeypad::getFloatUntil(float &value, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                             uint8_t decimalPointKey, uint8_t backspaceKey, uint8_t minusKey)
+{
+  maxDigits = constrain(maxDigits, 1, KEYPAD_MAX_DIGITS);
+  int status = readNumber(maxDigits, maxDigits, maxDigits, timeoutPeriod, terminatorKey, decimalPointKey, backspaceKey, minusKey);
+  long scale = 1;
+  for (int8_t i = 0; i < _inputDecimals; ++i)
+    scale *= 10;
+  value = (float)_inputValue / scale;
+  if (_inputNegative)
+    value = -value;
+  return status;
+}
+
+// throw away the entry in progress for getKeysUntil(), getIntUntil(), getFixedUntil() or getFloatUntil(), so the next call
+// starts a new entry (for example when the user leaves a menu in the middle of typing a number). Keys still in the keypad
+// buffer are not removed.
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::cancelInput(void)
+{
+  _inputActive = false;
+}
+
+
+
+
+
+
+// use the chip's INT pin to find out when keys change, so the keypad is not polled over the i2c bus while no keys are pressed.
+// A MCP chip is set up so that any change on a row pin pulls the INT pin low (open drain, so a pullup is needed). On the MCP23017
+// the INTA and INTB pins are joined (mirrored), so either one can be used. A PCF chip pulls its INT pin low when any input pin
+// changes, and needs no setup.
+// Call this after begin().
+// parameters
+//    interruptPin - the microcontroller pin connected to the chip's INT pin, which scanKeys() will check with digitalRead().
+//                   Use KEYPAD_NO_INTERRUPT_PIN (the default) if you attach your own interrupt routine to the INT pin instead,
+//                   and call interruptReceived() from it.
+// returns
+//    nothing
+void I2cKeypad::enableInterrupts(uint8_t interruptPin)
+{
+  _interruptPin = interruptPin;
+  if (_interruptPin != KEYPAD_NO_INTERRUPT_PIN)
+    pinMode(_interruptPin, INPUT_PULLUP);
+  if (mcpChip())
+  {
+    uint16_t interruptSetup[3];
+    interruptSetup[0] = _inputPinsMask;      // GPINTEN: only the row pins (inputs) can cause an interrupt
+    interruptSetup[1] = 0;                   // DEFVAL: not used
+    interruptSetup[2] = 0;                   // INTCON: compare each pin against its previous value, so we get an interrupt on press and release
+    mcpWriteRegisters(MCP_GPINTEN, interruptSetup, 3);
+  }
+  _interruptMode = true;
+  _interruptPending = true;                  // check the keypad once, in case a key was already down
+}
+
+// stop using the chip's INT pin, and go back to polling the keypad every debounce period
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::disableInterrupts(void)
+{
+  if (mcpChip())
+    mcpWriteRegister(MCP_GPINTEN, 0);
+  _interruptMode = false;
+  _interruptPending = false;
+}
+
+// let the library know that the chip's INT pin has gone low.
+// This only sets a flag (no i2c bus use), so it can be called from an interrupt routine. The keypad is read the next time scanKeys() runs.
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::interruptReceived(void)
+{
+  _interruptPending = true;
+}
+
+
+
+
+// rewrite all of the chip registers with the values the library last wrote to them.
+// The library keeps a copy of the chip registers, so that it does not have to read a register before changing
+// some of its bits, and so that it can skip writing a register that already has the right value.
+// If the chip was reset (or an i2c bus error may have left a register with the wrong value) then the copy does not
+// match the chip anymore, so call this function to write the copy back into the chip. For a PCF chip the port is written again.
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::resyncRegisters(void)
+{
+  uint16_t valid = _mcpRegistersValid;
+  uint16_t registers[MCP_OLAT + 1];
+  memcpy(registers, _mcpRegisters, sizeof(registers));
+  if (!mcpChip())
+  {
+    _mcpRegistersValid = 0;
+    pcfWrite(bitRead(valid, MCP_IODIR) ? registers[MCP_IODIR] : _inputPinsMask);
+    return;
+  }
+  registers[MCP_GPIO] = registers[MCP_OLAT]; // writing GPIO writes the Output Latch
+  _mcpRegistersValid = 0;                    // force every write below to go out on the i2c bus
+  // if we have a copy of IOCON, write it first (it turns on sequential operation), and then write the rest in one transaction
+  if (bitRead(valid, MCP_IOCON))
+  {
+    mcpWriteRegister(MCP_IOCON, registers[MCP_IOCON]);
+    if (mcpSequentialMode() && valid == MCP_WRITABLE_REGISTERS)
+    {
+      mcpWriteRegisters(MCP_IODIR, registers, MCP_OLAT + 1);
+      return;
+    }
+  }
+  for (uint8_t reg = MCP_IODIR; reg <= MCP_OLAT; ++reg)
+  {
+    if (bitRead(valid, reg))
+      mcpWriteRegister(reg, registers[reg]);
+  }
+}
+
+// set how long the rows get to settle after a column is driven low, before they are read. The row that the last column
+// pulled low has to rise back up through its pullup resistor, which takes longer with long wires or weak pullups.
+// Part of this time is taken by the i2c read itself (if begin() was given the clock), so at 100kHz the default
+// needs no extra wait at all. See calibrateSettleTime() to measure it.
+// parameters
+//    settleTime - microseconds from driving a column low until the rows are read (the default is KEYPAD_SETTLE_TIME)
+// returns
+//    nothing
+void I2cKeypad::setSettleTime(uint16_t settleTime)
+{
+  _settleTime = settleTime;
+  updateColumnWait();
+}
+
+// return the settle time (microseconds from driving a column low until the rows are read)
+uint16_t I2cKeypad::getSettleTime(void)
+{
+  return _settleTime;
+}
+
+// measure how long the rows and columns take to settle with this keypad's wiring and pullups, and use twice that as the
+// settle time. The columns are let go (with the rows driven low, like KEYPAD_SCAN_LINE_REVERSAL does), and then the rows
+// are let go (with the columns driven low again, like a column lets go of a row in the scan), and the lines that were let
+// go are read after a wait each time. The wait starts at 0 and doubles until every line reads high KEYPAD_CALIBRATE_TRIES
+// times in a row. If they are high with no wait, the i2c transaction already covers the settle time and the scan does
+// not wait at all.
+// Run this after begin() with no keys pressed (a scan in progress is given up). It uses a few dozen i2c transactions.
+// parameters
+//    none
+// returns
+//    false if the rows did not settle within KEYPAD_SETTLE_MAX microseconds (a key is down, or the rows have no pullups),
+//    or the chip could not be reached. The settle time is not changed.
+bool I2cKeypad::calibrateSettleTime(void)
+{
+  uint16_t wait = 0;
+  bool settled = false;
+
+  _scanStep = SCAN_STEP_IDLE;
+  while (!settled)
+  {
+    settled = true;
+    for (uint8_t i = 0; i < KEYPAD_CALIBRATE_TRIES && settled; ++i)
+    {
+      uint16_t inputPort;
+      if (!expanderWriteDirection(~_inputPinsMask))  // rows low, and let go of the columns
+        return false;
+      if (wait)
+        delayMicroseconds(wait);
+      if (!expanderReadPins(inputPort))
+        return false;
+      settled = !decodeColumns(inputPort);
+      if (!expanderWriteDirection(_inputPinsMask))   // columns low, and let go of the rows (the way the pins are left between scans)
+        return false;
+      if (wait)
+        delayMicroseconds(wait);
+      if (!expanderReadPins(inputPort))
+        return false;
+      settled = settled && !decodeRows(inputPort);
+    }
+    if (!settled)
+    {
+      if (wait >= KEYPAD_SETTLE_MAX)
+        return false;
+      wait = wait ? wait * 2 : 1;
+    }
+  }
+  // the rows were read sampleTime() after the read started, so that is part of the time they took
+  setSettleTime(wait * 2 + sampleTime());
+  return true;
+}
+
+// return the state of the i2c bus to the keypad. When a transaction fails (after its retries), the scan is given up,
+// and the error stays set until a scan works again. Scans keep going while there is an error (each one tries to reach
+// the chip once, without retries), so a keypad that is unplugged and plugged back in starts working again by itself.
+// parameters
+//    none
+// returns
+//    KEYPAD_ERROR_NONE if the last scan worked
+//    KEYPAD_ERROR_NACK if the chip did not acknowledge
+//    KEYPAD_ERROR_SHORT_READ if the chip sent fewer bytes than were asked for
+//    KEYPAD_ERROR_BUS_STUCK if SDA is held low (see setBusRecoveryPins())
+//    KEYPAD_ERROR_TIMEOUT if the Wire library gave up on the transaction (see KEYPAD_WIRE_TIMEOUT)
+uint8_t I2cKeypad::getErrorState(void)
+{
+  return _errorState;
+}
+
+// set how hard the library tries when an i2c transaction fails. A failed transaction is tried again up to retries
+// times, as long as less than retryTime microseconds have gone by since the first try, so a faulty keypad can only hold
+// up one scan step for about retryTime (plus one transaction). The defaults are KEYPAD_I2C_RETRIES and KEYPAD_RETRY_TIME.
+// parameters
+//    retries - times a failed transaction is tried again (0 = don't retry)
+//    retryTime - max microseconds spent retrying one transaction
+// returns
+//    nothing
+void I2cKeypad::setRetries(uint8_t retries, uint16_t retryTime)
+{
+  _retries = retries;
+  _retryTime = retryTime;
+}
+
+// give the library the microcontroller's SDA and SCL pins, so it can free the i2c bus when a chip is holding SDA low
+// (this happens if the microcontroller was reset in the middle of a read). Before the last retry of a transaction that
+// timed out, or that failed with SDA low, SCL is clocked until the chip lets go of SDA, and then a stop condition is sent.
+// A transaction that was not acknowledged never does this.
+// For most boards use setBusRecoveryPins(SDA, SCL). The Wire library is stopped and started again to do this.
+// parameters
+//    sdaPin - the microcontroller pin used for SDA
+//    sclPin - the microcontroller pin used for SCL
+// returns
+//    nothing
+void I2cKeypad::setBusRecoveryPins(uint8_t sdaPin, uint8_t sclPin)
+{
+  _sdaPin = sdaPin;
+  _sclPin = sclPin;
+}
+
+// set how often the scan checks that the chip was not reset (by reading IOCON or the PCF pins, one short i2c transaction).
+// A reset chip has lost the register setup from begin(), so it can't be scanned (or signal an interrupt) until its
+// registers are set up again, which the check does by itself. In interrupt mode this is the only i2c use while the
+// keypad is idle, so it is off by default (KEYPAD_CHIP_CHECK_INTERVAL): turn it on if the chip can be reset by itself
+// (its own power supply, or a RESET pin driven by something else), a few seconds is usually enough.
+// parameters
+//    interval - milliseconds between checks (0 = never check, except after an i2c error)
+// returns
+//    nothing
+void I2cKeypad::setChipCheckInterval(uint16_t interval)
+{
+  _chipCheckInterval = interval;
+}
+
+
+
+
+#if KEYPAD_STATISTICS
+// return the counters the library keeps, to see what scanning the keypad costs: how much the i2c bus is used
+// (and how many errors there were), how scans ended, how many keys were saved, rejected as bounces or dropped
+// because the keypad buffer was full, and a histogram of how long scans take.
+// They count from begin() or the last resetStatistics(). Only there when KEYPAD_STATISTICS is set to 1.
+// parameters
+//    none
+// returns
+//    the counters (see KeypadStatistics in I2cKeypad.h)
+const KeypadStatistics &I2cKeypad::getStatistics(void)
+{
+  return _statistics;
+}
+
+// set all the statistics counters back to 0
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::resetStatistics(void)
+{
+  memset(&_statistics, 0, sizeof(_statistics));
+}
+#endif
+
+#if KEYPAD_TRACE
+// save a sample in a trace each time the scan reads the chip's pins (and when the state machine changes state, a key
+// event is saved, or a scan fails), so a missed or doubled key in the field can be looked at later (see I2cKeypadTrace.h).
+// Only there when KEYPAD_TRACE is set to 1.
+// parameters
+//    trace - the trace, for example an I2cKeypadTraceBuffer<128> (0 = stop saving samples)
+// returns
+//    nothing
+void I2cKeypad::setTrace(I2cKeypadTrace *trace)
+{
+  if (_trace)
+    _trace->pause(false);         // in case it was being read
+  _trace = trace;
+  _traceReadPosition = 0;
+}
+
+// copy the next part of the trace, to send it over Serial (or save it). The trace is a header with the keypad's setup,
+// then the samples, oldest first (see I2cKeypadTrace.h). No samples are saved until the whole trace has been read,
+// so call this until it returns 0.
+// parameters
+//    data - array where the bytes are copied
+//    length - max number of bytes to copy
+// returns
+//    the number of bytes copied, or 0 when the whole trace has been read (the next call starts at the header again)
+uint16_t I2cKeypad::readTrace(uint8_t *data, uint16_t length)
+{
+  uint8_t header[KEYPAD_TRACE_HEADER_SIZE];
+  uint16_t copied = 0;
+
+  if (!_trace)
+    return 0;
+  _trace->pause(true);            // the samples must not change until they have all been read
+  uint16_t size = KEYPAD_TRACE_HEADER_SIZE + _trace->count() * KEYPAD_TRACE_SAMPLE_SIZE;
+  if (_traceReadPosition >= size)
+  {
+    _traceReadPosition = 0;
+    _trace->pause(false);
+    return 0;
+  }
+  if (_traceReadPosition < KEYPAD_TRACE_HEADER_SIZE)
+    traceHeader(header);
+  for (; copied < length && _traceReadPosition < size; ++_traceReadPosition)
+  {
+    if (_traceReadPosition < KEYPAD_TRACE_HEADER_SIZE)
+      data[copied++] = header[_traceReadPosition];
+    else
+      data[copied++] = _trace->readByte(_traceReadPosition - KEYPAD_TRACE_HEADER_SIZE);
+  }
+  return copied;
+}
+#endif
+
+
+// private functions ********************************
+
+#if KEYPAD_TRACE
+// fill in the header of the trace with the keypad's setup, so the trace can be run again on a computer (see I2cKeypadTrace.h).
+// The pin of each row and column is found with decodeRows() and decodeColumns(), which also works for I2cKeypadT.
+// parameters
+//    header - array of KEYPAD_TRACE_HEADER_SIZE bytes
+// returns
+//    nothing
+void I2cKeypad::traceHeader(uint8_t *header)
+{
+  memset(header, 0, KEYPAD_TRACE_HEADER_SIZE);
+  header[0] = 'K';
+  header[1] = 'T';
+  header[2] = KEYPAD_TRACE_VERSION;
+  header[3] = KEYPAD_TRACE_SAMPLE_SIZE;
+  header[4] = _rowNum;
+  header[5] = _colNum;
+  header[6] = _scanMode;
+  header[7] = _chipType;
+  I2cKeypadTrace::storeWord(header + 8, _debounceTime);
+  I2cKeypadTrace::storeWord(header + 10, _activeInterval);
+  I2cKeypadTrace::storeWord(header + 12, _idleInterval);
+  I2cKeypadTrace::storeWord(header + 14, _idleDelay);
+  header[16] = _pressSamples;
+  header[17] = _releaseSamples;
+  header[18] = _interruptMode;
+  I2cKeypadTrace::storeWord(header + 20, _settleTime);
+  I2cKeypadTrace::storeWord(header + 22, _trace->count());
+  unsigned long start = _trace->startTime();
+  I2cKeypadTrace::storeWord(header + 24, start);
+  I2cKeypadTrace::storeWord(header + 26, start >> 16);
+  I2cKeypadTrace::storeWord(header + 28, _chipCheckInterval);
+  memset(header + 32, 0xff, 32);
+  for (uint8_t pin = 0; pin < 8 * _portBytes; ++pin)
+  {
+    uint16_t rows = decodeRows(~(1U << pin));        // the row (if any) that is low when only this pin is low
+    uint16_t cols = decodeColumns(~(1U << pin));
+    if (rows)
+      header[32 + lowestBit(rows)] = pin;
+    if (cols)
+      header[48 + lowestBit(cols)] = pin;
+  }
+}
+#endif
+
+// add an i2c transaction to the statistics
+// parameters
+//    bytes - number of bytes on the bus, including the address bytes
+//    acknowledged - false if the chip did not acknowledge
+// returns
+//    nothing
+void I2cKeypad::countTransaction(uint8_t bytes, bool acknowledged)
+{
+#if KEYPAD_STATISTICS
+  KEYPAD_COUNT(transactions);
+  if (_statistics.bytes + bytes > _statistics.bytes)
+    _statistics.bytes += bytes;
+  if (!acknowledged)
+    KEYPAD_COUNT(nacks);
+#else
+  (void)bytes;
+  (void)acknowledged;
+#endif
+}
+
+// add a finished scan to the scan time histogram
+// parameters
+//    scanTime - microseconds the scan took
+// returns
+//    nothing
+void I2cKeypad::countScanTime(unsigned long scanTime)
+{
+#if KEYPAD_STATISTICS
+  uint8_t bin = 0;
+  for (unsigned long limit = KEYPAD_HISTOGRAM_FIRST_BIN; scanTime >= limit && bin < KEYPAD_HISTOGRAM_BINS - 1; limit <<= 1)
+    ++bin;
+  KEYPAD_COUNT(scanTimes[bin]);
+  if (scanTime > _statistics.maxScanTime)
+    _statistics.maxScanTime = scanTime;
+#else
+  (void)scanTime;
+#endif
+}
+
+// return the number of keys in the keypad buffer, without scanning the keypad. Only the events that getKey()
+// returns are counted (not the release, code and long press events).
+// parameters
+//    none
+// returns
+//    the number of keys available to read from the buffer
+uint8_t I2cKeypad::keyBufferCount(void)
+{
+  KeypadEvent event;
+  uint8_t count = 0;
+
+  for (uint8_t index = 0; eventQueue().peek(index, event); ++index)
+  {
+    if (keyEvent(event))
+      ++count;
+  }
+  return count;
+}
+
+// return the next key press (or repeat) in the keypad buffer, without scanning the keypad.
+// When the key is removed, any other events in front of it are removed too (the buffer can only be read in order).
+// When it is left there, every event stays in the buffer.
+// parameters
+//    remove - true to remove the key from the buffer, false to leave it there
+// returns
+//     RETURN_NO_KEY_IN_BUFFER if there is no key in the buffer
+//     the ASCII value of the next key pressed (from the keyMap array)
+uint8_t I2cKeypad::readKeyBuffer(bool remove)
+{
+  KeypadEvent event;
+  if (remove)
+  {
+    while (eventQueue().pop(event))
+    {
+      if (keyEvent(event))
+        return event.key;
+    }
+  }
+  else if (nextKeyEvent(event))
+    return event.key;
+  return RETURN_NO_KEY_IN_BUFFER;
+}
+
+// copy the next key press (or repeat) event in the keypad buffer, without removing anything or scanning the keypad
+// parameters
+//    event - the event is copied here
+// returns
+//    true if there was a key in the buffer
+bool I2cKeypad::nextKeyEvent(KeypadEvent &event)
+{
+  for (uint8_t index = 0; eventQueue().peek(index, event); ++index)
+  {
+    if (keyEvent(event))
+      return true;
+  }
+  return false;
+}
+
+// remove all keys from the keypad buffer, without scanning the keypad
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypad::flushKeyBuffer(void)
+{
+  eventQueue().flush();
+}
+
+// return the queue that key events are saved in
+// parameters
+//    none
+// returns
+//    the queue given to setEventQueue(), or the keypad's own buffer
+I2cKeypadEventQueue &I2cKeypad::eventQueue(void)
+{
+  return _eventQueue ? *_eventQueue : _keyBuffer;
+}
+
+// check if the chip has signaled a change on the row pins (either interruptReceived() was called, or the INT pin is low)
+// parameters
+//    none
+// returns
+//    true if the keypad should be scanned
+bool I2cKeypad::interruptPending(void)
+{
+  if (_interruptPending)
+    return true;
+  return _interruptPin != KEYPAD_NO_INTERRUPT_PIN && digitalRead(_interruptPin) == LOW;
+}
+
+// start a new entry for getKeysUntil(), getIntUntil(), getFixedUntil() or getFloatUntil(), unless one is in progress
+// parameters
+//    none
+// returns
+//    true if a new entry was started
+bool I2cKeypad::startInput(void)
+{
+  if (_inputActive)
+    return false;
+  _inputActive = true;
+  _inputLength = 0;
+  _inputDecimals = -1;
+  _inputNegative = false;
+  _inputValue = 0;
+  _inputStartTime = millis();
+  return true;
+}
+
+// finish the entry in progress (the value entered is kept, so the caller can still read it)
+// parameters
+//    status - TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED
+// returns
+//    status
+int I2cKeypad::endInput(int status)
+{
+  _inputActive = false;
+  return status;
+}
+
+// add the keys pressed since the last call to the number being entered (_inputValue, _inputDecimals and _inputNegative).
+// Each digit is added as it arrives (value * 10 + digit), and backspace takes it off again (value / 10), so only the
+// number itself is kept.
+// parameters
+//    maxDigits - the entry is finished when this many digits have been entered
+//    maxWhole - digits before the decimal point past this many are ignored
+//    maxDecimals - digits after the decimal point past this many are ignored
+//    timeoutPeriod - the entry is finished this many milliseconds after it was started (0 = no timeout)
+//    terminatorKey, decimalPointKey, backspaceKey, minusKey - the keys with those jobs (0 = not used)
+// returns
+//    WAITING_FOR_MORE_KEYS, TERMINATOR_CHAR_RECEIVED, MAX_NUM_CHARACTERS_REACHED or TIMEOUT_PERIOD_EXCEEDED
+int I2cKeypad::readNumber(uint8_t maxDigits, uint8_t maxWhole, uint8_t maxDecimals, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                          uint8_t decimalPointKey, uint8_t backspaceKey, uint8_t minusKey)
+{
+  uint8_t key;      // key read from the keypad buffer (getKey() never returns 0, so a key that is 0 never matches)
+
+  startInput();
+  while ((key = getKey()) != RETURN_NO_KEY_IN_BUFFER)
+  {
+    if (key == terminatorKey)
+      return endInput(TERMINATOR_CHAR_RECEIVED);
+    if (key == backspaceKey)
+    {
+      // remove the last thing entered: a digit, the decimal point, or the minus sign
+      if (_inputDecimals == 0)
+        _inputDecimals = -1;
+      else if (_inputLength)
+      {
+        _inputValue /= 10;
+        --_inputLength;
+        if (_inputDecimals > 0)
+          --_inputDecimals;
       }
+      else
+        _inputNegative = false;
+    }
+    else if (key == decimalPointKey)
+    {
+      if (_inputDecimals < 0)
+        _inputDecimals = 0;
+    }
+    else if (key == minusKey)
+    {
+      if (!_inputLength && _inputDecimals < 0)
+        _inputNegative = !_inputNegative;
+    }
+    else if (key >= '0' && key <= '9')
+    {
+      if (_inputDecimals < 0 ? _inputLength >= maxWhole : _inputDecimals >= (int8_t)maxDecimals)
+        continue;                       // no more room before (or after) the decimal point
+      _inputValue = _inputValue * 10 + (key - '0');
+      if (_inputDecimals >= 0)
+        ++_inputDecimals;
+      if (++_inputLength >= maxDigits)
+        return endInput(MAX_NUM_CHARACTERS_REACHED);
     }
   }
-  // Return the MCP to it's quick key checking state, so that when we come back to the function we can quickly check for a key press
-  // Set all input pins to be inputs, and the rest to be outputs...
-  mcpWriteByte(MCP_IODIR, _inputPinsMask);   // set all input pins to be inputs, and the rest to be outputs
-  // write all output pins to LOW so we can check if any of the input pins are not low later on (meaning a key is pressed)
-  mcpWriteByte(MCP_OLAT, 0);
-  if (keyPressed)
-    return key;
+  if (timeoutPeriod && (millis() - _inputStartTime) >= timeoutPeriod)
+    return endInput(TIMEOUT_PERIOD_EXCEEDED);
+  return WAITING_FOR_MORE_KEYS;
+}
+
+// save a key event in the keypad buffer (and a KEY_EVENT_CODE event after it, if a key pressed finished a code)
+// parameters:
+//    keyIndex - index of the key in the keyMap array (row * number of columns + column)
+//    eventType - KEY_EVENT_PRESSED, KEY_EVENT_RELEASED, KEY_EVENT_REPEAT or KEY_EVENT_LONG_PRESS
+// return:
+//    nothing
+void I2cKeypad::addKeyEvent(uint8_t keyIndex, uint8_t eventType)
+{
+  KeypadEvent event;
+  event.key = mapKey(keyIndex);
+  event.row = keyIndex / _colNum;
+  event.col = keyIndex % _colNum;
+  event.type = eventType;
+  event.time = micros();
+  if (eventType == KEY_EVENT_PRESSED)
+    KEYPAD_COUNT(keysAccepted);
+  if (!eventQueue().push(event))
+    KEYPAD_COUNT(keysDropped);
+  KEYPAD_RECORD(KEYPAD_TRACE_EVENT, keyIndex | (eventType << 8));
+  if (eventType == KEY_EVENT_PRESSED && _codeMatcher)
+  {
+    uint8_t code = _codeMatcher->feed(event.key);
+    if (code != KEYPAD_NO_CODE)
+    {
+      event.key = code;
+      event.type = KEY_EVENT_CODE;
+      if (!eventQueue().push(event))
+        KEYPAD_COUNT(keysDropped);
+      KEYPAD_RECORD(KEYPAD_TRACE_EVENT, code | (KEY_EVENT_CODE << 8));
+    }
+  }
+}
+
+// save the repeat and long press events for the key being held down. This runs for each scan that finds the held key
+// still down, so no more i2c transactions are needed than for waiting for the key to be released.
+// parameters:
+//    none
+// return:
+//    nothing
+void I2cKeypad::holdKey(void)
+{
+  unsigned long heldTime = _lastScanTime - _holdStartTime;
+
+  if (_longPressTime && !_longPressSaved && heldTime >= _longPressTime && keyInList(_longPressKeys, _heldKey))
+  {
+    addKeyEvent(_heldKey, KEY_EVENT_LONG_PRESS);
+    _longPressSaved = true;
+  }
+  if (_repeatDelay && heldTime >= _nextRepeat && keyInList(_repeatKeys, _heldKey))
+  {
+    addKeyEvent(_heldKey, KEY_EVENT_REPEAT);
+    // if the scans were late (the loop was busy), skip the repeats that were missed instead of saving them all at once
+    while (_nextRepeat <= heldTime)
+      _nextRepeat += _repeatRate;
+  }
+}
+
+// return true if the key at keyIndex is in a list of keys (see setRepeat())
+// parameters:
+//    keys - the ASCII values (from the keyMap array) of the keys, or 0 for all of the keys
+//    keyIndex - the key (row * number of columns + column)
+// return:
+//    true if the key is in the list
+bool I2cKeypad::keyInList(const char *keys, uint8_t keyIndex)
+{
+  if (!keys)
+    return true;
+  uint8_t key = mapKey(keyIndex);
+  return key && strchr(keys, key);
+}
+
+// KEYPAD_SCAN_MATRIX: save an event for each key that was pressed or released, using the keys found by the scan (every key is read).
+// Each key is debounced by itself: its new state is accepted once it has not changed for the debounce time (or with
+// setDebounceSamples(), once its last samples agree), so a key that bounces does not hold up the other keys.
+// Without diodes on the keypad, pressing three keys at the corners of a rectangle makes the fourth corner look pressed
+// too (ghosting). When this happens we can't tell which keys are really down, so new presses in those rows are ignored
+// until the keys are released.
+// The last key pressed repeats (and has its long press) while it is held, if setRepeat() or setLongPress() were used.
+// parameters:
+//    none
+// return:
+//    nothing
+void I2cKeypad::updateMatrix(void)
+{
+  uint16_t *sample = _matrix->_scanKeys;         // keys that are down in this scan
+  uint16_t *matrixKeys = _matrix->_matrixKeys;   // debounced state of each key
+  uint16_t *matrixSample = _matrix->_matrixSample;  // keys that were down in the last scan
+  uint16_t ghostRows = 0;             // bit set for each row that is part of a ghost rectangle
+  bool keysDown = false;              // set if any key is down or still changing
+  uint16_t scanTime = _lastScanTime;  // time of this scan (the low 16 bits are enough to time the debounce of each key)
+
+  // two rows that share two or more columns make a rectangle
+  for (uint8_t r1 = 0; r1 < _rowNum; ++r1)
+  {
+    for (uint8_t r2 = r1 + 1; r2 < _rowNum; ++r2)
+    {
+      uint16_t common = sample[r1] & sample[r2];
+      if (common & (common - 1))      // more than one bit set
+      {
+        bitSet(ghostRows, r1);
+        bitSet(ghostRows, r2);
+      }
+    }
+  }
+
+  for (uint8_t row = 0; row < _rowNum; ++row)
+  {
+    uint16_t changed = 0;     // keys that have settled in a new state
+    uint16_t moved = sample[row] ^ matrixSample[row];    // keys that read differently than in the last scan
+#if KEYPAD_STATISTICS
+    // a key that changed back (or again) before its last change was accepted is a bounce
+    for (uint16_t bounced = moved & (matrixSample[row] ^ matrixKeys[row]); bounced; bounced &= bounced - 1)
+      KEYPAD_COUNT(bouncesRejected);
+#endif
+    matrixSample[row] = sample[row];
+    for (uint8_t col = 0; col < _colNum; ++col)
+    {
+      uint8_t keyIndex = row * _colNum + col;
+      uint16_t &debounce = _matrix->_keyDebounce[keyIndex];
+      if (_pressSamples)
+      {
+        // shift this scan into the key's history. The key is pressed once its last _pressSamples samples are all down,
+        //    and released once its last _releaseSamples samples are all up.
+        uint8_t pressMask = (1 << _pressSamples) - 1;
+        uint8_t releaseMask = (1 << _releaseSamples) - 1;
+        debounce = (uint8_t)((debounce << 1) | bitRead(sample[row], col));
+        if (bitRead(matrixKeys[row], col) ? !(debounce & releaseMask) : (debounce & pressMask) == pressMask)
+          bitSet(changed, col);
+        if (debounce & (pressMask | releaseMask))
+          keysDown = true;    // still bouncing
+      }
+      else
+      {
+        if (bitRead(moved, col))
+          debounce = scanTime;  // the key's debounce time starts over each time it reads differently than in the last scan
+        if (bitRead(sample[row] ^ matrixKeys[row], col) && (uint16_t)(scanTime - debounce) >= _debounceTime)
+          bitSet(changed, col);
+      }
+    }
+    if (bitRead(ghostRows, row))
+      changed &= ~sample[row];                                     // only accept key releases in a ghost row
+    for (uint8_t col = 0; changed; ++col, changed >>= 1)
+    {
+      if (!(changed & 0x01))
+        continue;
+      uint8_t keyIndex = row * _colNum + col;
+      uint8_t pressed = !bitRead(matrixKeys[row], col);
+      bitWrite(matrixKeys[row], col, pressed);
+      addKeyEvent(keyIndex, pressed ? KEY_EVENT_PRESSED : KEY_EVENT_RELEASED);
+      if (pressed)
+      {
+        _heldKey = keyIndex;                  // the last key pressed is the one that repeats, timed from this scan
+        _holdStartTime = _lastScanTime;
+        _nextRepeat = _repeatDelay;
+        _longPressSaved = false;
+      }
+      else if (keyIndex == _heldKey)
+        _heldKey = NO_KEYS_PRESSED;
+    }
+    if (sample[row] || matrixKeys[row])
+      keysDown = true;
+  }
+  if (_heldKey != NO_KEYS_PRESSED)
+    holdKey();
+  // in interrupt mode we only wait for the INT pin when all the keys are up
+  _keypadState = keysDown ? WAITING_FOR_NO_KEYS_PRESSED : WAITING_FOR_NEW_KEY_PRESS;
+}
+
+
+// keypad layout functions ********************************
+// These are the only functions that use the _keyMap, _rowPins and _colPins arrays. A I2cKeypadT gives the keypad
+// tables in flash that are worked out when the program is compiled, and these look up the pins in those instead.
+
+// return a mask where each row pin has a high bit (keypad rows are inputs on the chip)
+uint16_t I2cKeypad::rowPinsMask(void)
+{
+  if (_pinTables)
+    return _pinTables->rowPinsMask;
+  uint16_t mask = 0;
+  for (uint8_t r = 0; r < _rowNum; ++r)
+    bitSet(mask, _rowPins[r]);     // set the bit for each pin that is in the row array
+  return mask;
+}
+
+// return the IODIR value that makes one column pin an output, and all the other pins inputs.
+//     We make only one pin be an output so that if multiple keys are pressed we don't get two output
+//     pins shorted together (and they could be at different levels)
+uint16_t I2cKeypad::columnDirection(uint8_t col)
+{
+  if (_pinTables)
+    return pinTableEntry(_pinTables->columnDirection, col) | (_pinTables->bytes > 1 ? 0 : 0xff00);
+  uint16_t direction = 0xffff;
+  bitClear(direction, _colPins[col]);      // clear the bit for this column output pin
+  return direction;
+}
+
+// return a word with bit r set for each row r that is low in the value read from GPIO
+uint16_t I2cKeypad::decodeRows(uint16_t inputPort)
+{
+  if (_pinTables)
+    return decodePort(_pinTables->rows, inputPort);
+  uint16_t rows = 0;
+  for (uint8_t row = 0; row < _rowNum; ++row)
+  {
+    if (bitRead(inputPort, _rowPins[row]) == 0)
+      bitSet(rows, row);
+  }
+  return rows;
+}
+
+// return a word with bit c set for each column c that is low in the value read from GPIO
+uint16_t I2cKeypad::decodeColumns(uint16_t inputPort)
+{
+  if (_pinTables)
+    return decodePort(_pinTables->cols, inputPort);
+  uint16_t cols = 0;
+  for (uint8_t col = 0; col < _colNum; ++col)
+  {
+    if (bitRead(inputPort, _colPins[col]) == 0)
+      bitSet(cols, col);
+  }
+  return cols;
+}
+
+// return the ASCII value for a key (keyIndex is row * number of columns + column)
+uint8_t I2cKeypad::mapKey(uint8_t keyIndex)
+{
+  if (_pinTables)
+    return pgm_read_byte(&_keyMap[keyIndex]);
+  return _keyMap[keyIndex];
+}
+
+// look up each byte of the value read from GPIO in a table from I2cKeypadT (the rows or the columns table)
+uint16_t I2cKeypad::decodePort(const void *table, uint16_t inputPort)
+{
+  uint16_t bits = pinTableEntry(table, inputPort & 0xff);
+  if (_pinTables->bytes > 1)
+    bits |= pinTableEntry(table, 256 + (inputPort >> 8));
+  return bits;
+}
+
+// read entry n of a table from I2cKeypadT (the entries are words if a pin is in the high byte of a 16 bit chip)
+uint16_t I2cKeypad::pinTableEntry(const void *table, uint16_t n)
+{
+  if (_pinTables->bytes > 1)
+    return pgm_read_word((const uint16_t *)table + n);
+  return pgm_read_byte((const uint8_t *)table + n);
+}
+
+// return true for the events that getKey() returns (a key press, or a repeat of a key held down)
+bool I2cKeypad::keyEvent(const KeypadEvent &event)
+{
+  return event.type == KEY_EVENT_PRESSED || event.type == KEY_EVENT_REPEAT;
+}
+
+// return the number of the lowest bit that is set (bits must not be 0)
+uint8_t I2cKeypad::lowestBit(uint16_t bits)
+{
+  uint8_t bit = 0;
+  while (!(bits & 0x01))
+  {
+    bits >>= 1;
+    ++bit;
+  }
+  return bit;
+}
+
+
+// chip functions ********************************
+// The scan only uses these functions to reach the chip, so it works the same way with the MCP and PCF chips.
+// A MCP chip has a direction register (IODIR) and an output latch (OLAT, always 0 here), so a pin is either an input
+// with a pullup, or an output driven low. A PCF chip has no registers: writing a 1 to a pin turns on a weak pullup
+// (so it can be used as an input), and writing a 0 drives it low, which works the same way as IODIR with OLAT at 0.
+
+// returns true for the MCP chips (which have registers and an INT pin that can be set up)
+bool I2cKeypad::mcpChip(void)
+{
+  return _chipType == KEYPAD_MCP23008 || _chipType == KEYPAD_MCP23017;
+}
+
+// set up the chip the way the keypad needs it (done by begin(), and again if the chip was reset)
+// parameters
+//    none
+// returns
+//    false if the chip could not be written (the error state is set)
+bool I2cKeypad::expanderSetup(void)
+{
+  _mcpRegistersValid = 0;                    // write every register, even if we think it already has the right value
+  if (!mcpChip())
+    return pcfWrite(_inputPinsMask);         // the row pins are inputs, and the rest are low
+  // Write IOCON by itself first, because it turns on sequential operation. If the MCP chip was not reset since it was last
+  //    set up by other code, then the address pointer might not increment yet.
+  if (!mcpWriteRegister(MCP_IOCON, mcpIoconValue()))  // configuration register... see the I2cKeypad.h file for info on MCP_IOCON_VALUE
+    return false;
+  // Now write all the registers in one i2c transaction, starting at IODIR
+  uint16_t setup[MCP_OLAT + 1];
+  setup[MCP_IODIR] = _inputPinsMask;         // write 1's for the bits that are inputs
+  setup[MCP_IPOL] = 0;                       // don't invert the polarity of any input pins
+  setup[MCP_GPINTEN] = _interruptMode ? _inputPinsMask : 0;  // row pins interrupt on change only if enableInterrupts() was called
+  setup[MCP_DEFVAL] = 0;                     // we are not defining a default value for interrupts
+  setup[MCP_INTCON] = 0;                     // interrupt control register... pins are compared against their previous value
+  setup[MCP_IOCON] = mcpIoconValue();        // configuration register... see the I2cKeypad.h file for info on MCP_IOCON_VALUE
+  setup[MCP_GPPU] = 0xffff;                  // set all input pins to have pullup resistor
+  setup[MCP_INTF] = 0;                       // Interrupt Flag is read only... the chip ignores this byte
+  setup[MCP_INTCAP] = 0;                     // Interrupt Capture is read only... the chip ignores this byte
+  setup[MCP_GPIO] = 0;                       // writing GPIO writes the Output Latch
+  setup[MCP_OLAT] = 0;                       // Output Latch: set all the output pins low initially
+  return mcpWriteRegisters(MCP_IODIR, setup, MCP_OLAT + 1);
+}
+
+// check if the chip was reset (a power glitch, or the RESET pin of a MCP chip), which loses the setup from expanderSetup().
+// A MCP chip is reset if IOCON does not have the value we wrote. A PCF chip powers on with every pin high, so it was
+// reset if a pin that we drive low reads high. This is done between scans, when the pins are in the quick check state.
+// parameters
+//    wasReset - set to true if the chip was reset
+// returns
+//    false if the chip could not be read (the error state is set)
+bool I2cKeypad::expanderCheck(bool &wasReset)
+{
+  if (mcpChip())
+  {
+    uint16_t iocon;
+    if (!mcpReadRegisters(MCP_IOCON, &iocon, 1))
+      return false;
+    wasReset = iocon != mcpIoconValue();
+    return true;
+  }
+  uint16_t pins;
+  uint8_t data[2];
+  if (!i2cRead(-1, data, _portBytes))
+    return false;
+  pins = data[0] | (_portBytes > 1 ? data[1] << 8 : 0);
+  wasReset = !bitRead(_mcpRegistersValid, MCP_IODIR) || (pins & ~_mcpRegisters[MCP_IODIR] & portMask());
+  return true;
+}
+
+// make the pins with a 0 bit outputs (driven low), and the pins with a 1 bit inputs (with a pullup)
+// parameters
+//    direction - a bit for each pin (bits above the pins the chip has are ignored)
+// returns
+//    false if the chip could not be written (the error state is set)
+bool I2cKeypad::expanderWriteDirection(uint16_t direction)
+{
+  if (mcpChip())
+    return mcpWriteRegister(MCP_IODIR, direction);
+  return pcfWrite(direction);
+}
+
+// read the level of every pin (reading the pins of a PCF chip also clears its INT pin)
+// parameters
+//    pins - set to the pin levels, bit n is set if pin n is high (0xffff if they could not be read, which looks like no keys pressed)
+// returns
+//    false if the chip could not be read (the error state is set)
+bool I2cKeypad::expanderReadPins(uint16_t &pins)
+{
+  if (mcpChip())
+    return mcpReadRegisters(MCP_GPIO, &pins, 1);
+  uint8_t data[2];
+  bool read = i2cRead(-1, data, _portBytes);
+  pins = read ? data[0] | (_portBytes > 1 ? data[1] << 8 : 0xff00) : 0xffff;
+  return read;
+}
+
+// make the pins with a 0 bit outputs (driven low), and then read the level of every pin, in one i2c transfer (a repeated
+// start joins the write and the read). The pins are sampled early in the read, so this is only used when the settle
+// time fits in that (see combinedTransfers()).
+// parameters
+//    direction - a bit for each pin (bits above the pins the chip has are ignored)
+//    pins - set to the pin levels, bit n is set if pin n is high (0xffff if they could not be read, which looks like no keys pressed)
+// returns
+//    false if the transfer failed (the error state is set)
+bool I2cKeypad::expanderWriteReadPins(uint16_t direction, uint16_t &pins)
+{
+  uint8_t write[3];       // IODIR register address (MCP chips only), then the direction (port A first on the 16 bit chips)
+  uint8_t length = 0;
+  uint8_t data[2];
+
+  direction &= portMask();
+  // the direction is kept in _mcpRegisters[MCP_IODIR] for both kinds of chip, and is only written if it changes
+  bool changed = !bitRead(_mcpRegistersValid, MCP_IODIR) || _mcpRegisters[MCP_IODIR] != direction;
+  if (changed)
+  {
+    if (mcpChip())
+      write[length++] = MCP_IODIR * _portBytes;
+    write[length++] = direction;
+    if (_portBytes > 1)
+      write[length++] = direction >> 8;
+  }
+  bool read = i2cTransfer(length ? write : 0, length, mcpChip() ? MCP_GPIO * _portBytes : -1, data, _portBytes);
+  if (changed)
+  {
+    _mcpRegisters[MCP_IODIR] = direction;
+    bitWrite(_mcpRegistersValid, MCP_IODIR, read);  // if the transfer failed, we don't know if the direction was written
+  }
+  if (!read)
+    pins = 0xffff;
+  else if (_portBytes > 1)
+    pins = data[0] | (data[1] << 8);
   else
-    return NO_KEYS_PRESSED;
+    pins = data[0] | (mcpChip() ? 0 : 0xff00);       // the same as expanderReadPins()
+  return read;
+}
+
+// check if the scan can write the direction and read the pins in one transfer. That saves the cost of starting a transfer
+// (a system call on Linux), but there is no time to wait between them, so the settle time must fit in the time the read
+// takes to sample the pins.
+// parameters
+//    none
+// returns
+//    true if KEYPAD_COMBINED_TRANSFERS is set, and the scan does not have to wait for the pins to settle
+bool I2cKeypad::combinedTransfers(void)
+{
+  return KEYPAD_COMBINED_TRANSFERS && !_columnWait;
+}
+
+// return a mask with a bit set for each pin the chip has
+uint16_t I2cKeypad::portMask(void)
+{
+  return _portBytes > 1 ? 0xffff : 0x00ff;
+}
 
+// write the port of a PCF chip (the write is skipped if the port already has this value)
+// parameters
+//    pins - a bit for each pin: 1 to make the pin an input with a weak pullup, 0 to drive it low
+// returns
+//    false if the write failed (the error state is set)
+bool I2cKeypad::pcfWrite(uint16_t pins)
+{
+  pins &= portMask();
+  if (bitRead(_mcpRegistersValid, MCP_IODIR) && _mcpRegisters[MCP_IODIR] == pins)
+    return true;                             // the port already has this value, so there is no need to use the i2c bus
+  uint8_t data[2] = { (uint8_t)pins, (uint8_t)(pins >> 8) };
+  bool written = i2cWrite(data, _portBytes);
+  _mcpRegisters[MCP_IODIR] = pins;
+  bitWrite(_mcpRegistersValid, MCP_IODIR, written);  // if the write failed, we don't know what the port has now
+  return written;
 }
 
+// return the IOCON value written by expanderSetup() (the MCP23017 has the same IOCON register at both of its addresses)
+uint16_t I2cKeypad::mcpIoconValue(void)
+{
+  return _chipType == KEYPAD_MCP23017 ? (MCP23017_IOCON_VALUE << 8) | MCP23017_IOCON_VALUE : MCP_IOCON_VALUE;
+}
 
-// read one byte from mcp chip register
+// read one mcp chip register
 // parameters
 //    mcpRegister - the register in the mcp chip that is to be read
 // returns
-//    the the value of the mcp register
-uint8_t I2cKeypad::mcpReadByte(uint8_t mcpRegister)
+//    the the value of the mcp register (0xffff if it could not be read)
+uint16_t I2cKeypad::mcpReadRegister(uint8_t mcpRegister)
+{
+  uint16_t data;
+  mcpReadRegisters(mcpRegister, &data, 1);
+  return data;
+}
+
+// read several mcp registers that are next to each other. The register address is sent, and then the data is read
+// after a repeated start, so the bus is not released in between. A failed read is tried again (see setRetries()).
+// parameters
+//    mcpRegister - the first register in the mcp chip that is to be read
+//    data - array where the register values are saved (set to 0xffff if they could not be read, which looks like no keys pressed)
+//    count - number of registers to read
+// returns
+//    false if the registers could not be read (the error state is set)
+bool I2cKeypad::mcpReadRegisters(uint8_t mcpRegister, uint16_t *data, uint8_t count)
 {
-  Wire.beginTransmission(_i2cAddress);
-  Wire.write(mcpRegister);
-  Wire.endTransmission();
-  Wire.requestFrom((int)_i2cAddress, (int)1);
-  return Wire.read();
+  // without sequential operation the address pointer does not move to the next register, so read each register on its own
+  if (count > 1 && !mcpSequentialMode())
+  {
+    for (uint8_t i = 0; i < count; ++i)
+    {
+      if (!mcpReadRegisters(mcpRegister + i, &data[i], 1))
+      {
+        memset(data, 0xff, count * sizeof(uint16_t));
+        return false;
+      }
+    }
+    return true;
+  }
+  uint8_t bytes[(MCP_OLAT + 1) * 2];
+  if (!i2cRead(mcpRegister * _portBytes, bytes, count * _portBytes))
+  {
+    memset(data, 0xff, count * sizeof(uint16_t));
+    return false;
+  }
+  for (uint8_t i = 0; i < count; ++i, ++mcpRegister)
+  {
+    data[i] = _portBytes > 1 ? bytes[i * 2] | (bytes[i * 2 + 1] << 8) : bytes[i];  // port A is sent first
+    // registers that we write to can't change on their own, so keep a copy of what we read
+    if (mcpRegister <= MCP_OLAT && mcpRegister != MCP_INTF && mcpRegister != MCP_INTCAP && mcpRegister != MCP_GPIO)
+    {
+      _mcpRegisters[mcpRegister] = data[i];
+      bitSet(_mcpRegistersValid, mcpRegister);
+    }
+  }
+  return true;
 }
 
-// write a byte to mcp register
+// write a mcp register (the write is skipped if the register already has this value)
 // parameters
 //    mcpRegister - the register in the mcp chip that is to be written to
-//    data - the value to be written to the mcp register
+//    data - the value to be written to the mcp register (bits above the pins the chip has are ignored)
 // returns
-//    nothing
-void I2cKeypad::mcpWriteByte(uint8_t mcpRegister, uint8_t data)
+//    false if the write failed (the error state is set)
+bool I2cKeypad::mcpWriteRegister(uint8_t mcpRegister, uint16_t data)
+{
+  return mcpWriteRegisters(mcpRegister, &data, 1);
+}
+
+// write several mcp registers that are next to each other in one i2c transaction (the MCP chip must be in sequential mode).
+// Registers at the start and end of the list that already have the right value are not sent.
+// Read only registers in the list (INTF, INTCAP) are ignored by the chip, and writing GPIO writes OLAT.
+// parameters
+//    mcpRegister - the first register in the mcp chip that is to be written to
+//    data - array of values to be written to the mcp registers
+//    count - number of registers to write
+// returns
+//    false if the write failed (the error state is set)
+bool I2cKeypad::mcpWriteRegisters(uint8_t mcpRegister, const uint16_t *data, uint8_t count)
+{
+  int8_t first = -1;      // index of the first register that has to be written
+  int8_t last = -1;       // index of the last register that has to be written
+  uint16_t mask = portMask();
+
+  if (count > 1 && !mcpSequentialMode())
+  {
+    for (uint8_t i = 0; i < count; ++i)
+    {
+      if (!mcpWriteRegisters(mcpRegister + i, &data[i], 1))
+        return false;
+    }
+    return true;
+  }
+  // find the registers that need to change
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    uint8_t reg = mcpRegister + i;
+    if (reg == MCP_GPIO)
+      reg = MCP_OLAT;                        // writing GPIO writes the Output Latch
+    if (reg == MCP_INTF || reg == MCP_INTCAP || reg > MCP_OLAT)
+      continue;
+    if (!bitRead(_mcpRegistersValid, reg) || _mcpRegisters[reg] != (data[i] & mask))
+    {
+      if (first < 0)
+        first = i;
+      last = i;
+    }
+  }
+  if (first < 0)
+    return true;                             // all the registers already have these values
+  // the register address, then each register (port A first on the MCP23017)
+  uint8_t bytes[1 + (MCP_OLAT + 1) * 2];
+  uint8_t length = 0;
+  bytes[length++] = (mcpRegister + first) * _portBytes;
+  for (uint8_t i = first; i <= last; ++i)
+  {
+    bytes[length++] = data[i];
+    if (_portBytes > 1)
+      bytes[length++] = data[i] >> 8;
+  }
+  bool written = i2cWrite(bytes, length);
+  for (uint8_t i = first; i <= last; ++i)
+  {
+    uint8_t reg = mcpRegister + i;
+    if (reg == MCP_GPIO)
+      reg = MCP_OLAT;
+    if (reg == MCP_INTF || reg == MCP_INTCAP || reg > MCP_OLAT)
+      continue;
+    _mcpRegisters[reg] = data[i] & mask;
+    bitWrite(_mcpRegistersValid, reg, written);  // if the write failed, we don't know what the registers have now
+  }
+  return written;
+}
+
+// send bytes to the chip in one i2c transaction. A failed transaction is tried again (see setRetries()).
+// parameters
+//    data - array of bytes to send (for a MCP chip, the first byte is the register address)
+//    count - number of bytes to send
+// returns
+//    false if the chip did not acknowledge (the error state is set)
+bool I2cKeypad::i2cWrite(const uint8_t *data, uint8_t count)
+{
+  return i2cTransfer(data, count, -1, 0, 0);
+}
+
+// read bytes from the chip in one i2c transaction. For a MCP chip the register address is sent first, and the data is read
+// after a repeated start, so the bus is not released in between. A failed read is tried again (see setRetries()).
+// parameters
+//    address - register address to send first, or -1 to just read (a PCF chip)
+//    data - array where the bytes are saved
+//    count - number of bytes to read
+// returns
+//    false if the bytes could not be read (the error state is set)
+bool I2cKeypad::i2cRead(int16_t address, uint8_t *data, uint8_t count)
+{
+  return i2cTransfer(0, 0, address, data, count);
+}
+
+// write bytes to the chip, then send a register address, then read bytes, in one i2c transaction (repeated starts join
+// the parts, and any of them can be left out). All of the chip's i2c traffic goes through here. A failed transaction is
+// tried again (see setRetries()).
+// parameters
+//    writeData - array of bytes to write first (for a MCP chip, the first byte is the register address)
+//    writeCount - number of bytes to write (0 = no write)
+//    address - register address to send before the read, or -1 to just read (a PCF chip)
+//    data - array where the bytes read are saved
+//    count - number of bytes to read (0 = no read)
+// returns
+//    false if the transaction failed (the error state is set)
+bool I2cKeypad::i2cTransfer(const uint8_t *writeData, uint8_t writeCount, int16_t address, uint8_t *data, uint8_t count)
+{
+  // an address byte for each part, and the bytes of each part
+  uint8_t bytes = (writeCount ? writeCount + 1 : 0) + (address >= 0 ? 2 : 0) + (count ? count + 1 : 0);
+  unsigned long startTime = micros();
+  for (uint8_t attempt = 1; ; ++attempt)
+  {
+    uint8_t error = i2cBusTransfer(writeData, writeCount, address, data, count);
+    countTransaction(error == KEYPAD_ERROR_NACK ? 1 : bytes, error != KEYPAD_ERROR_NACK);  // only the address is sent if it is not acknowledged
+    if (error == KEYPAD_ERROR_NONE)
+      return true;
+    if (error == KEYPAD_ERROR_SHORT_READ)
+      KEYPAD_COUNT(shortReads);
+    if (!retryTransaction(attempt, startTime, error))
+      return false;
+  }
+}
+
+// try an i2c transaction once (see i2cTransfer()), with the Wire library or the Linux i2c-dev interface
+// parameters
+//    writeData, writeCount, address, data, count - see i2cTransfer()
+// returns
+//    KEYPAD_ERROR_NONE, KEYPAD_ERROR_NACK, KEYPAD_ERROR_SHORT_READ or KEYPAD_ERROR_TIMEOUT
+uint8_t I2cKeypad::i2cBusTransfer(const uint8_t *writeData, uint8_t writeCount, int16_t address, uint8_t *data, uint8_t count)
+{
+#ifdef KEYPAD_LINUX_I2CDEV
+  return KeypadI2cDev.transfer(_i2cAddress, writeData, writeCount, address, data, count);
+#else
+  if (writeCount)
+  {
+    Wire.beginTransmission(_i2cAddress);
+    for (uint8_t i = 0; i < writeCount; ++i)
+      Wire.write(writeData[i]);
+    uint8_t result = Wire.endTransmission(address < 0 && !count);  // repeated start... keep the bus if there is more to do
+    if (result)
+      return result >= 4 ? KEYPAD_ERROR_TIMEOUT : KEYPAD_ERROR_NACK;  // 4 = bus error, 5 = timeout (2 and 3 are NACKs)
+  }
+  if (address >= 0)
+  {
+    Wire.beginTransmission(_i2cAddress);
+    Wire.write((uint8_t)address);
+    uint8_t result = Wire.endTransmission(false);  // repeated start... keep the bus until the data is read
+    if (result)
+      return result >= 4 ? KEYPAD_ERROR_TIMEOUT : KEYPAD_ERROR_NACK;
+  }
+  if (!count)
+    return KEYPAD_ERROR_NONE;
+  uint8_t received = Wire.requestFrom((int)_i2cAddress, (int)count);
+  if (received < count)
+  {
+    while (Wire.available())
+      Wire.read();                             // throw away the part of a short read that did arrive
+    // when the read is all there is, getting nothing back is the only sign of a missing chip
+    return (received || writeCount || address >= 0) ? KEYPAD_ERROR_SHORT_READ : KEYPAD_ERROR_NACK;
+  }
+  for (uint8_t i = 0; i < count; ++i)
+    data[i] = Wire.read();
+  return KEYPAD_ERROR_NONE;
+#endif
+}
+
+// decide whether to try a failed i2c transaction again. Once the keypad is in an error state, transactions are not
+// retried (until a scan works again), so a keypad that is not answering costs one transaction per scan.
+// parameters
+//    attempt - number of times the transaction has been tried
+//    startTime - micros() when the first try started
+//    error - the error to save if we give up (KEYPAD_ERROR_NACK or KEYPAD_ERROR_SHORT_READ)
+// returns
+//    true to try again, false to give up (the error state is set)
+bool I2cKeypad::retryTransaction(uint8_t attempt, unsigned long startTime, uint8_t error)
+{
+  if (_errorState == KEYPAD_ERROR_NONE && attempt <= _retries && (micros() - startTime) < _retryTime)
+  {
+    KEYPAD_COUNT(retries);
+    // before the last try, free the bus if a chip is holding it
+    if (attempt == _retries && busHeld(error) && !recoverBus())
+    {
+      _errorState = KEYPAD_ERROR_BUS_STUCK;
+      return false;
+    }
+    return true;
+  }
+  _errorState = error;
+  return false;
+}
+
+// check if a failed i2c transaction left a chip holding SDA low, so the bus needs recoverBus(). A NACK never does (the
+// chip just didn't answer, and clocking SCL would only upset the other chips on the bus). After a Wire timeout the bus is
+// assumed to be stuck, and after any other error SDA is read (if setBusRecoveryPins() was called).
+// parameters
+//    error - the error from i2cBusTransfer()
+// returns
+//    true if the bus should be freed
+bool I2cKeypad::busHeld(uint8_t error)
+{
+  if (error == KEYPAD_ERROR_NACK)
+    return false;
+  if (error == KEYPAD_ERROR_TIMEOUT)
+    return true;
+#ifdef KEYPAD_LINUX_I2CDEV
+  return false;
+#else
+  return _sdaPin != KEYPAD_NO_PIN && digitalRead(_sdaPin) == LOW;
+#endif
+}
+
+// free the i2c bus if a chip is holding SDA low. A chip does this when it was sending a byte and stopped getting
+// clocks (for example the microcontroller was reset in the middle of a read). Clocking SCL up to 9 times lets it finish
+// the byte, and a stop condition then puts it back to waiting for a start. Only done if setBusRecoveryPins() was called.
+// The bus lines are open drain: a pin pulls its line low as an output (low), and lets the pullup resistor raise it as an input.
+// parameters
+//    none
+// returns
+//    false if SDA is still held low
+bool I2cKeypad::recoverBus(void)
+{
+#ifdef KEYPAD_LINUX_I2CDEV
+  return true;                                 // the kernel's i2c driver frees a stuck bus itself
+#else
+  if (_sdaPin == KEYPAD_NO_PIN)
+    return true;
+  KEYPAD_COUNT(busRecoveries);
+  Wire.end();                                  // take the pins back from the i2c hardware
+  pinMode(_sdaPin, INPUT);
+  pinMode(_sclPin, INPUT);
+  for (uint8_t i = 0; i < 9 && digitalRead(_sdaPin) == LOW; ++i)
+  {
+    digitalWrite(_sclPin, LOW);
+    pinMode(_sclPin, OUTPUT);                  // SCL low
+    delayMicroseconds(5);
+    pinMode(_sclPin, INPUT);                   // SCL high
+    delayMicroseconds(5);
+  }
+  // stop condition: SDA goes high while SCL is high
+  digitalWrite(_sclPin, LOW);
+  pinMode(_sclPin, OUTPUT);
+  digitalWrite(_sdaPin, LOW);
+  pinMode(_sdaPin, OUTPUT);
+  delayMicroseconds(5);
+  pinMode(_sclPin, INPUT);
+  delayMicroseconds(5);
+  pinMode(_sdaPin, INPUT);
+  delayMicroseconds(5);
+  bool released = digitalRead(_sdaPin) == HIGH;
+  Wire.begin();                                // Note: on some boards this sets the i2c clock back to 100kHz
+  if (_i2cClock)
+    Wire.setClock(_i2cClock);                  // so set it again, if begin() was given the clock
+  return released;
+#endif
+}
+
+// return the time from the start of a read of the pins until the chip samples them (0 if the i2c clock is not known)
+uint16_t I2cKeypad::sampleTime(void)
+{
+  if (!_i2cClock)
+    return 0;
+  return (mcpChip() ? KEYPAD_MCP_SAMPLE_BITS : KEYPAD_PCF_SAMPLE_BITS) * 1000000UL / _i2cClock;
+}
+
+// wait until the settle time has gone by since the pins were changed (_columnTime), leaving out the part the read will take
+void I2cKeypad::waitToSettle(void)
+{
+  if (!_columnWait)
+    return;
+  unsigned long waited = micros() - _columnTime;
+  if (waited < _columnWait)
+    delayMicroseconds(_columnWait - waited);
+}
+
+// work out how long the scan waits after driving a column low, before it starts reading the rows. The read takes
+// sampleTime() before the chip samples the pins, so only the rest of the settle time has to be waited.
+void I2cKeypad::updateColumnWait(void)
+{
+  uint16_t sample = sampleTime();
+  _columnWait = _settleTime > sample ? _settleTime - sample : 0;
+}
+
+// check if the MCP chip is in sequential mode (the address pointer moves to the next register after each byte)
+// parameters
+//    none
+// returns
+//    true if we wrote IOCON with the SEQOP bit clear
+bool I2cKeypad::mcpSequentialMode(void)
 {
-  Wire.beginTransmission(_i2cAddress);
-  Wire.write(mcpRegister);
-  Wire.write(data);
-  Wire.endTransmission();
+  return bitRead(_mcpRegistersValid, MCP_IOCON) && !bitRead(_mcpRegisters[MCP_IOCON], MCP_IOCON_SEQOP);
 }
 
-// set mcp register bit (0-7) with data (0-1)
+// set mcp register bit (0-7, or 0-15 on the MCP23017) with data (0-1)
 // parameters
 //    mcpRegister - the register in the mcp chip that is to be written to
-//    bit - which bit of the register that is to be written (0-7)
+//    bit - which bit of the register that is to be written (0-7, or 0-15)
 //    data - the value to be written to the mcp register bit
 // returns
 //    nothing
 void I2cKeypad::mcpWriteBit(uint8_t mcpRegister, uint8_t bit, bool data)
 {
-  uint8_t mcpRegisterValue;    // current value of the mcp register
-  if (bit > 7)
-    return;       // we only have 8 pins, 0-7
-  mcpRegisterValue = mcpReadByte(mcpRegister);  // read the current value of the register
+  uint16_t mcpRegisterValue;   // current value of the mcp register
+  if (bit >= _portBytes * 8)
+    return;       // we only have 8 pins, 0-7 (16 on the MCP23017)
+  if (mcpRegister == MCP_GPIO)
+    mcpRegister = MCP_OLAT;                     // writing to GPIO writes to the OLAT register
+  if (bitRead(_mcpRegistersValid, mcpRegister))
+    mcpRegisterValue = _mcpRegisters[mcpRegister];  // use our copy of the register, so we don't have to read it over the i2c bus
+  else if (!mcpReadRegisters(mcpRegister, &mcpRegisterValue, 1))  // read the current value of the register
+    return;                                     // don't write the register from a value we could not read
   if (data == 1)
-    mcpRegisterValue |= 1 << bit;     // set the bit if data==1
+    bitSet(mcpRegisterValue, bit);    // set the bit if data==1
   else
-    mcpRegisterValue &= ~(1 << bit);  // clear the bit if data==0
-  mcpWriteByte(mcpRegister, mcpRegisterValue);  // rewrite the register
+    bitClear(mcpRegisterValue, bit);  // clear the bit if data==0
+  mcpWriteRegister(mcpRegister, mcpRegisterValue);  // rewrite the register
 }
 
 // read one bit from mcp register (returns 0 or 1)
@@ -418,7 +2524,179 @@ void I2cKeypad::mcpWriteBit(uint8_t mcpRegister, uint8_t bit, bool data)
 //    the the value of the mcp register bit (0 or 1)
 uint8_t I2cKeypad::mcpReadBit(uint8_t mcpRegister, uint8_t bit)
 {
-  if (bit > 7)
-    return 0;       // we only have 8 bits, 0-7
-  return (mcpReadByte(mcpRegister) >> bit) & 0x01;       // read register, shift to get just desired bit in 0 position, mask it off with 0x01
+  if (bit >= _portBytes * 8)
+    return 0;       // we only have 8 bits, 0-7 (16 on the MCP23017)
+  return (mcpReadRegister(mcpRegister) >> bit) & 0x01;       // read register, shift to get just desired bit in 0 position, mask it off with 0x01
+}
+
+
+
+
+// I2cKeypadEventQueue functions ********************************
+
+// class constructor
+// parameters
+//    events - array that the events are stored in
+//    capacity - number of elements in the events array (a power of 2 up to 128... otherwise only the largest power of 2 that fits is used)
+I2cKeypadEventQueue::I2cKeypadEventQueue(KeypadEvent *events, uint8_t capacity)
+{
+  _events = events;
+  // the head and tail count up to 255 and wrap around to 0, so the capacity must divide evenly into 256, and leave room to tell full from empty
+  uint8_t size = 128;
+  while (size > capacity)
+    size >>= 1;
+  _mask = size - 1;
+  _head = 0;
+  _tail = 0;
+  _overflowPolicy = KEYPAD_OVERFLOW_DROP_NEWEST;
+  _interruptWriter = false;
+  _droppedCount = 0;
+  _droppedBase = 0;
+}
+
+// add an event to the queue (the writer side). If the queue is full, the overflow policy decides which event is thrown away.
+// parameters
+//    event - the event to add
+// returns
+//    true if no event was thrown away
+bool I2cKeypadEventQueue::push(const KeypadEvent &event)
+{
+  bool dropped = false;
+  uint8_t head = _head;
+  if ((uint8_t)(head - _tail) > _mask)
+  {
+    _droppedCount = _droppedCount + 1;
+    // only the reader can safely move the tail if we may be interrupting it
+    if (_overflowPolicy == KEYPAD_OVERFLOW_DROP_NEWEST || _interruptWriter)
+      return false;
+    // KEYPAD_OVERFLOW_DROP_OLDEST... remove the oldest event to make room
+    _tail = _tail + 1;
+    dropped = true;
+  }
+  _events[head & _mask] = event;
+  KEYPAD_MEMORY_BARRIER();        // the event must be in the array before the reader can see the new head
+  _head = head + 1;
+  return !dropped;
+}
+
+// copy the oldest event, without removing it from the queue (the reader side)
+// parameters
+//    event - the event is copied here
+// returns
+//    false if the queue is empty
+bool I2cKeypadEventQueue::peek(KeypadEvent &event)
+{
+  return peek(0, event);
+}
+
+// copy any event in the queue, without removing it (the reader side)
+// parameters
+//    index - number of the event (0 is the oldest)
+//    event - the event is copied here
+// returns
+//    false if the queue does not have that many events
+bool I2cKeypadEventQueue::peek(uint8_t index, KeypadEvent &event)
+{
+  uint8_t tail = _tail;
+  if ((uint8_t)(_head - tail) <= index)
+    return false;
+  KEYPAD_MEMORY_BARRIER();        // read the head before the event it hands over
+  event = _events[(tail + index) & _mask];
+  return true;
+}
+
+// copy the oldest event, and remove it from the queue (the reader side)
+// parameters
+//    event - the event is copied here
+// returns
+//    false if the queue is empty
+bool I2cKeypadEventQueue::pop(KeypadEvent &event)
+{
+  if (!peek(event))
+    return false;
+  KEYPAD_MEMORY_BARRIER();        // finish copying the event before the writer can reuse its place in the array
+  _tail = _tail + 1;
+  return true;
+}
+
+// return the number of events in the queue
+uint8_t I2cKeypadEventQueue::count(void)
+{
+  return (uint8_t)(_head - _tail);
+}
+
+// return the max number of events the queue can hold
+uint8_t I2cKeypadEventQueue::capacity(void)
+{
+  return _mask + 1;
+}
+
+// remove all the events from the queue (the reader side)
+void I2cKeypadEventQueue::flush(void)
+{
+  _tail = _head;
+}
+
+// choose what happens when an event is added to a full queue
+// parameters
+//    policy - KEYPAD_OVERFLOW_DROP_NEWEST (keep the unread events) or KEYPAD_OVERFLOW_DROP_OLDEST (keep the newest events)
+// returns
+//    nothing
+void I2cKeypadEventQueue::setOverflowPolicy(uint8_t policy)
+{
+  _overflowPolicy = policy;
+}
+
+// tell the queue that push() is called from an interrupt (or timer). Then only the reader removes events, so
+// KEYPAD_OVERFLOW_DROP_OLDEST acts like KEYPAD_OVERFLOW_DROP_NEWEST.
+// parameters
+//    enable - true if push() can interrupt the reader
+// returns
+//    nothing
+void I2cKeypadEventQueue::setInterruptWriter(bool enable)
+{
+  _interruptWriter = enable;
+}
+
+// return the number of events thrown away because the queue was full, since the last resetDroppedCount()
+uint16_t I2cKeypadEventQueue::getDroppedCount(void)
+{
+  uint16_t dropped;
+  // the writer may change the count while we read its two bytes, so read it until we get the same value twice
+  do {
+    dropped = _droppedCount;
+  } while (dropped != _droppedCount);
+  return dropped - _droppedBase;
+}
+
+// set the dropped event count back to 0
+void I2cKeypadEventQueue::resetDroppedCount(void)
+{
+  _droppedBase += getDroppedCount();
+}
+
+
+// I2cKeypadMatrix functions ********************************
+
+// class constructor
+// parameters
+//    rowKeys - array of 3 * maxRows words (the keys found by the scan, the debounced keys and the last sample of each row)
+//    keyDebounce - array of maxRows * maxCols words (the debounce time or samples of each key)
+//    maxRows, maxCols - the most rows and columns a keypad that uses the matrix can have
+I2cKeypadMatrix::I2cKeypadMatrix(uint16_t *rowKeys, uint16_t *keyDebounce, uint8_t maxRows, uint8_t maxCols)
+{
+  _scanKeys = rowKeys;
+  _matrixKeys = rowKeys + maxRows;
+  _matrixSample = rowKeys + 2 * maxRows;
+  _keyDebounce = keyDebounce;
+  _maxRows = maxRows;
+  _maxCols = maxCols;
+  clear();
+}
+
+// forget all the keys, so they are all up and none are being debounced
+void I2cKeypadMatrix::clear(void)
+{
+  memset(_scanKeys, 0, 3 * _maxRows * sizeof(uint16_t));
+  memset(_keyDebounce, 0, _maxRows * _maxCols * sizeof(uint16_t));
 }
@@ -22,6 +22,11 @@
 
     The keypad must connect to the I2C bus using a MCP23008 8 bit interface chip.
     A backback board with the MCP23008 chip is available and details are in the link below.
+    Bigger keypads (up to 16 row and column pins, like 8x8) can use a MCP23017 16 bit interface chip,
+    and a PCF8574 (8 bit) or PCF8575 (16 bit) chip can be used too (see the chipType parameter of the constructor).
+
+    On Linux boards (like a Raspberry Pi) define KEYPAD_LINUX_I2CDEV when compiling, and the library uses
+    the kernel's /dev/i2c-N interface instead of the Wire library (see I2cKeypadI2cDev.h).
 
 
   https://www.dcity.org/portfolio/i2c-keypad-library/
@@ -39,10 +44,14 @@
       1. If using Arduino IDE, version 1.5.0 or higher is REQUIRED!
 */
 
-
+#ifndef I2C_KEYPAD_H
+#define I2C_KEYPAD_H
 
 // include files... some boards require different include files
-#ifdef ARDUINO_ARCH_AVR        // if using an arduino
+#ifdef KEYPAD_LINUX_I2CDEV     // if using Linux (Raspberry Pi, etc.) with the keypad on /dev/i2c-N (build with -DKEYPAD_LINUX_I2CDEV)
+#include "I2cKeypadLinux.h"
+#include "I2cKeypadI2cDev.h"
+#elif defined(ARDUINO_ARCH_AVR) // if using an arduino
 #include "Arduino.h"
 #include "Wire.h"
 #elif ARDUINO_ARCH_SAM        // if using an arduino DUE
@@ -61,6 +70,27 @@
 // value returned by getKey(), peekKey(), getKeyUntil() when there are no keys in the buffer to be returned
 #define RETURN_NO_KEY_IN_BUFFER 0
 
+// values returned by getKeysUntil(), getIntUntil(), getFixedUntil() and getFloatUntil()
+#define WAITING_FOR_MORE_KEYS 0        // the input is not finished yet... call the function again (from loop())
+#define TIMEOUT_PERIOD_EXCEEDED -2     // the input is finished: the timeout period went by
+#define MAX_NUM_CHARACTERS_REACHED -3  // the input is finished: the max number of keys (or digits) was entered
+#define TERMINATOR_CHAR_RECEIVED -4    // the input is finished: the terminator key was pressed
+
+#define KEYPAD_MAX_DIGITS 9            // max number of digits for getIntUntil(), getFixedUntil(), getFloatUntil() (so the number fits in a long)
+
+// value used for enableInterrupts() when the chip's INT pin is not connected to a pin on the microcontroller
+#define KEYPAD_NO_INTERRUPT_PIN 0xff
+
+// value returned by timeUntilNextScan() when no scan is scheduled (interrupt mode, waiting for the INT pin)
+#define KEYPAD_NO_SCAN_SCHEDULED 0xffff
+
+// values returned by getErrorState()
+#define KEYPAD_ERROR_NONE 0            // the last scan worked
+#define KEYPAD_ERROR_NACK 1            // the chip did not acknowledge (not connected, no power, or the wrong address)
+#define KEYPAD_ERROR_SHORT_READ 2      // the chip sent fewer bytes than were asked for
+#define KEYPAD_ERROR_BUS_STUCK 3       // SDA is held low, and clocking SCL did not free it (see setBusRecoveryPins())
+#define KEYPAD_ERROR_TIMEOUT 4         // the Wire library gave up on the transaction (only with a Wire timeout, see KEYPAD_WIRE_TIMEOUT)
+
 
 // Constants used in this library code.
 
@@ -82,90 +112,571 @@
 #define MCP_INTCAP    0x08    // Interrupt capture register contains the contents of GPIO port at time of interrupt (0x00)
 #define MCP_GPIO      0x09    // GPIO register is the input value of the port (writing writes to the OLAT register)
 #define MCP_OLAT      0x0A    // Output latch register (0x00)
+#define MCP_WRITABLE_REGISTERS 0x047F  // bit n is set for each register n that can be written (all but INTF, INTCAP and GPIO)
+
+// The MCP23017 has the same registers for each of its two 8 bit ports (A and B). With IOCON.BANK = 0 (the power on value)
+// the port A register is at address (register number above * 2), and the port B register is at the next address, so
+// one i2c transaction reads or writes both ports. The library keeps each register as a 16 bit word, with port A in the
+// low byte (pins 0-7) and port B in the high byte (pins 8-15). The MCP23008 only uses the low byte.
 
 /*
 IOCON bits
 bit 7   0   Unimplemented: Read as ‘0’.
 bit 6   0   Unimplemented: Read as ‘0’.
-bit 5   1   SEQOP: Sequential Operation mode bit. 1 = Sequential operation disabled, address pointer does not increment. 0 = Sequential operation enabled, address pointer increments.
+bit 5   0   SEQOP: Sequential Operation mode bit. 1 = Sequential operation disabled, address pointer does not increment. 0 = Sequential operation enabled, address pointer increments.
 bit 4   0   DISSLW: Slew Rate control bit for SDA output. 1= Slewratedisabled. 0= Slewrateenabled.
 bit 3   0   HAEN: Hardware Address Enable bit (MCP23S08 only). Address pins are always enabled on MCP23008. 1 = Enables the MCP23S08 address pins. 0 = Disables the MCP23S08 address pins.
 bit 2   1   ODR: This bit configures the INT pin as an open-drain output. 1 = Open-drain output (overrides the INTPOL bit). 0 = Active driver output (INTPOL bit sets the polarity).
 bit 1   0   INTPOL: This bit sets the polarity of the INT output pin. 1= Active-high. 0= Active-low.
 bit 0   0   Unimplemented: Read as ‘0’.
 
-In our code we set this register to 0x24
+In our code we set this register to 0x04
+Sequential operation is enabled, so that several registers next to each other can be written (or read) in one i2c transaction.
 */
 
-#define MCP_IOCON_VALUE 0x24         // initial value for the MCP IOCON register.
+#define MCP_IOCON_VALUE 0x04         // initial value for the MCP IOCON register.
+#define MCP23017_IOCON_VALUE 0x44    // initial value for the MCP23017 IOCON register: the same, plus MIRROR (bit 6) which joins the INTA and INTB pins,
+                                     //    so a change on either port pulls both low (only one of them has to be wired to the microcontroller)
+#define MCP_IOCON_SEQOP 5            // bit number of SEQOP in the IOCON register
+
+#ifndef KEYPAD_BUFFER_SIZE
+#define KEYPAD_BUFFER_SIZE 8         // size of the keypad buffer, which stores incoming keypad presses (number of key events, a power of 2 up to 128).
+                                     // Each keypad has this buffer inside it (8 bytes for each event). Use setEventQueue() to give a keypad
+                                     // your own buffer with a different size, or one that is shared by several keypads. This changes the
+                                     // size of I2cKeypad, so set it for the whole build like KEYPAD_STATISTICS (see below).
+                                     // (getKeysUntil() saves its keys in your own array, and getIntUntil(), getFixedUntil(), getFloatUntil() don't need one)
+#endif
+
+// Set KEYPAD_STATISTICS to 1 to keep the statistics (see getStatistics()). They are left out by default, since they
+// cost about 60 bytes of RAM in each keypad, and some code on every i2c transaction.
+// This changes the size of I2cKeypad, so the library and the sketch must be compiled with the same value: set it for the
+// whole build with a compiler option (PlatformIO: build_flags = -DKEYPAD_STATISTICS=1, arduino-cli: --build-property
+// "compiler.cpp.extra_flags=-DKEYPAD_STATISTICS=1"). A #define in the sketch is not seen when the library is compiled.
+#ifndef KEYPAD_STATISTICS
+#define KEYPAD_STATISTICS 0
+#endif
+
+// add one to a counter in _statistics (it stays at its max value instead of wrapping around to 0), if statistics are kept
+#if KEYPAD_STATISTICS
+#define KEYPAD_COUNT(counter) do { if (!++_statistics.counter) --_statistics.counter; } while (0)
+#else
+#define KEYPAD_COUNT(counter) do { } while (0)
+#endif
+
+// Set KEYPAD_TRACE to 1 to put in the scan trace (see setTrace()). With it in, a keypad without a trace only spends
+// a test of the trace pointer on each sample. This changes the size of I2cKeypad, so set it for the whole build like
+// KEYPAD_STATISTICS (see above).
+#ifndef KEYPAD_TRACE
+#define KEYPAD_TRACE 0
+#endif
+
+// save a sample in the trace, if the keypad has one (see I2cKeypadTrace.h)
+#if KEYPAD_TRACE
+#define KEYPAD_RECORD(what, pins) do { if (_trace) _trace->record(what, pins, _keypadState); } while (0)
+#else
+#define KEYPAD_RECORD(what, pins) do { } while (0)
+#endif
+
+// Set KEYPAD_COMBINED_TRANSFERS to 1 when starting an i2c transfer costs much more than the bytes on the bus (the Linux
+// i2c-dev transport sets it, since each transfer is a system call). A scan step then makes a column an output and reads
+// the rows in one transfer (joined by a repeated start), when the settle time is shorter than the read takes to sample the pins.
+#ifndef KEYPAD_COMBINED_TRANSFERS
+#define KEYPAD_COMBINED_TRANSFERS 0
+#endif
+
+// i2c clock (Hz) the library assumes until begin() is given one (0 = not known)
+#ifndef KEYPAD_I2C_CLOCK
+#define KEYPAD_I2C_CLOCK 0
+#endif
+
+// i2c error handling defaults (see setRetries() and setChipCheckInterval())
+#define KEYPAD_I2C_RETRIES 2           // times a failed i2c transaction is tried again
+#define KEYPAD_RETRY_TIME 1000         // max microseconds spent retrying one i2c transaction
+#define KEYPAD_CHIP_CHECK_INTERVAL 0   // milliseconds between checks that the chip has not been reset (0 = only after an i2c error)
+#define KEYPAD_NO_PIN 0xff             // setBusRecoveryPins() has not been called
+
+// Set KEYPAD_WIRE_TIMEOUT to the microseconds before the Wire library gives up on a stuck transaction (for example 25000),
+// to have begin() turn on the Wire timeout (only on cores that have Wire.setWireTimeout()). It is off by default, since
+// it changes the Wire library for every device on the bus. You can also call Wire.setWireTimeout() yourself.
+#ifndef KEYPAD_WIRE_TIMEOUT
+#define KEYPAD_WIRE_TIMEOUT 0
+#endif
 
-#define KEYPAD_BUFFER_SIZE 32        // size of the keypad buffer, which stores incoming keypad presses.
-                                     // This is also the max buffer size for strings and numbers that we are getting from the keypad (see getKeysUntil, getIntUntil, getFloatUntil)
+#define KEYPAD_HISTOGRAM_BINS 8        // number of scan time ranges in KeypadStatistics::scanTimes
+#define KEYPAD_HISTOGRAM_FIRST_BIN 256 // scans shorter than this many microseconds are counted in the first range (each range after that is twice as long)
+
+// methods for finding which key is pressed (selected with the scanMode parameter of the constructor)
+#define KEYPAD_SCAN_COLUMNS 0          // drive one column low at a time and read the rows (i2c traffic grows with the number of columns)
+#define KEYPAD_SCAN_LINE_REVERSAL 1    // read the rows with the columns low, then drive the rows low and read the columns (always 4 i2c transactions)
+#define KEYPAD_SCAN_MATRIX 2           // read every key on each scan, so several keys can be held down at once (n-key rollover)
+                                       //    Each key is debounced by itself, and both press and release events are saved.
+                                       //    The state of each key is kept in a I2cKeypadMatrix given to setMatrix().
+
+// chips that the keypad can be connected to (selected with the chipType parameter of the constructor).
+// Pin numbers in the rowPins and colPins arrays are 0-7 on the 8 bit chips, and 0-15 on the 16 bit chips
+// (MCP23017: GPA0-GPA7 are pins 0-7 and GPB0-GPB7 are pins 8-15, PCF8575: P00-P07 are pins 0-7 and P10-P17 are pins 8-15).
+#define KEYPAD_MCP23008 0              // 8 pins (the default)
+#define KEYPAD_MCP23017 1              // 16 pins, both ports are read in one i2c transaction
+#define KEYPAD_PCF8574 2               // 8 quasi-bidirectional pins: no registers, a pin written high is an input with a weak pullup
+#define KEYPAD_PCF8575 3               // 16 quasi-bidirectional pins
+
+// The settings that change the size of I2cKeypad. This is the type of a hidden parameter of the constructor, so a sketch
+// compiled with different settings than the library asks for a constructor the library does not have, and fails to link
+// (with an error that shows the settings) instead of overwriting memory.
+template <uint8_t BufferSize, bool Statistics, bool Trace>
+struct I2cKeypadLayout {};
+#define KEYPAD_LAYOUT I2cKeypadLayout<KEYPAD_BUFFER_SIZE, KEYPAD_STATISTICS, KEYPAD_TRACE>
+
+// types of key events returned by getKeyEvent()
+#define KEY_EVENT_PRESSED 1            // a key was pressed
+#define KEY_EVENT_RELEASED 2           // a key was released (only saved with KEYPAD_SCAN_MATRIX)
+#define KEY_EVENT_CODE 3               // a code was entered (only saved with setCodeMatcher()), the event's key is the number of the code
+#define KEY_EVENT_REPEAT 4             // a key is still held down, saved every repeat rate after the repeat delay (only saved with setRepeat())
+#define KEY_EVENT_LONG_PRESS 5         // a key has been held down for the long press time, saved once per press (only saved with setLongPress())
+
+// what happens when a key event is saved in a full keypad buffer (see I2cKeypadEventQueue::setOverflowPolicy())
+// Either way, the number of events thrown away is counted (see I2cKeypadEventQueue::getDroppedCount()).
+#define KEYPAD_OVERFLOW_DROP_NEWEST 0  // the new event is thrown away (the default)
+#define KEYPAD_OVERFLOW_DROP_OLDEST 1  // the oldest unread event is thrown away to make room for the new one
+                                       //    (acts like KEYPAD_OVERFLOW_DROP_NEWEST when events are saved from an interrupt, see setIsrProducerMode())
+
+// The key event queue is shared by one writer (scanKeys()) and one reader (getKey(), etc.), which may run in a timer
+// interrupt and in loop(). Each side only changes its own index, and this barrier makes sure an event is completely
+// written (or read) before the index that hands it over is changed.
+#if defined(__AVR__)
+#define KEYPAD_MEMORY_BARRIER() __asm__ __volatile__ ("" ::: "memory")   // one core, so the compiler just must not reorder memory accesses
+#else
+#define KEYPAD_MEMORY_BARRIER() __sync_synchronize()
+#endif
 
 // keypad scanner states used in the function scanKeypad().
 #define WAITING_FOR_NEW_KEY_PRESS 0
 #define WAITING_DEBOUNCE_TIME 1
 #define WAITING_FOR_NO_KEYS_PRESSED 2
 
+// steps of one keypad scan, used in the function scanStep(). Each step uses the i2c bus at most once.
+#define SCAN_STEP_IDLE 0               // no scan is in progress
+#define SCAN_STEP_READ_INTERRUPT 1     // read INTF and INTCAP to see if a row pin changed (interrupt mode with a MCP chip)
+#define SCAN_STEP_QUICK_CHECK 2        // read GPIO with all the columns low, to see if any key is pressed
+#define SCAN_STEP_DRIVE_COLUMN 3       // make one column an output (low)
+#define SCAN_STEP_READ_COLUMN 4        // read the rows for that column
+#define SCAN_STEP_REVERSE_LINES 5      // KEYPAD_SCAN_LINE_REVERSAL: make the rows outputs (low)
+#define SCAN_STEP_READ_REVERSED 6      // KEYPAD_SCAN_LINE_REVERSAL: read the columns
+#define SCAN_STEP_RESTORE 7            // put the chip back in the quick check state
+#define SCAN_STEP_CHECK_CHIP 8         // see if the chip was reset (read IOCON, or the PCF outputs), and set it up again if it was (or after an i2c error)
+
+// the rows must settle after a column is driven low (or let go) before they are read (see setSettleTime() and calibrateSettleTime())
+#define KEYPAD_SETTLE_TIME 10          // default microseconds from driving a column low until the rows are read
+#define KEYPAD_SETTLE_MAX 1000         // longest settle time calibrateSettleTime() will try (microseconds)
+#define KEYPAD_CALIBRATE_TRIES 4       // times each settle time must work in calibrateSettleTime()
+#define KEYPAD_MCP_SAMPLE_BITS 28      // bit times from the start of a MCP pin read until the pins are sampled (address, register, address again)
+#define KEYPAD_PCF_SAMPLE_BITS 9       // bit times from the start of a PCF pin read until the pins are sampled (at the acknowledge of the address)
+
 // values returned by various INTERNAL functions (these are NOT useful for user's code)
 #define NO_KEYS_PRESSED -1
-#define TIMEOUT_PERIOD_EXCEEDED -2
-#define MAX_NUM_CHARACTERS_REACHED -3
-#define TERMINATOR_CHAR_RECEIVED -4
 #define MULTIPLE_KEYS_PRESSED -5
 
 
 
+// function called by getKeyUntil() while it waits for the next scan (see setWaitHook()). waitTime is the number of
+// milliseconds until the next scan (or the timeout), and the function can return sooner.
+typedef void (*I2cKeypadWaitHook)(uint16_t waitTime);
+
+
+// one key event saved in the keypad buffer
+struct KeypadEvent {
+  uint8_t key;                    // ASCII value of the key (from the keyMap array)
+  uint8_t row;                    // row of the key on the keypad (0 is the first row)
+  uint8_t col;                    // column of the key on the keypad (0 is the first column)
+  uint8_t type;                   // KEY_EVENT_PRESSED, KEY_EVENT_RELEASED, KEY_EVENT_CODE, KEY_EVENT_REPEAT or KEY_EVENT_LONG_PRESS
+  unsigned long time;             // micros() when the event was saved, so you can measure how long it waited in the buffer
+};
+
+
+// counters kept by the library, to see what scanning the keypad costs (see getStatistics()).
+// The counters stop at their max value instead of wrapping around.
+struct KeypadStatistics {
+  uint32_t transactions;          // i2c transactions
+  uint32_t bytes;                 // bytes on the i2c bus (including the address bytes)
+  uint16_t nacks;                 // transactions the chip did not acknowledge
+  uint16_t shortReads;            // reads that returned fewer bytes than asked for
+  uint16_t retries;               // i2c transactions that were tried again after an error
+  uint16_t busRecoveries;         // times SCL was clocked to free the i2c bus (see setBusRecoveryPins())
+  uint16_t chipResets;            // times the chip was found reset, and its registers were set up again
+  uint32_t scans;                 // scans of the keypad that were finished
+  uint16_t failedScans;           // scans that were given up because of an i2c error
+  uint32_t quickChecks;           // scans that were finished by the quick check (no keys were down)
+  uint32_t sweeps;                // scans that had to find which key was down (one column at a time, or line reversal)
+  uint16_t keysAccepted;          // key presses that were saved in the keypad buffer
+  uint16_t bouncesRejected;       // key changes that went away before the debounce time (or debounce samples) was up
+  uint16_t keysDropped;           // key events thrown away because the keypad buffer was full
+  uint16_t scanTimes[KEYPAD_HISTOGRAM_BINS];  // number of scans that took: less than 256us, 256-511us, 512-1023us, ... 16384us or more
+  uint32_t maxScanTime;           // longest scan (microseconds spent in scanKeys(), not counting the time between calls with a scan budget)
+};
+
+
+// ring buffer of key events. The events are stored in an array that is provided when the queue is created
+// (use I2cKeypadEventBuffer<capacity> to create a queue along with its array).
+// The capacity must be a power of 2 (up to 128), so the indexes can wrap around with a mask.
+// One writer (push) and one reader (peek, pop, flush) can use the queue at the same time without turning off interrupts,
+// for example scanKeys() in a timer interrupt and getKey() in loop().
+class I2cKeypadEventQueue {
+public:
+  I2cKeypadEventQueue(KeypadEvent *events, uint8_t capacity);  // creates a queue that uses the events array (capacity is the number of elements, a power of 2)
+
+  bool push(const KeypadEvent &event);    // add an event, returns false if an event was thrown away because the queue was full
+  bool peek(KeypadEvent &event);          // copy the oldest event without removing it, returns false if the queue is empty
+  bool peek(uint8_t index, KeypadEvent &event);  // copy the event at index (0 is the oldest) without removing it, returns false if there is none
+  bool pop(KeypadEvent &event);           // copy the oldest event and remove it, returns false if the queue is empty
+  uint8_t count(void);                    // returns the number of events in the queue
+  uint8_t capacity(void);                 // returns the max number of events the queue can hold
+  void flush(void);                       // remove all the events
+
+  void setOverflowPolicy(uint8_t policy); // KEYPAD_OVERFLOW_DROP_NEWEST or KEYPAD_OVERFLOW_DROP_OLDEST
+  void setInterruptWriter(bool enable);   // true if push() is called from an interrupt (only the reader may remove events then)
+  uint16_t getDroppedCount(void);         // returns the number of events thrown away because the queue was full
+  void resetDroppedCount(void);           // set the dropped event count back to 0
+
+private:
+  KeypadEvent *_events;           // array of events
+  uint8_t _mask;                  // number of elements in _events - 1
+  volatile uint8_t _head;         // number of events saved (only changed by the writer). The index into _events is _head & _mask
+  volatile uint8_t _tail;         // number of events read (only changed by the reader). The index into _events is _tail & _mask
+  uint8_t _overflowPolicy;        // KEYPAD_OVERFLOW_DROP_NEWEST or KEYPAD_OVERFLOW_DROP_OLDEST
+  bool _interruptWriter;          // true if push() is called from an interrupt
+  volatile uint16_t _droppedCount;  // number of events thrown away (only changed by the writer)
+  uint16_t _droppedBase;          // _droppedCount when resetDroppedCount() was called (only changed by the reader)
+};
+
+
+// key event queue along with its array, the number of events it can hold is set when it is declared, for example
+//     I2cKeypadEventBuffer<8> smallBuffer;
+template <uint8_t Capacity>
+class I2cKeypadEventBuffer : public I2cKeypadEventQueue {
+  static_assert(Capacity && !(Capacity & (Capacity - 1)) && Capacity <= 128, "the key event buffer size must be a power of 2, up to 128");
+
+public:
+  I2cKeypadEventBuffer() : I2cKeypadEventQueue(_storage, Capacity) {}
+
+  I2cKeypadEventBuffer(const I2cKeypadEventBuffer &) : I2cKeypadEventQueue(_storage, Capacity) {}  // a copy starts out empty, with its own array
+  I2cKeypadEventBuffer &operator=(const I2cKeypadEventBuffer &) { flush(); return *this; }           // keeps its own array, and empties it
+
+private:
+  KeypadEvent _storage[Capacity];
+};
+
+
+// the state that KEYPAD_SCAN_MATRIX keeps for each key, in arrays that are provided when it is created
+// (use I2cKeypadMatrixBuffer<rows, columns> to create one along with its arrays). The other scan modes don't need one,
+// so a keypad only has this RAM when it is given a matrix with I2cKeypad::setMatrix().
+class I2cKeypadMatrix {
+  friend class I2cKeypad;
+
+public:
+  I2cKeypadMatrix(uint16_t *rowKeys, uint16_t *keyDebounce, uint8_t maxRows, uint8_t maxCols);  // rowKeys holds 3 * maxRows words,
+                                  //    keyDebounce holds maxRows * maxCols words
+
+private:
+  void clear(void);               // forget all the keys (they are all up)
+
+  uint16_t *_scanKeys;            // keys found so far by the scan in progress (one word per row, bit set if the key in that column is down)
+  uint16_t *_matrixKeys;          // debounced state of each key
+  uint16_t *_matrixSample;        // keys that were down in the last scan
+  uint16_t *_keyDebounce;         // for each key, the time (low 16 bits of millis()) of the last scan where it read differently than
+                                  //    in the scan before, or with setDebounceSamples() its last 8 samples (bit 0 is the newest, set if the key was down)
+  uint8_t _maxRows;               // number of rows the arrays have room for
+  uint8_t _maxCols;               // number of columns the arrays have room for
+};
+
+
+// key matrix along with its arrays, for a keypad with up to Rows rows and Cols columns, for example
+//     I2cKeypadMatrixBuffer<4, 4> matrix;
+//     keypad.setMatrix(&matrix);
+template <uint8_t Rows, uint8_t Cols>
+class I2cKeypadMatrixBuffer : public I2cKeypadMatrix {
+  static_assert(Rows && Cols && Rows <= 16 && Cols <= 16, "a key matrix has 1-16 rows and 1-16 columns");
+
+public:
+  I2cKeypadMatrixBuffer() : I2cKeypadMatrix(_rowKeys, _keyDebounce, Rows, Cols) {}
+
+private:
+  uint16_t _rowKeys[3 * Rows];
+  uint16_t _keyDebounce[Rows * Cols];
+};
+
+
+
+// pin tables for one keypad layout, worked out by I2cKeypadT when the program is compiled (see I2cKeypadT.h).
+// The tables are in flash. Entry n of rows and cols is for the value n % 256 in byte n / 256 of the port.
+struct I2cKeypadPinTables {
+  const void *columnDirection;    // IODIR value that makes only column c an output
+  const void *rows;               // for each value of a port byte, bit r set for each row r that is low
+  const void *cols;               // for each value of a port byte, bit c set for each column c that is low
+  uint16_t rowPinsMask;           // mask with a high bit for each row pin
+  uint8_t bytes;                  // 1 if the entries are bytes (every pin is 0-7), 2 if they are words and there is a table for each byte of the port
+};
+
+class I2cKeypadManager;
+class I2cKeypadCodeMatcher;
+class I2cKeypadTrace;
+class I2cKeypadMatrix;
+
 class I2cKeypad {                     // class definition
+  friend class I2cKeypadManager;      // the manager sees whether a scan is in progress, and reads the key buffer without scanning
+
 public:
 
   // constructor function and public functions
 
-  I2cKeypad(char *keyMap, uint8_t *rowPins, uint8_t *colPins,  uint8_t rowNum, uint8_t colNum, uint16_t debounceTime, uint8_t i2cAddress); // creates a keypad object
+  I2cKeypad(char *keyMap, uint8_t *rowPins, uint8_t *colPins,  uint8_t rowNum, uint8_t colNum, uint16_t debounceTime, uint8_t i2cAddress,
+            uint8_t scanMode = KEYPAD_SCAN_COLUMNS, uint8_t chipType = KEYPAD_MCP23008,
+            KEYPAD_LAYOUT layout = KEYPAD_LAYOUT());  // creates a keypad object (leave out layout, see I2cKeypadLayout).
+                                      //    A copy has its own empty buffer, and shares the queue, matrix, code matcher and trace given to the set functions.
 
-  void begin();                       // required to initialize the keypad. Run this in setup()!
+  void begin(uint32_t i2cClock = 0);  // required to initialize the keypad. Run this in setup()! i2cClock sets the i2c clock (Hz), 0 leaves it as it is.
 
-  void scanKeys(void);              // scan for keys pressed, and puts them in the keypad buffer. This can be run in the loop() function so you don't miss keys
+  bool scanKeys(void);              // scan for keys pressed, and puts them in the keypad buffer. This can be run in the loop() function so you don't miss keys
                                       //    OR use some timer feature to call this function frequently to check for keys (10ms is a good period to use).
-
-  uint8_t getKeyCount(void);             // returns the number of characters in the keypad buffer
+                                      //    Returns true if a full scan of the keypad was finished (or given up because of an i2c error) by this call.
+  void setScanBudget(uint8_t steps);  // max number of i2c transactions one scanKeys() call can use (0 = finish the whole scan, the default).
+                                      //    A scan that does not fit is continued by the next call.
+  uint8_t getMaxScanSteps(void);      // returns the most i2c transactions one full scan can take (with the current scan mode and keypad size)
+  uint16_t timeUntilNextScan(void);   // returns the milliseconds until scanKeys() will scan the keypad again (0 = now), so the program can sleep
+                                      //    or do other work until then. KEYPAD_NO_SCAN_SCHEDULED if only the INT pin can start a scan.
+  void setScanRates(uint16_t activeInterval, uint16_t idleInterval, uint16_t idleDelay);  // scan every activeInterval ms while keys are active, and
+                                      //    every idleInterval ms once no keys have been down for idleDelay ms (both are the debounce time by default)
+  void setDebounceSamples(uint8_t pressSamples, uint8_t releaseSamples);  // debounce by counting scans in a row that agree (press 2-8, release 1-8),
+                                      //    instead of by the debounce time (pressSamples = 0 goes back to using the debounce time)
+  void setRepeat(uint16_t repeatDelay, uint16_t repeatRate, const char *keys = 0);  // save a KEY_EVENT_REPEAT event every repeatRate ms once a key
+                                      //    has been held for repeatDelay ms (0 = no repeat). keys lists the keys that repeat (0 = all of them).
+  void setLongPress(uint16_t longPressTime, const char *keys = 0);  // save a KEY_EVENT_LONG_PRESS event once a key has been held for
+                                      //    longPressTime ms (0 = never). keys lists the keys that have long presses (0 = all of them).
+  bool setMatrix(I2cKeypadMatrix *matrix);  // keep the state of each key for KEYPAD_SCAN_MATRIX in matrix (for example an I2cKeypadMatrixBuffer<4, 4>).
+                                      //    Run this before begin(). Returns false if the matrix is too small for the keypad.
+
+  uint8_t getKeyCount(void);             // returns the number of characters in the keypad buffer (the keys that getKey() returns)
   uint8_t peekKey(void);                  // returns the next character in the keypad buffer without removing it from the buffer
-  uint8_t getKey(void);                   // returns the next character in the keypad buffer and removes it from the buffer
+  uint8_t getKey(void);                   // returns the next character in the keypad buffer and removes it (along with any release, code or long press events in front of it)
+
+  uint8_t getKeyEvent(uint8_t *eventType); // returns the next key in the keypad buffer and removes it. eventType is set to KEY_EVENT_PRESSED, KEY_EVENT_RELEASED, etc.
+  bool    getEvent(KeypadEvent &event);   // copies the next event (key, row, column, type and time) and removes it from the buffer. Returns false if there are no events.
+
+  void setEventQueue(I2cKeypadEventQueue &eventQueue);  // save key events in eventQueue instead of the keypad's own buffer (for example an I2cKeypadEventBuffer<64>)
+  I2cKeypadEventQueue &getEventQueue(void);  // returns the queue that key events are saved in (to set the overflow policy, or get the dropped event count)
+  void setCodeMatcher(I2cKeypadCodeMatcher *codeMatcher);  // check the keys pressed for codes, and save a KEY_EVENT_CODE event when one is entered (0 = stop)
 
   uint8_t getKeyUntil(uint16_t timeoutPeriod);      // returns one key from the keypad buffer, or waits up to timeoutPeriod for a keypress to occur.
+  void setWaitHook(I2cKeypadWaitHook waitHook);     // function that getKeyUntil() calls between scans, to sleep or do other work (0 = keep scanning)
+
+  // These read a whole entry (a code, a PIN, a quantity) without waiting: call them from loop() until they return something other
+  //    than WAITING_FOR_MORE_KEYS. The entry ends when the terminator key is pressed, maxKeys (or maxDigits) are entered, or
+  //    timeoutPeriod ms (0 = no timeout) go by after the first call. Use 0 for a key that is not used (terminatorKey, backspaceKey, etc.)
+  int getKeysUntil(char *keys, uint8_t maxKeys, uint16_t timeoutPeriod, uint8_t terminatorKey, uint8_t backspaceKey = 0);  // keys must hold maxKeys + 1 chars
+  int getIntUntil(long &value, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                  uint8_t backspaceKey = 0, uint8_t minusKey = 0);   // digit keys make a whole number (other keys are ignored)
+  int getFixedUntil(long &value, uint8_t decimals, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                    uint8_t decimalPointKey, uint8_t backspaceKey = 0, uint8_t minusKey = 0);  // a number with a decimal point, times 10^decimals ("2.5" = 250 with decimals = 2)
+  int getFloatUntil(float &value, uint8_t maxDigits, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                    uint8_t decimalPointKey, uint8_t backspaceKey = 0, uint8_t minusKey = 0);  // a number with a decimal point
+  void cancelInput(void);             // throw away the entry in progress, so the next call of the functions above starts a new one
 
   void    flushKeys(void);                // flush the keypad buffer (removes all keypresses saved in the buffer).
 
+  void setIsrProducerMode(bool enable);   // true if scanKeys() is called from a timer (or interrupt). getKey(), peekKey(), getKeyCount(), flushKeys(), etc.
+                                          //    then only read the keypad buffer, and don't use the i2c bus themselves.
+
+  void enableInterrupts(uint8_t interruptPin = KEYPAD_NO_INTERRUPT_PIN);  // use the chip's INT output, so scanKeys() only uses the i2c bus after a key changes. Run this after begin().
+                                      //    interruptPin is the microcontroller pin wired to INT (it is checked with digitalRead()),
+                                      //    OR leave it out and call interruptReceived() from your own interrupt routine attached to INT.
+  void disableInterrupts(void);       // go back to polling the keypad every debounce period
+  void interruptReceived(void);       // tell the library that the INT pin went low. This is safe to call from an interrupt routine (it does not use the i2c bus).
+
+  void resyncRegisters(void);         // rewrite all the chip registers from the library's saved copy (use after an i2c bus error or if the chip was reset)
+
+  uint8_t getErrorState(void);        // returns KEYPAD_ERROR_NONE if the last scan worked, or the i2c error that stopped it (KEYPAD_ERROR_NACK, etc.)
+  void setRetries(uint8_t retries, uint16_t retryTime);  // times a failed i2c transaction is tried again, and the max microseconds spent retrying it
+  void setBusRecoveryPins(uint8_t sdaPin, uint8_t sclPin);  // microcontroller SDA and SCL pins, so a stuck i2c bus can be freed by clocking SCL
+  void setChipCheckInterval(uint16_t interval);  // milliseconds between checks that the chip was not reset (0 = never)
+
+  void setSettleTime(uint16_t settleTime);  // microseconds from driving a column low until the rows are read (default KEYPAD_SETTLE_TIME)
+  uint16_t getSettleTime(void);       // returns the settle time in microseconds
+  bool calibrateSettleTime(void);     // measure how long the rows and columns take to settle with this keypad's wiring, and use that. Run after begin() with no keys pressed.
+
+#if KEYPAD_TRACE
+  void setTrace(I2cKeypadTrace *trace);  // save a sample in trace each time the scan reads the pins (0 = stop), to find out later why a key was missed
+  uint16_t readTrace(uint8_t *data, uint16_t length);  // copy the next part of the trace (a header, then the samples) to data. Returns the number of
+                                      //    bytes copied, 0 when the whole trace has been read. The trace is paused until then.
+#endif
+
+#if KEYPAD_STATISTICS
+  const KeypadStatistics &getStatistics(void);  // returns the counters (i2c use, scans, keys, scan times) since begin() or resetStatistics()
+  void resetStatistics(void);         // set all the counters back to 0
+#endif
+
+
+protected:
+  const I2cKeypadPinTables *_pinTables;  // tables from I2cKeypadT, used instead of the _rowPins and _colPins arrays (0 for a I2cKeypad).
+                                  //    The _keyMap array is in flash when there are tables.
+
 
 private:
   // private functions used by this library
 
-  uint8_t mcpReadByte(uint8_t mcpRegister);                       // read a byte of data from the MCP chip from register mcpRegister
-  uint8_t mcpReadBit(uint8_t mcpRegister, uint8_t bit);           // read one bit (0-7) from register mcpRegister from the MCP chip
-  void mcpWriteByte(uint8_t mcpRegister, uint8_t data);           // write a byte of data to the MCP chip to register mcpRegister
-  void mcpWriteBit(uint8_t mcpRegister, uint8_t bit, bool data);  // write one bit of data to bit position (0-7) in register mcpRegister
-  int  checkForKeyPress(void);                                    // check for a key press, and return it's value
+  // keypad layout functions, these use the tables from I2cKeypadT when the keypad has them
+  uint16_t rowPinsMask(void);                                     // mask with a high bit for each row pin
+  uint16_t columnDirection(uint8_t col);                          // IODIR value that makes only this column pin an output
+  uint16_t decodeRows(uint16_t inputPort);                        // bit r set for each row r that is low in inputPort
+  uint16_t decodeColumns(uint16_t inputPort);                     // bit c set for each column c that is low in inputPort
+  uint8_t mapKey(uint8_t keyIndex);                               // ASCII value of the key at keyIndex (row * number of columns + column)
+  uint16_t decodePort(const void *table, uint16_t inputPort);     // look up each byte of inputPort in a table from I2cKeypadT
+  uint16_t pinTableEntry(const void *table, uint16_t n);          // read entry n of a table from I2cKeypadT
+
+  // the chip the keypad is connected to (these hide the differences between the MCP and PCF chips from the scan)
+  bool expanderSetup(void);                                       // set up the chip the way the keypad needs it (done by begin())
+  bool expanderCheck(bool &wasReset);                             // check if the chip was reset (lost the setup from expanderSetup())
+  bool expanderWriteDirection(uint16_t direction);                // make the pins with a 0 bit outputs (low), and the rest inputs
+  bool expanderReadPins(uint16_t &pins);                          // read the level of every pin
+  bool expanderWriteReadPins(uint16_t direction, uint16_t &pins); // write the direction and read the pins in one transfer
+  bool combinedTransfers(void);                                   // true if a scan step can write the direction and read the pins in one transfer
+  bool mcpChip(void);                                             // true for the MCP chips (which have registers)
+  uint16_t portMask(void);                                        // a bit set for each pin the chip has
+
+  uint16_t mcpReadRegister(uint8_t mcpRegister);                  // read register mcpRegister from the MCP chip
+  uint8_t mcpReadBit(uint8_t mcpRegister, uint8_t bit);           // read one bit (0-15) from register mcpRegister from the MCP chip
+  bool mcpReadRegisters(uint8_t mcpRegister, uint16_t *data, uint8_t count);        // read count registers, starting at register mcpRegister
+  bool mcpWriteRegister(uint8_t mcpRegister, uint16_t data);      // write data to register mcpRegister in the MCP chip
+  bool mcpWriteRegisters(uint8_t mcpRegister, const uint16_t *data, uint8_t count); // write count registers in one transaction, starting at register mcpRegister
+  bool mcpSequentialMode(void);                                   // true if the MCP address pointer increments after each byte
+  void mcpWriteBit(uint8_t mcpRegister, uint8_t bit, bool data);  // write one bit of data to bit position (0-15) in register mcpRegister
+  uint16_t mcpIoconValue(void);                                   // the IOCON value written by expanderSetup() (both bytes on the MCP23017)
+  bool pcfWrite(uint16_t pins);                                   // write the PCF port (a 1 bit makes the pin an input with a weak pullup)
+
+  bool i2cWrite(const uint8_t *data, uint8_t count);              // send count bytes to the chip in one transaction (retries if it fails)
+  bool i2cRead(int16_t address, uint8_t *data, uint8_t count);    // read count bytes from the chip, after sending the register address (if not -1)
+  bool i2cTransfer(const uint8_t *writeData, uint8_t writeCount, int16_t address, uint8_t *data, uint8_t count);  // write, then read, in one transfer (retries if it fails)
+  uint8_t i2cBusTransfer(const uint8_t *writeData, uint8_t writeCount, int16_t address, uint8_t *data, uint8_t count);  // one try of i2cTransfer() on the bus
+  bool retryTransaction(uint8_t attempt, unsigned long startTime, uint8_t error); // decide whether to try a failed i2c transaction again
+  bool busHeld(uint8_t error);                                    // check if a failed i2c transaction left a chip holding SDA low
+  bool recoverBus(void);                                          // clock SCL until a chip lets go of SDA
+  uint16_t sampleTime(void);                                      // microseconds from the start of a pin read until the chip samples the pins
+  void updateColumnWait(void);                                    // work out the wait before reading the rows from the settle time
+  void waitToSettle(void);                                        // wait for the pins to settle after the last change of direction
+  bool startScan(void);                                           // start a new scan, if it is time for one
+  uint16_t scanInterval(void);                                    // milliseconds between scans (active or idle rate)
+  bool scanStep(void);                                            // run one step of the scan, returns true when the scan is finished
+  bool scanFailed(void);                                          // give up the scan in progress after an i2c error
+  uint8_t keyBufferCount(void);                                   // number of keys in the keypad buffer that getKey() returns (does not scan the keypad)
+  uint8_t readKeyBuffer(bool remove);                             // next key in the keypad buffer, optionally removing it (does not scan the keypad)
+  bool nextKeyEvent(KeypadEvent &event);                          // copy the next key event in the keypad buffer without removing it (does not scan the keypad)
+  void flushKeyBuffer(void);                                      // remove all keys from the keypad buffer (does not scan the keypad)
+  I2cKeypadEventQueue &eventQueue(void);                          // the queue key events are saved in (_keyBuffer, or the one given to setEventQueue())
+  void addKeyEvent(uint8_t keyIndex, uint8_t eventType);          // save a key event in the keypad buffer
+  void updateKeyState(int key);                                   // run the keypad state machine with the key found by a scan
+  void holdKey(void);                                             // save the repeat and long press events for the key being held down
+  bool keyInList(const char *keys, uint8_t keyIndex);             // true if the key at keyIndex is in keys (every key is in a list that is 0)
+  void updateMatrix(void);                                        // save press and release events for the keys found by a scan (KEYPAD_SCAN_MATRIX)
+  bool interruptPending(void);                                    // check if the chip has signaled a change on the keypad pins
+  bool startInput(void);                                          // start a new entry for getKeysUntil(), etc. (if one is not in progress)
+  int endInput(int status);                                       // finish the entry in progress
+  int readNumber(uint8_t maxDigits, uint8_t maxWhole, uint8_t maxDecimals, uint16_t timeoutPeriod, uint8_t terminatorKey,
+                 uint8_t decimalPointKey, uint8_t backspaceKey, uint8_t minusKey);  // add the new keys to the number being entered
+  void countTransaction(uint8_t bytes, bool acknowledged);        // add an i2c transaction to the statistics
+  void countScanTime(unsigned long scanTime);                     // add a finished scan to the scan time histogram
+#if KEYPAD_TRACE
+  void traceHeader(uint8_t *header);                              // fill in the header read by readTrace() with the keypad's setup
+#endif
+  static uint8_t lowestBit(uint16_t bits);                        // number of the lowest bit that is set in bits
+  static bool keyEvent(const KeypadEvent &event);                 // true for the events that getKey() returns (presses and repeats)
 
 
   // private variables
 
   char    *_keyMap;               // array for mapping which ascii character is returned for each key on the keypad
-  uint8_t *_rowPins;              // array for mapping which pin on the MCP23008 corresponds to each row on the keypad
-  uint8_t *_colPins;              // array for mapping which pin on the MCP23008 corresponds to each column on the keypad
+  uint8_t *_rowPins;              // array for mapping which pin on the chip corresponds to each row on the keypad
+  uint8_t *_colPins;              // array for mapping which pin on the chip corresponds to each column on the keypad
   uint8_t _rowNum;                // number of rows on the keypad (start counting at 1)
   uint8_t _colNum;                // number of columns on the keypad (start counting at 1)
   uint16_t _debounceTime;         // amount of time to allow for keypad debounce (in milliseconds)
+  uint16_t _activeInterval;       // milliseconds between scans while keys are active
+  uint16_t _idleInterval;         // milliseconds between scans while the keypad is idle
+  uint16_t _idleDelay;            // milliseconds with no keys down before using _idleInterval
+  uint8_t _pressSamples;          // scans in a row that must find a key pressed (0 = use _debounceTime instead)
+  uint8_t _releaseSamples;        // scans in a row that must find a key released
+  uint8_t _sampleCount;           // scans in a row that agreed so far
   uint8_t _i2cAddress;            // the i2c address of the mcp23008 chip
+  uint8_t _scanMode;              // KEYPAD_SCAN_COLUMNS, KEYPAD_SCAN_LINE_REVERSAL or KEYPAD_SCAN_MATRIX
+  uint8_t _chipType;              // KEYPAD_MCP23008, KEYPAD_MCP23017, KEYPAD_PCF8574 or KEYPAD_PCF8575
+  uint8_t _portBytes;             // bytes in each read or write of the chip's pins (1 for the 8 bit chips, 2 for the 16 bit chips)
 
-  unsigned char _keyBuffer[KEYPAD_BUFFER_SIZE];   // buffer for storing the keys that are pressed
-  uint8_t _keyBufferHead;         // index into keyBuffer array for last character to be read
-  uint8_t _keyBufferTail;         // index into keyBuffer array for next character to be read
+  I2cKeypadEventBuffer<KEYPAD_BUFFER_SIZE> _keyBuffer;  // the keypad's own buffer for storing the key events
+  I2cKeypadEventQueue *_eventQueue;   // queue given to setEventQueue() (0 = use _keyBuffer)
+  I2cKeypadMatrix *_matrix;           // state of each key for KEYPAD_SCAN_MATRIX (0 if setMatrix() was not called)
+  I2cKeypadCodeMatcher *_codeMatcher; // matcher that is fed the keys pressed (0 if setCodeMatcher() was not called)
 
   unsigned long _lastScanTime;    // time of last keypad scan
+  unsigned long _lastActivityTime;  // time of the last scan that found a key down (or being debounced)
+  unsigned long _debounceStartTime; // time of the scan that first found the key being debounced
   uint8_t _keypadState;           // state of the keypad scanner function
-  int _lastKeyPressed;            // last value from checkForKeyPress()
-
-  uint8_t _inputPinsMask;         // high bits in this represent input pins on the MCP (which are used for rows on the keypad)
+  int _lastKeyPressed;            // key found by the last scan (index of the key in _keyMap)
+
+  uint16_t _repeatDelay;          // milliseconds a key is held before it repeats (0 = no repeat)
+  uint16_t _repeatRate;           // milliseconds between repeats
+  uint16_t _longPressTime;        // milliseconds a key is held before a long press is saved (0 = no long press)
+  const char *_repeatKeys;        // ASCII values of the keys that repeat (0 = all of them)
+  const char *_longPressKeys;     // ASCII values of the keys that have long presses (0 = all of them)
+  int _heldKey;                   // key that was saved and is still held down (or NO_KEYS_PRESSED)
+  unsigned long _holdStartTime;   // time of the scan that saved the held key
+  unsigned long _nextRepeat;      // milliseconds after _holdStartTime that the next repeat is due
+  bool _longPressSaved;           // true once the long press of the held key has been saved
+
+  uint8_t _scanStep;              // next step of the scan in progress (SCAN_STEP_IDLE if there is no scan in progress)
+  uint8_t _scanBudget;            // max number of scan steps in one scanKeys() call (0 = no limit)
+  uint8_t _scanColumn;            // column being read by the scan in progress
+  uint16_t _scanRows;             // KEYPAD_SCAN_LINE_REVERSAL: rows that were low in the quick check
+  int _scanResult;                // key found so far by the scan in progress (or NO_KEYS_PRESSED, MULTIPLE_KEYS_PRESSED)
+  unsigned long _columnTime;      // time (micros) the current column was driven low (or the lines were reversed)
+  uint16_t _settleTime;           // microseconds from driving a column low until the rows are read
+  uint16_t _columnWait;           // microseconds to wait before starting the read of the rows (the read itself covers the rest of _settleTime)
+  uint32_t _i2cClock;             // i2c clock given to begin() (Hz), or 0 if it is not known
+
+  uint16_t _mcpRegisters[MCP_OLAT + 1];  // copy of the values last written to the MCP registers, so we don't have to read them back
+                                  //    (a PCF chip has no registers: its port is kept in _mcpRegisters[MCP_IODIR], since it works the same way)
+  uint16_t _mcpRegistersValid;    // bit n is set if _mcpRegisters[n] matches the value in the MCP register n
+
+  uint16_t _inputPinsMask;        // high bits in this represent input pins on the chip (which are used for rows on the keypad)
+
+  uint8_t _errorState;            // KEYPAD_ERROR_NONE, or the i2c error that stopped the last scan
+  uint8_t _retries;               // times a failed i2c transaction is tried again
+  uint16_t _retryTime;            // max microseconds spent retrying one i2c transaction
+  uint8_t _sdaPin;                // microcontroller SDA pin used to free a stuck bus (or KEYPAD_NO_PIN)
+  uint8_t _sclPin;                // microcontroller SCL pin used to free a stuck bus
+  uint16_t _chipCheckInterval;    // milliseconds between checks that the chip was not reset (0 = never)
+  unsigned long _lastChipCheckTime;  // time of the last check that the chip was not reset
+
+  bool _interruptMode;            // true if we only scan the keypad after the chip signals a change on the INT pin
+  uint8_t _interruptPin;          // microcontroller pin connected to the chip's INT pin (or KEYPAD_NO_INTERRUPT_PIN)
+  volatile bool _interruptPending;  // set by interruptReceived() when the INT pin goes low
+
+  bool _isrProducer;              // true if scanKeys() is called from a timer, so the functions that read keys must not call it
+  I2cKeypadWaitHook _waitHook;    // function called by getKeyUntil() between scans (0 if setWaitHook() was not called)
+
+  bool _inputActive;              // true while an entry for getKeysUntil(), getIntUntil(), etc. is in progress
+  uint8_t _inputLength;           // keys (or digits) entered so far
+  int8_t _inputDecimals;          // digits entered after the decimal point (-1 if the decimal point has not been entered)
+  bool _inputNegative;            // true if the minus key was pressed
+  long _inputValue;               // digits entered so far, as a whole number (without the decimal point)
+  unsigned long _inputStartTime;  // time of the first call for the entry in progress
+
+#if KEYPAD_TRACE
+  I2cKeypadTrace *_trace;         // trace that samples are saved in (0 if setTrace() was not called)
+  uint16_t _traceReadPosition;    // next byte of the trace to be read by readTrace() (0 = not being read)
+#endif
 
+#if KEYPAD_STATISTICS
+  KeypadStatistics _statistics;   // counters returned by getStatistics()
+  unsigned long _scanTime;        // microseconds spent so far in the scan in progress
+#endif
 
 };
+
+#endif
@@ -0,0 +1,267 @@
+/*
+  I2cKeypadCodeMatcher.cpp
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadCodeMatcher watches the keys pressed on a keypad for any of a list of codes.
+    See I2cKeypadCodeMatcher.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "I2cKeypadCodeMatcher.h"
+
+
+// class constructor
+I2cKeypadCodeMatcher::I2cKeypadCodeMatcher(KeypadCodeNode *nodes, uint8_t *table, uint8_t capacity, uint8_t keys)
+{
+  _nodes = nodes;
+  _table = table;
+  _capacity = capacity;
+  _keys = keys;
+  _terminatorKey = 0;
+  _keyTimeout = 0;
+  _lastKeyTime = 0;
+  clearCodes();
+}
+
+
+// public functions
+
+// build the automaton from a list of codes. The nodes are added one depth at a time (all the first keys, then all the
+// second keys, ...), so they are numbered in breadth first order. Each node's fail link can then be worked out from
+// its parent's, which always comes first, and the keys that don't lead to a child are sent where the fail link's
+// keys lead (so feed() never has to follow the fail links itself).
+// parameters
+//    codes - list of codes in flash (PROGMEM), each one ending with \0, and an empty code at the end of the list
+//            (for example "1234\0" "0000\0"). If the same code is in the list twice, the first one is found.
+// returns
+//    false if the codes need more nodes or different keys than the matcher has, a code has a key that is not
+//    an ASCII character (see KEYPAD_CODE_FIRST_KEY), or there are more than 255 codes (no codes are found then)
+bool I2cKeypadCodeMatcher::begin(const char *codes)
+{
+  bool longer = true;                 // set if any code has a key at the depth being added
+  uint16_t length;                    // number of keys in the code
+
+  clearCodes();
+  // give each different key a column of the table
+  for (const char *code = codes; pgm_read_byte(code); code += length + 1)
+  {
+    for (length = 0; pgm_read_byte(code + length); ++length)
+    {
+      uint8_t key = pgm_read_byte(code + length) - KEYPAD_CODE_FIRST_KEY;
+      if (key >= KEYPAD_CODE_KEY_RANGE || (!_keyColumns[key] && _keyCount >= _keys))
+      {
+        clearCodes();
+        return false;
+      }
+      if (!_keyColumns[key])
+        _keyColumns[key] = ++_keyCount;
+    }
+  }
+
+  for (uint16_t depth = 0; longer; ++depth)
+  {
+    longer = false;
+    uint16_t number = 0;              // number of the code (from 1)
+    for (const char *code = codes; pgm_read_byte(code); code += length + 1)
+    {
+      for (length = 0; pgm_read_byte(code + length); ++length)
+        ;
+      if (++number > 255)
+      {
+        clearCodes();
+        return false;
+      }
+      if (length <= depth)
+        continue;
+      // the start of this code (depth keys) was added by the last pass, so find its node and add the next key
+      //    (until the links are worked out below, the table only has the children)
+      uint8_t node = 0;
+      for (uint16_t i = 0; i < depth; ++i)
+        node = _table[node * _keys + keyColumn(pgm_read_byte(code + i)) - 1];
+      uint8_t &child = _table[node * _keys + keyColumn(pgm_read_byte(code + depth)) - 1];
+      if (!child)
+      {
+        if (_nodeCount >= _capacity)
+        {
+          clearCodes();
+          return false;
+        }
+        child = _nodeCount++;
+        clearNode(child, depth + 1);
+      }
+      if (length == depth + 1 && _nodes[child].ownCode == KEYPAD_NO_CODE)
+        _nodes[child].ownCode = number;
+      longer = true;
+    }
+    _codeCount = number;
+  }
+
+  // work out the fail links in breadth first order, and fill in the rest of each node's table entries. A node that
+  // does not finish a code itself still finishes the longest code that ends at its fail link (for example "91" in
+  // "*91" when the codes are "*912" and "91"). The root is never a child, so 0 in a node's entry is a key that has no
+  // child, until the node has been filled in.
+  for (uint8_t node = 0; node < _nodeCount; ++node)
+  {
+    uint8_t *next = &_table[node * _keys];
+    uint8_t *failNext = &_table[_nodes[node].fail * _keys];
+    for (uint8_t column = 0; column < _keyCount; ++column)
+    {
+      uint8_t child = next[column];
+      if (!child)
+        next[column] = node ? failNext[column] : 0;
+      else
+      {
+        uint8_t fail = node ? failNext[column] : 0;
+        _nodes[child].fail = fail;
+        _nodes[child].code = _nodes[child].ownCode != KEYPAD_NO_CODE ? _nodes[child].ownCode : _nodes[fail].code;
+      }
+    }
+  }
+  return true;
+}
+
+// add a key that was pressed, and check if it finished a code. The keys before it are remembered (by the node they
+// lead to), so a code is found no matter how many keys were pressed before it (unless setTerminatorKey() was called).
+// parameters
+//    key - the ASCII value of the key (from the keyMap array)
+// returns
+//    the number of the longest code that the key finished (1 is the first code in the list)
+//    KEYPAD_NO_CODE if the key did not finish a code
+uint8_t I2cKeypadCodeMatcher::feed(uint8_t key)
+{
+  unsigned long now = millis();
+  if (_keyTimeout && (now - _lastKeyTime) >= _keyTimeout)
+    reset();                          // too long since the last key, so start over
+  _lastKeyTime = now;
+  if (_terminatorKey)
+  {
+    if (key == _terminatorKey)
+    {
+      // the keys since the last terminator key lead to a node only if every one of them moved one node deeper
+      uint8_t code = _nodes[_node].depth == _entryLength ? _nodes[_node].ownCode : KEYPAD_NO_CODE;
+      reset();
+      return code;
+    }
+    if (_entryLength < 255)
+      ++_entryLength;
+  }
+  uint8_t column = keyColumn(key);
+  _node = column ? _table[_node * _keys + column - 1] : 0;
+  return _terminatorKey ? KEYPAD_NO_CODE : _nodes[_node].code;
+}
+
+// forget the keys fed so far, so a code has to be entered from its first key
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypadCodeMatcher::reset(void)
+{
+  _node = 0;
+  _entryLength = 0;
+}
+
+// forget the keys fed so far when too much time goes by between two keys, so a code has to be entered
+// without stopping (keys left from someone else's try don't count)
+// parameters
+//    keyTimeout - milliseconds allowed between keys (0 = no limit, the default)
+// returns
+//    nothing
+void I2cKeypadCodeMatcher::setKeyTimeout(uint16_t keyTimeout)
+{
+  _keyTimeout = keyTimeout;
+}
+
+// only find a code when it is entered by itself and then the terminator key is pressed: the keys since the last
+// terminator key (or reset(), or the key timeout) must be exactly the code. So with '#' as the terminator key,
+// "1234#" finds the code "1234", but "99991234#" does not. feed() returns the code for the terminator key, and
+// KEYPAD_NO_CODE for the other keys. The terminator key should not be in any of the codes.
+// parameters
+//    terminatorKey - the key that finishes a code (0 = find codes wherever they end in the keys, the default)
+// returns
+//    nothing
+void I2cKeypadCodeMatcher::setTerminatorKey(uint8_t terminatorKey)
+{
+  _terminatorKey = terminatorKey;
+  reset();
+}
+
+// return the number of codes in the list given to begin()
+// parameters
+//    none
+// returns
+//    number of codes (0 if begin() has not been called, or it failed)
+uint8_t I2cKeypadCodeMatcher::getCodeCount(void)
+{
+  return _codeCount;
+}
+
+// return the number of nodes used by the codes (to see how big the matcher has to be)
+// parameters
+//    none
+// returns
+//    number of nodes, including the root
+uint8_t I2cKeypadCodeMatcher::getNodeCount(void)
+{
+  return _nodeCount;
+}
+
+// return the number of different keys used by the codes (to see how many keys the matcher needs)
+// parameters
+//    none
+// returns
+//    number of different keys
+uint8_t I2cKeypadCodeMatcher::getKeyCount(void)
+{
+  return _keyCount;
+}
+
+
+// private functions
+
+// find the column of the table for a key
+// parameters
+//    key - the key
+// returns
+//    the column + 1 (0 if the key is not in any of the codes, so it always leads back to the root)
+uint8_t I2cKeypadCodeMatcher::keyColumn(uint8_t key)
+{
+  key -= KEYPAD_CODE_FIRST_KEY;
+  return key < KEYPAD_CODE_KEY_RANGE ? _keyColumns[key] : 0;
+}
+
+// set up a node with no children, a fail link to the root, and no code
+// parameters
+//    node - the node
+//    depth - number of keys from the root to the node
+// returns
+//    nothing
+void I2cKeypadCodeMatcher::clearNode(uint8_t node, uint8_t depth)
+{
+  memset(&_table[node * _keys], 0, _keys);
+  _nodes[node].code = KEYPAD_NO_CODE;
+  _nodes[node].ownCode = KEYPAD_NO_CODE;
+  _nodes[node].depth = depth;
+  _nodes[node].fail = 0;
+}
+
+// remove all the codes, leaving only the root (no key finishes a code)
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypadCodeMatcher::clearCodes(void)
+{
+  _nodeCount = 1;
+  _codeCount = 0;
+  _keyCount = 0;
+  memset(_keyColumns, 0, sizeof(_keyColumns));
+  clearNode(0, 0);
+  reset();
+}
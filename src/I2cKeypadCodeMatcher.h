@@ -0,0 +1,125 @@
+/*
+  I2cKeypadCodeMatcher.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadCodeMatcher watches the keys pressed on a keypad for any of a list of codes
+    (PINs, command codes, etc.), so the sketch does not have to collect the keys and compare strings.
+
+    The codes are kept in flash (PROGMEM). Each code ends with \0, and an empty code ends the list:
+
+      const char doorCodes[] PROGMEM = "1234\0" "0000\0" "*911#\0";
+
+    begin() builds an Aho-Corasick automaton of the codes in RAM: one node for each different start
+    of a code, and a table with the node each key leads to from each node. The table already takes in
+    the links from a node to the node for the longest end of its keys that is also the start of a code,
+    so each key is a single lookup in the table, no matter how many codes there are or how long they are.
+
+    By default a code is found wherever it ends in the stream of keys, even if other keys were pressed
+    before it (so "99991234" finds the code "1234"). With setTerminatorKey() a code is only found when it
+    is all of the keys pressed since the last terminator key (or reset(), or the key timeout), followed
+    by the terminator key, like a PIN that is entered with '#'.
+
+    Give the matcher to a keypad with I2cKeypad::setCodeMatcher(), and scanKeys() feeds it each key
+    that is pressed. When a key finishes a code, a KEY_EVENT_CODE event is saved right after the key's
+    own event (see I2cKeypad::getEvent()).
+
+    Use I2cKeypadCodeMatcherBuffer<nodes, keys> to create a matcher along with its nodes and table.
+    A list of codes needs at most one node for each key in all of the codes, plus one, and keys is the
+    number of different keys used in the codes (KEYPAD_CODE_KEYS if it is left out). The matcher takes
+    nodes * (keys + 4) bytes of RAM, plus KEYPAD_CODE_KEY_RANGE bytes to find each key's column in the
+    table, so give it no more keys than the codes use (10 for codes of only digits).
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_CODE_MATCHER_H
+#define I2C_KEYPAD_CODE_MATCHER_H
+
+#include "I2cKeypad.h"
+
+// value returned by feed() when the key did not finish a code (codes are numbered from 1, in the order they are in the list)
+#define KEYPAD_NO_CODE 0
+
+#define KEYPAD_CODE_KEYS 16            // number of different keys a I2cKeypadCodeMatcherBuffer allows in its codes, unless it is given one
+#define KEYPAD_CODE_FIRST_KEY 0x20     // keys in the codes must be from KEYPAD_CODE_FIRST_KEY (space)
+#define KEYPAD_CODE_KEY_RANGE 96       //    to KEYPAD_CODE_FIRST_KEY + KEYPAD_CODE_KEY_RANGE - 1 (DEL), which covers the ASCII keys
+
+
+// one node of the code automaton (the root is node 0, the node for no keys)
+struct KeypadCodeNode {
+  uint8_t code;                   // number of the longest code that ends with this node's keys (KEYPAD_NO_CODE if none)
+  uint8_t ownCode;                // number of the code that is exactly this node's keys (KEYPAD_NO_CODE if none)
+  uint8_t depth;                  // number of keys from the root to this node
+  uint8_t fail;                   // node for the longest end of this node's keys that is also the start of a code (used by begin())
+};
+
+
+class I2cKeypadCodeMatcher {          // class definition
+public:
+
+  // constructor function and public functions
+
+  I2cKeypadCodeMatcher(KeypadCodeNode *nodes, uint8_t *table, uint8_t capacity, uint8_t keys);  // creates a matcher that uses the nodes array
+                                      //    (capacity is the number of elements, 1-255) and the table array (capacity * keys elements)
+
+  bool begin(const char *codes);      // build the automaton from a list of codes in flash (PROGMEM). Returns false if the codes don't fit.
+
+  uint8_t feed(uint8_t key);          // add a key pressed. Returns the number of the code it finished (1 is the first code), or KEYPAD_NO_CODE.
+  void reset(void);                   // forget the keys fed so far (for example when the door opens)
+  void setKeyTimeout(uint16_t keyTimeout);  // forget the keys fed so far if there are more than keyTimeout ms between two keys (0 = never, the default)
+  void setTerminatorKey(uint8_t terminatorKey);  // only find a code that is all of the keys since the last terminatorKey, when terminatorKey
+                                      //    is pressed (0 = find codes wherever they end, the default)
+
+  uint8_t getCodeCount(void);         // returns the number of codes in the list given to begin()
+  uint8_t getNodeCount(void);         // returns the number of nodes the codes use
+  uint8_t getKeyCount(void);          // returns the number of different keys the codes use
+
+
+private:
+  // private functions used by this library
+
+  uint8_t keyColumn(uint8_t key);                 // column of the table for key (0 if key is not in any code)
+  void clearNode(uint8_t node, uint8_t depth);    // set up a node with no children, links or code
+  void clearCodes(void);                          // remove all the codes (only the root is left)
+
+
+  // private variables
+
+  KeypadCodeNode *_nodes;         // array of nodes (node 0 is the root)
+  uint8_t *_table;                // node reached from each node with each key: _keys elements for each node, one for each column
+  uint8_t _capacity;              // number of elements in _nodes
+  uint8_t _keys;                  // number of columns in _table
+  uint8_t _keyColumns[KEYPAD_CODE_KEY_RANGE];  // column + 1 for each key, from KEYPAD_CODE_FIRST_KEY (0 = the key is not in any code)
+  uint8_t _keyCount;              // different keys used by the codes (columns of _table in use)
+  uint8_t _nodeCount;             // nodes used by the codes
+  uint8_t _codeCount;             // number of codes in the list
+  uint8_t _node;                  // node for the keys fed so far
+  uint8_t _entryLength;           // keys fed since the last terminator key or reset() (stops at 255)
+  uint8_t _terminatorKey;         // key that finishes a code (0 = codes are found wherever they end)
+  uint16_t _keyTimeout;           // ms between keys before the keys fed so far are forgotten (0 = never)
+  unsigned long _lastKeyTime;     // time the last key was fed
+};
+
+
+// code matcher along with its nodes and table, the number of nodes (and different keys) is set when it is declared, for example
+//     I2cKeypadCodeMatcherBuffer<32> doorMatcher;        (up to KEYPAD_CODE_KEYS different keys)
+//     I2cKeypadCodeMatcherBuffer<32, 10> pinMatcher;     (codes of only digits)
+template <uint8_t Nodes, uint8_t Keys = KEYPAD_CODE_KEYS>
+class I2cKeypadCodeMatcherBuffer : public I2cKeypadCodeMatcher {
+  static_assert(Nodes > 0, "the code matcher needs at least one node");
+  static_assert(Keys > 0 && Keys <= KEYPAD_CODE_KEY_RANGE, "the code matcher needs 1 to KEYPAD_CODE_KEY_RANGE keys");
+
+public:
+  I2cKeypadCodeMatcherBuffer() : I2cKeypadCodeMatcher(_nodeStorage, _tableStorage, Nodes, Keys) {}
+
+private:
+  KeypadCodeNode _nodeStorage[Nodes];
+  uint8_t _tableStorage[Nodes * Keys];
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+  I2cKeypadI2cDev.cpp
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    The i2c bus used by the I2cKeypad library on Linux boards (/dev/i2c-N).
+    See I2cKeypadI2cDev.h for details. This file is empty unless KEYPAD_LINUX_I2CDEV is defined.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifdef KEYPAD_LINUX_I2CDEV
+
+#include "I2cKeypad.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+I2cKeypadI2cDev KeypadI2cDev;
+
+
+// class constructor
+I2cKeypadI2cDev::I2cKeypadI2cDev()
+{
+  _fd = -1;
+  _device = KEYPAD_I2CDEV_DEVICE;
+}
+
+
+// public functions
+
+// open the i2c bus (any bus that was open is closed first)
+// parameters
+//    device - path of the i2c bus, like "/dev/i2c-1"
+// returns
+//    false if the bus can't be opened, or the adapter can't do plain i2c transfers (only SMBus)
+bool I2cKeypadI2cDev::begin(const char *device)
+{
+  unsigned long functions;
+
+  end();
+  _device = device;
+  _fd = open(device, O_RDWR | O_CLOEXEC);
+  if (_fd < 0)
+    return false;
+  if (ioctl(_fd, I2C_FUNCS, &functions) < 0 || !(functions & I2C_FUNC_I2C))
+  {
+    end();
+    return false;
+  }
+  return true;
+}
+
+// close the i2c bus (the next transfer opens it again)
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypadI2cDev::end(void)
+{
+  if (_fd >= 0)
+    close(_fd);
+  _fd = -1;
+}
+
+// do an i2c transfer in one ioctl(I2C_RDWR) system call. The kernel joins the messages with repeated starts,
+// so the bus is not released until the read is done.
+// parameters
+//    address - i2c address of the chip
+//    writeData - bytes to write first (for a MCP chip, the first byte is the register address)
+//    writeCount - number of bytes to write (0 = no write)
+//    reg - register address to send before the read, or -1 to just read (a PCF chip)
+//    data - array where the bytes read are saved
+//    count - number of bytes to read (0 = no read)
+// returns
+//    KEYPAD_ERROR_NONE if the transfer worked
+//    KEYPAD_ERROR_NACK if it failed (the chip did not acknowledge, or the bus could not be opened). The i2c-dev interface
+//       reads all of the bytes or fails, so there are no short reads.
+uint8_t I2cKeypadI2cDev::transfer(uint8_t address, const uint8_t *writeData, uint8_t writeCount, int16_t reg, uint8_t *data, uint8_t count)
+{
+  struct i2c_msg messages[KEYPAD_I2CDEV_MESSAGES];
+  struct i2c_rdwr_ioctl_data request;
+  uint8_t regByte = (uint8_t)reg;
+  uint8_t messageCount = 0;
+
+  if (_fd < 0 && !begin(_device))
+    return KEYPAD_ERROR_NACK;
+  if (writeCount)
+  {
+    messages[messageCount].addr = address;
+    messages[messageCount].flags = 0;
+    messages[messageCount].len = writeCount;
+    messages[messageCount].buf = (uint8_t *)writeData;     // the kernel only reads from a write message's buffer
+    ++messageCount;
+  }
+  if (reg >= 0)
+  {
+    messages[messageCount].addr = address;
+    messages[messageCount].flags = 0;
+    messages[messageCount].len = 1;
+    messages[messageCount].buf = &regByte;
+    ++messageCount;
+  }
+  if (count)
+  {
+    messages[messageCount].addr = address;
+    messages[messageCount].flags = I2C_M_RD;
+    messages[messageCount].len = count;
+    messages[messageCount].buf = data;
+    ++messageCount;
+  }
+  request.msgs = messages;
+  request.nmsgs = messageCount;
+  if (ioctl(_fd, I2C_RDWR, &request) != messageCount)
+    return KEYPAD_ERROR_NACK;
+  return KEYPAD_ERROR_NONE;
+}
+
+#endif
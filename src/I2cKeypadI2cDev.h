@@ -0,0 +1,69 @@
+/*
+  I2cKeypadI2cDev.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    The i2c bus used by the I2cKeypad library on Linux boards, in place of the Arduino Wire library
+    (when KEYPAD_LINUX_I2CDEV is defined). It uses the kernel's i2c-dev interface (/dev/i2c-N, the
+    i2c-dev module must be loaded).
+
+    Each transfer is one ioctl(I2C_RDWR) system call, with up to 3 messages joined by repeated starts:
+    the bytes to write, the register address, and the read. Reading a register is one system call
+    instead of a write() and a read(), and a scan step that makes a column an output and reads the rows
+    is one system call too (see KEYPAD_COMBINED_TRANSFERS).
+    The i2c adapter must be able to do plain i2c transfers (I2C_FUNC_I2C). Most can, but SMBus only
+    adapters (and the i2c-stub test module) can't.
+
+    All of the keypads use the bus opened by KeypadI2cDev.begin(), the same way they all use Wire on an
+    Arduino. If it is not called, the first transfer opens KEYPAD_I2CDEV_DEVICE.
+
+    Linux sets the i2c clock (in the device tree), so I2cKeypad::begin() can't change it. Give begin()
+    the clock the bus runs at if it is not KEYPAD_I2C_CLOCK, so the settle time is worked out right.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_I2CDEV_H
+#define I2C_KEYPAD_I2CDEV_H
+
+#include <stdint.h>
+
+#define KEYPAD_I2CDEV_DEVICE "/dev/i2c-1"   // bus opened if KeypadI2cDev.begin() is not called (the i2c pins of a Raspberry Pi)
+#define KEYPAD_I2CDEV_MESSAGES 3            // max messages in one transfer (write, register address, read)
+#ifndef KEYPAD_I2C_CLOCK
+#define KEYPAD_I2C_CLOCK 100000             // i2c clock the library assumes (Hz), the usual Linux default
+#endif
+#ifndef KEYPAD_COMBINED_TRANSFERS
+#define KEYPAD_COMBINED_TRANSFERS 1         // each transfer is a system call, so write and read in one transfer when the scan can
+#endif
+
+
+class I2cKeypadI2cDev {               // class definition
+public:
+
+  // constructor function and public functions
+
+  I2cKeypadI2cDev();                  // creates the bus object (the bus is not opened yet)
+
+  bool begin(const char *device = KEYPAD_I2CDEV_DEVICE);  // open the i2c bus (like "/dev/i2c-1"). Returns false if it can't be opened, or can't do i2c transfers.
+  void end(void);                     // close the i2c bus
+
+  uint8_t transfer(uint8_t address, const uint8_t *writeData, uint8_t writeCount, int16_t reg, uint8_t *data, uint8_t count);
+                                      // write writeData, then send reg (if not -1), then read count bytes, in one system call.
+                                      //    Returns KEYPAD_ERROR_NONE, or KEYPAD_ERROR_NACK if the transfer failed.
+
+
+private:
+  // private variables
+
+  int _fd;                            // file descriptor of the i2c bus (-1 if it is not open)
+  const char *_device;                // path of the i2c bus
+};
+
+extern I2cKeypadI2cDev KeypadI2cDev;  // the i2c bus used by all of the keypads
+
+#endif
@@ -0,0 +1,85 @@
+/*
+  I2cKeypadLinux.cpp
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    The parts of the Arduino core that the I2cKeypad library uses, for Linux boards.
+    See I2cKeypadLinux.h for details. This file is empty unless KEYPAD_LINUX_I2CDEV is defined.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifdef KEYPAD_LINUX_I2CDEV
+
+#include "I2cKeypad.h"
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+
+// return the monotonic clock in microseconds
+static uint64_t clockMicros(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+static uint64_t startMicros = clockMicros();   // time the program started
+
+
+unsigned long millis(void)
+{
+  return (unsigned long)((clockMicros() - startMicros) / 1000);
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)(clockMicros() - startMicros);
+}
+
+void delay(unsigned long ms)
+{
+  struct timespec wait;
+  wait.tv_sec = ms / 1000;
+  wait.tv_nsec = (ms % 1000) * 1000000L;
+  while (nanosleep(&wait, &wait) && errno == EINTR)
+    ;                                          // a signal woke us up early, so sleep for the rest of the time
+}
+
+// the settle waits are only a few microseconds, which is much shorter than the time it takes to wake up from a sleep
+void delayMicroseconds(unsigned int us)
+{
+  uint64_t end = clockMicros() + us;
+  while (clockMicros() < end)
+    ;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  (void)pin;
+  (void)mode;
+}
+
+int digitalRead(uint8_t pin)
+{
+  (void)pin;
+  return HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+  (void)pin;
+  (void)value;
+}
+
+void yield(void)
+{
+  sched_yield();
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  I2cKeypadLinux.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    The parts of the Arduino core that the I2cKeypad library uses, for Linux boards (Raspberry Pi,
+    BeagleBone, and other single board computers). This is used instead of Arduino.h when
+    KEYPAD_LINUX_I2CDEV is defined, and the keypad is reached through /dev/i2c-N (see I2cKeypadI2cDev.h).
+
+    millis() and micros() count from when the program started, using the monotonic clock.
+    delayMicroseconds() waits by reading the clock, since sleeping for a few microseconds takes
+    much longer than that on Linux.
+
+    There are no microcontroller pins: digitalRead() always returns HIGH. So call enableInterrupts()
+    without a pin, and call interruptReceived() when the chip's INT pin goes low (for example from a
+    gpio event). setBusRecoveryPins() is not needed, since the kernel's i2c driver frees a stuck bus itself.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_LINUX_H
+#define I2C_KEYPAD_LINUX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef INPUT
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#endif
+
+// there is no separate flash memory on Linux
+#ifndef PROGMEM
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#endif
+
+#ifndef constrain
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#endif
+
+unsigned long millis(void);                     // milliseconds since the program started
+unsigned long micros(void);                     // microseconds since the program started
+void delay(unsigned long ms);                   // sleep for ms milliseconds
+void delayMicroseconds(unsigned int us);        // wait for us microseconds (without sleeping)
+void pinMode(uint8_t pin, uint8_t mode);        // does nothing (there are no microcontroller pins)
+int digitalRead(uint8_t pin);                   // returns HIGH (there are no microcontroller pins)
+void digitalWrite(uint8_t pin, uint8_t value);  // does nothing (there are no microcontroller pins)
+void yield(void);                               // let other programs run
+
+#endif
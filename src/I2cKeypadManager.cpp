@@ -0,0 +1,225 @@
+
+/*
+  I2cKeypadManager.cpp
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadManager scans several I2cKeypad objects that share one I2C bus.
+    See I2cKeypadManager.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "I2cKeypadManager.h"
+
+
+// class constructor
+I2cKeypadManager::I2cKeypadManager(uint16_t scanPeriod, uint16_t busBudget)
+{
+  _scanPeriod = scanPeriod;
+  _busBudget = busBudget;
+  _keypadNum = 0;
+  _nextKeypad = 0;
+}
+
+
+// public functions
+
+// add a keypad to the manager. Keypads are numbered in the order they are added (this number is returned as the source of each key).
+// parameters
+//    keypad - the keypad object
+// returns
+//    the index of the keypad (0-7)
+//    KEYPAD_MANAGER_FULL if KEYPAD_MANAGER_MAX_KEYPADS keypads have already been added
+uint8_t I2cKeypadManager::addKeypad(I2cKeypad &keypad)
+{
+  if (_keypadNum >= KEYPAD_MANAGER_MAX_KEYPADS)
+    return KEYPAD_MANAGER_FULL;
+  _keypads[_keypadNum] = &keypad;
+  return _keypadNum++;
+}
+
+// initialize all of the keypads, and give each keypad its own time slot in the scan period - run this once in setup()
+// parameters
+//    i2cClock - i2c clock rate in Hz for the bus the keypads are on, or 0 to leave the clock as it is
+// returns
+//    nothing
+void I2cKeypadManager::begin(uint32_t i2cClock)
+{
+  unsigned long currentTime = millis();
+  for (uint8_t i = 0; i < _keypadNum; ++i)
+  {
+    _keypads[i]->begin(i2cClock);
+    _nextScanTime[i] = currentTime + (unsigned long)_scanPeriod * i / _keypadNum;   // spread the scans evenly over the scan period
+  }
+  _nextKeypad = 0;
+}
+
+// scan each keypad whose time slot has come, if its own schedule says a scan is due (see I2cKeypad::setScanRates()).
+// A keypad that has nothing to do (for example one in interrupt mode with no keys down) keeps its slot, and is scanned
+// as soon as it has. Keys that are found are added to that keypad's buffer.
+// Call this often in loop() (at least as often as scanPeriod / number of keypads).
+// If a bus time budget was given, this stops scanning when the budget is used up (at least one keypad is always scanned),
+// and the keypads that are left over are scanned first on the next call.
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypadManager::update(void)
+{
+  unsigned long currentTime = millis();
+  unsigned long startMicros = micros();
+  bool scanned = false;     // set after the first keypad is scanned
+
+  for (uint8_t n = 0; n < _keypadNum; ++n)
+  {
+    uint8_t i = (_nextKeypad + n) % _keypadNum;
+    if ((long)(currentTime - _nextScanTime[i]) < 0)
+      continue;             // not this keypad's turn yet
+    if (scanned && _busBudget && (micros() - startMicros) >= _busBudget)
+    {
+      _nextKeypad = i;      // out of time... start with this keypad next time
+      return;
+    }
+    bool finished = _keypads[i]->scanKeys();
+    if (!finished && _keypads[i]->_scanStep == SCAN_STEP_IDLE)
+      continue;             // the keypad's own schedule has no scan due yet, so it keeps its slot
+    scanned = true;
+    if (!finished)
+      continue;             // the keypad has a scan budget (see I2cKeypad::setScanBudget())... it is still due, so the scan continues next time
+    _nextScanTime[i] += _scanPeriod;
+    // if we fell more than one period behind (update() wasn't called often enough), don't try to catch up with a burst of scans
+    if ((long)(currentTime - _nextScanTime[i]) >= 0)
+      _nextScanTime[i] = currentTime + _scanPeriod;
+  }
+  _nextKeypad = 0;
+}
+
+// return the time until update() will scan one of the keypads again. Calling update() before then does nothing,
+// so the program can sleep (or do other work) until then without finding keys any later.
+// A keypad is due once its time slot has come and its own timeUntilNextScan() is 0, so a keypad in interrupt mode
+// with no keys down doesn't keep the program awake.
+// parameters
+//    none
+// returns
+//    milliseconds until the next keypad's scan, 0 if one is due
+//    KEYPAD_NO_SCAN_SCHEDULED if every keypad is in interrupt mode and waiting for its INT pin
+uint16_t I2cKeypadManager::timeUntilNextScan(void)
+{
+  unsigned long currentTime = millis();
+  uint16_t waitTime = KEYPAD_NO_SCAN_SCHEDULED;
+
+  for (uint8_t i = 0; i < _keypadNum; ++i)
+  {
+    uint16_t keypadWait = _keypads[i]->timeUntilNextScan();
+    long timeLeft = (long)(_nextScanTime[i] - currentTime);
+    if (keypadWait != KEYPAD_NO_SCAN_SCHEDULED && timeLeft > (long)keypadWait)
+      keypadWait = timeLeft < KEYPAD_NO_SCAN_SCHEDULED ? timeLeft : KEYPAD_NO_SCAN_SCHEDULED - 1;
+    if (keypadWait < waitTime)
+      waitTime = keypadWait;
+  }
+  return waitTime;
+}
+
+// return the number of keys waiting in all of the keypads (does not scan the keypads)
+// parameters
+//    none
+// returns
+//    the total number of keys in all of the keypad buffers
+uint8_t I2cKeypadManager::getKeyCount(void)
+{
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < _keypadNum; ++i)
+    count += _keypads[i]->keyBufferCount();
+  return count;
+}
+
+// peek at the oldest key from all of the keypads, without removing anything
+// parameters
+//    source - if not 0, this is set to the index of the keypad the key came from
+// returns
+//    RETURN_NO_KEY_IN_BUFFER if there are no keys
+//    the ASCII value of the next key (from that keypad's keyMap array)
+uint8_t I2cKeypadManager::peekKey(uint8_t *source)
+{
+  uint8_t i = nextSource();
+  if (i == KEYPAD_MANAGER_FULL)
+    return RETURN_NO_KEY_IN_BUFFER;
+  if (source)
+    *source = i;
+  return _keypads[i]->readKeyBuffer(false);
+}
+
+// get the oldest key from all of the keypads, and remove it
+// parameters
+//    source - if not 0, this is set to the index of the keypad the key came from
+// returns
+//    RETURN_NO_KEY_IN_BUFFER if there are no keys
+//    the ASCII value of the next key (from that keypad's keyMap array)
+uint8_t I2cKeypadManager::getKey(uint8_t *source)
+{
+  uint8_t i = nextSource();
+  if (i == KEYPAD_MANAGER_FULL)
+    return RETURN_NO_KEY_IN_BUFFER;
+  if (source)
+    *source = i;
+  return _keypads[i]->readKeyBuffer(true);
+}
+
+// remove all keys from all of the keypads
+// parameters
+//    none
+// returns
+//    nothing
+void I2cKeypadManager::flushKeys(void)
+{
+  for (uint8_t i = 0; i < _keypadNum; ++i)
+    _keypads[i]->flushKeyBuffer();
+}
+
+// change the bus time budget
+// parameters
+//    busBudget - max number of microseconds that one update() call can spend scanning (0 = no limit)
+// returns
+//    nothing
+void I2cKeypadManager::setBusBudget(uint16_t busBudget)
+{
+  _busBudget = busBudget;
+}
+
+// return the number of keypads that were added
+uint8_t I2cKeypadManager::getKeypadCount(void)
+{
+  return _keypadNum;
+}
+
+
+// private functions ********************************
+
+// find the keypad that has the oldest key, by the time saved in each keypad's next key event
+// parameters
+//    none
+// returns
+//    the index of the keypad, or KEYPAD_MANAGER_FULL if no keypad has a key
+uint8_t I2cKeypadManager::nextSource(void)
+{
+  uint8_t source = KEYPAD_MANAGER_FULL;
+  unsigned long oldestTime = 0;
+  KeypadEvent event;
+
+  for (uint8_t i = 0; i < _keypadNum; ++i)
+  {
+    if (!_keypads[i]->nextKeyEvent(event))
+      continue;
+    if (source == KEYPAD_MANAGER_FULL || (long)(event.time - oldestTime) < 0)   // (micros() wraps around)
+    {
+      source = i;
+      oldestTime = event.time;
+    }
+  }
+  return source;
+}
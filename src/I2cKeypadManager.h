@@ -0,0 +1,76 @@
+
+/*
+  I2cKeypadManager.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadManager scans several I2cKeypad objects that share one I2C bus
+    (up to 8 MCP23008 chips, at addresses 0x20 - 0x27).
+
+    Each keypad gets its own time slot in the scan period, so the scans are spread
+    evenly instead of all happening at once. A keypad is scanned in its slot when its own
+    schedule (setScanRates(), interrupt mode) says it has a scan to do. An optional bus time budget
+    limits how long one call to update() can spend scanning; keypads that don't fit are scanned on the next call.
+
+    Keys from all of the keypads are returned in the order they were saved (by the time in each key event),
+    along with the index of the keypad they came from. The I2cKeypad functions (getKey(), etc.) still work
+    on each keypad by itself.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_MANAGER_H
+#define I2C_KEYPAD_MANAGER_H
+
+#include "I2cKeypad.h"
+
+#define KEYPAD_MANAGER_MAX_KEYPADS 8         // max number of keypads (MCP23008 chips have 8 possible i2c addresses)
+
+// value returned by addKeypad() if the manager is full
+#define KEYPAD_MANAGER_FULL 0xff
+
+
+class I2cKeypadManager {              // class definition
+public:
+
+  // constructor function and public functions
+
+  I2cKeypadManager(uint16_t scanPeriod, uint16_t busBudget = 0);  // creates a manager. Each keypad is scanned at most once every scanPeriod milliseconds (and only as often as its own scan rate).
+                                      //    busBudget is the max number of microseconds that one update() call can spend scanning (0 = no limit).
+
+  uint8_t addKeypad(I2cKeypad &keypad);   // add a keypad, returns it's index (0-7), or KEYPAD_MANAGER_FULL
+  void begin(uint32_t i2cClock = 0);  // runs begin() for every keypad and spreads out their scan times. Run this in setup()! (see I2cKeypad::begin() for i2cClock)
+
+  void update(void);                  // scans the keypads that are due. Run this often in loop().
+  uint16_t timeUntilNextScan(void);   // returns the milliseconds until update() will scan a keypad again (0 = now, KEYPAD_NO_SCAN_SCHEDULED = only an INT pin), so loop() can sleep until then
+
+  uint8_t getKeyCount(void);              // returns the number of keys waiting in all of the keypads (the keys that getKey() returns)
+  uint8_t peekKey(uint8_t *source = 0);   // returns the next key without removing it. source is set to the index of the keypad.
+  uint8_t getKey(uint8_t *source = 0);    // returns the next key and removes it. source is set to the index of the keypad.
+  void    flushKeys(void);                // removes all keys from all of the keypads
+
+  void setBusBudget(uint16_t busBudget);  // change the max number of microseconds that one update() call can spend scanning (0 = no limit)
+  uint8_t getKeypadCount(void);           // returns the number of keypads added
+
+
+private:
+  // private functions used by this library
+
+  uint8_t nextSource(void);               // index of the keypad with the oldest key press, or KEYPAD_MANAGER_FULL if there are no keys
+
+  // private variables
+
+  I2cKeypad *_keypads[KEYPAD_MANAGER_MAX_KEYPADS];         // the keypads being managed
+  unsigned long _nextScanTime[KEYPAD_MANAGER_MAX_KEYPADS]; // time (millis) of the next scan for each keypad
+  uint8_t _keypadNum;             // number of keypads added
+  uint8_t _nextKeypad;            // keypad to check first in update(), so one that missed the budget goes first next time
+  uint16_t _scanPeriod;           // each keypad is scanned once in this many milliseconds
+  uint16_t _busBudget;            // max microseconds of scanning in one update() call (0 = no limit)
+
+};
+
+#endif
@@ -0,0 +1,148 @@
+
+/*
+  I2cKeypadT.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadT is a version of I2cKeypad where the keypad size and the chip pins
+    are template parameters, so the pin masks and pin lookup tables are worked out when the
+    program is compiled. The tables and the key map are kept in flash (PROGMEM) instead of RAM,
+    and the scan loop only has to look up values in the tables. The keypad is given the tables
+    when it is created (there are no virtual functions), and every keypad with the same layout
+    shares them.
+
+    The template parameters are the number of rows, the number of columns, and then the chip
+    pin for each row followed by the chip pin for each column. For a 4x4 keypad with the rows on
+    pins 0-3 and the columns on pins 4-7:
+
+      const char keyMap[] PROGMEM = "123A456B789C0-.E";
+      I2cKeypadT<4, 4, 0, 1, 2, 3, 4, 5, 6, 7> keypad(keyMap, KEYPAD_DEBOUNCE_TIME, KEYPAD_ADDRESS);
+
+    With a 16 bit chip (MCP23017 or PCF8575) the pins can be 0-15. The tables are twice as big
+    (two bytes for each entry, and a table for each byte of the port) if any pin is 8 or higher.
+
+    Everything else works the same as I2cKeypad (I2cKeypadT is an I2cKeypad).
+    This needs a C++11 compiler (Arduino IDE 1.6.6 or higher).
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_T_H
+#define I2C_KEYPAD_T_H
+
+#include "I2cKeypad.h"
+
+
+// functions used to build the tables when the program is compiled
+
+// the pin that is at position n in the list of pins
+constexpr uint8_t i2cKeypadPinAt(uint8_t /* n */, uint8_t pin)
+{
+  return pin;
+}
+template <typename... Pins>
+constexpr uint8_t i2cKeypadPinAt(uint8_t n, uint8_t pin, Pins... pins)
+{
+  return n == 0 ? pin : i2cKeypadPinAt(n - 1, pins...);
+}
+
+// the highest pin number in the list of pins
+constexpr uint8_t i2cKeypadMaxPin(uint8_t pin)
+{
+  return pin;
+}
+template <typename... Pins>
+constexpr uint8_t i2cKeypadMaxPin(uint8_t pin, Pins... pins)
+{
+  return pin > i2cKeypadMaxPin(pins...) ? pin : i2cKeypadMaxPin(pins...);
+}
+
+// mask with a high bit for each of the count pins starting at position first in the list of pins
+template <typename... Pins>
+constexpr uint16_t i2cKeypadPinMask(uint8_t first, uint8_t count, Pins... pins)
+{
+  return count == 0 ? 0 : (uint16_t)((1U << i2cKeypadPinAt(first, pins...)) | i2cKeypadPinMask(first + 1, count - 1, pins...));
+}
+
+// word with bit n set if the pin at position first + n is low in port (for count pins)
+template <typename... Pins>
+constexpr uint16_t i2cKeypadLowPins(uint16_t port, uint8_t first, uint8_t count, Pins... pins)
+{
+  return count == 0 ? 0 : (uint16_t)((((port >> i2cKeypadPinAt(first + count - 1, pins...)) & 0x01) ? 0 : 1U << (count - 1)) |
+                                     i2cKeypadLowPins(port, first, count - 1, pins...));
+}
+
+// the port value for entry n of the tables: table n / 256 has the value n % 256 in its byte of the port,
+// and every other pin high (so pins in the other byte never look low)
+constexpr uint16_t i2cKeypadTablePort(uint16_t n)
+{
+  return (uint16_t)(((n & 0xff) << (n & 0x100 ? 8 : 0)) | (n & 0x100 ? 0x00ff : 0xff00));
+}
+
+// list of numbers 0, 1, 2 ... N-1, used to fill in the tables
+template <uint16_t... I> struct I2cKeypadIndexList {};
+template <uint16_t N, uint16_t... I> struct I2cKeypadMakeIndexList : I2cKeypadMakeIndexList<N - 1, N - 1, I...> {};
+template <uint16_t... I> struct I2cKeypadMakeIndexList<0, I...> { typedef I2cKeypadIndexList<I...> type; };
+
+// table entries are bytes, unless a pin is in the high byte of a 16 bit chip
+template <uint8_t Bytes> struct I2cKeypadWord { typedef uint8_t type; };
+template <> struct I2cKeypadWord<2> { typedef uint16_t type; };
+
+// tables in flash for one keypad layout (with a table for each byte of the port)
+template <uint8_t Rows, uint8_t Cols, uint8_t Bytes, class ColList, class PortList, uint8_t... Pins> struct I2cKeypadTables;
+template <uint8_t Rows, uint8_t Cols, uint8_t Bytes, uint16_t... C, uint16_t... P, uint8_t... Pins>
+struct I2cKeypadTables<Rows, Cols, Bytes, I2cKeypadIndexList<C...>, I2cKeypadIndexList<P...>, Pins...> {
+  typedef typename I2cKeypadWord<Bytes>::type Word;
+  static const Word columnDirection[Cols];      // IODIR value that makes only column c an output
+  static const Word rows[Bytes * 256];          // for each value of a port byte, bit r set for each row r that is low
+  static const Word cols[Bytes * 256];          // for each value of a port byte, bit c set for each column c that is low
+};
+template <uint8_t Rows, uint8_t Cols, uint8_t Bytes, uint16_t... C, uint16_t... P, uint8_t... Pins>
+const typename I2cKeypadWord<Bytes>::type
+I2cKeypadTables<Rows, Cols, Bytes, I2cKeypadIndexList<C...>, I2cKeypadIndexList<P...>, Pins...>::columnDirection[Cols] PROGMEM =
+  { (Word)~(1U << i2cKeypadPinAt(Rows + C, Pins...))... };
+template <uint8_t Rows, uint8_t Cols, uint8_t Bytes, uint16_t... C, uint16_t... P, uint8_t... Pins>
+const typename I2cKeypadWord<Bytes>::type
+I2cKeypadTables<Rows, Cols, Bytes, I2cKeypadIndexList<C...>, I2cKeypadIndexList<P...>, Pins...>::rows[Bytes * 256] PROGMEM =
+  { (Word)i2cKeypadLowPins(i2cKeypadTablePort(P), 0, Rows, Pins...)... };
+template <uint8_t Rows, uint8_t Cols, uint8_t Bytes, uint16_t... C, uint16_t... P, uint8_t... Pins>
+const typename I2cKeypadWord<Bytes>::type
+I2cKeypadTables<Rows, Cols, Bytes, I2cKeypadIndexList<C...>, I2cKeypadIndexList<P...>, Pins...>::cols[Bytes * 256] PROGMEM =
+  { (Word)i2cKeypadLowPins(i2cKeypadTablePort(P), Rows, Cols, Pins...)... };
+
+
+
+template <uint8_t Rows, uint8_t Cols, uint8_t... Pins>
+class I2cKeypadT : public I2cKeypad {  // class definition
+  static_assert(sizeof...(Pins) == Rows + Cols, "I2cKeypadT needs one chip pin for each row, and then one for each column");
+  static_assert(i2cKeypadMaxPin(Pins...) < 16, "the chips have at most 16 pins (0-15)");
+
+  static const uint8_t Bytes = i2cKeypadMaxPin(Pins...) < 8 ? 1 : 2;   // bytes of the port that have keypad pins
+  typedef I2cKeypadTables<Rows, Cols, Bytes, typename I2cKeypadMakeIndexList<Cols>::type,
+                          typename I2cKeypadMakeIndexList<Bytes * 256>::type, Pins...> Tables;
+
+public:
+
+  // creates a keypad object
+  //    keyMap is an array in flash (PROGMEM) with the ASCII character for each key, one row after another
+  I2cKeypadT(const char *keyMap, uint16_t debounceTime, uint8_t i2cAddress, uint8_t scanMode = KEYPAD_SCAN_COLUMNS,
+             uint8_t chipType = KEYPAD_MCP23008)
+    : I2cKeypad((char *)keyMap, 0, 0, Rows, Cols, debounceTime, i2cAddress, scanMode, chipType)
+  {
+    _pinTables = &_layoutTables;
+  }
+
+
+private:
+  static const I2cKeypadPinTables _layoutTables;  // where the tables for this layout are (one copy for all the keypads with this layout)
+};
+
+template <uint8_t Rows, uint8_t Cols, uint8_t... Pins>
+const I2cKeypadPinTables I2cKeypadT<Rows, Cols, Pins...>::_layoutTables =
+  { Tables::columnDirection, Tables::rows, Tables::cols, i2cKeypadPinMask(0, Rows, Pins...), Bytes };
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  I2cKeypadTrace.cpp
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadTrace keeps a record of the pins read by the keypad scan, in a ring buffer in RAM.
+    See I2cKeypadTrace.h for details.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#include "I2cKeypadTrace.h"
+
+
+// class constructor
+// parameters
+//    samples - array that the samples are stored in
+//    capacity - number of elements in the samples array (a power of 2 up to KEYPAD_TRACE_MAX_SAMPLES... otherwise only the largest power of 2 that fits is used)
+I2cKeypadTrace::I2cKeypadTrace(KeypadTraceSample *samples, uint16_t capacity)
+{
+  _samples = samples;
+  uint16_t size = KEYPAD_TRACE_MAX_SAMPLES;
+  while (size > capacity && size > 1)
+    size >>= 1;
+  _mask = size - 1;
+  _paused = false;
+  clear();
+}
+
+
+// public functions
+
+// remove all the samples (the time of the next sample counts from now)
+void I2cKeypadTrace::clear(void)
+{
+  _head = 0;
+  _count = 0;
+  _lastTime = micros();
+}
+
+// return the number of samples in the trace
+uint16_t I2cKeypadTrace::count(void)
+{
+  return _count;
+}
+
+// return the max number of samples the trace can hold
+uint16_t I2cKeypadTrace::capacity(void)
+{
+  return _mask + 1;
+}
+
+// return the time (micros) when the oldest sample in the trace was saved (the time of the last sample, less the
+// time between the samples after the oldest one)
+unsigned long I2cKeypadTrace::startTime(void)
+{
+  unsigned long time = _lastTime;
+  KeypadTraceSample sample;
+
+  for (uint16_t index = 1; getSample(index, sample); ++index)
+  {
+    time -= sample.time;
+    if (KEYPAD_TRACE_KIND(sample.what) == KEYPAD_TRACE_TIME)
+      time -= (unsigned long)sample.pins << 16;
+  }
+  return time;
+}
+
+// copy a sample from the trace
+// parameters
+//    index - number of the sample (0 is the oldest)
+//    sample - the sample is copied here
+// returns
+//    false if there is no sample at index
+bool I2cKeypadTrace::getSample(uint16_t index, KeypadTraceSample &sample)
+{
+  if (index >= _count)
+    return false;
+  sample = _samples[(_head - _count + index) & _mask];
+  return true;
+}
+
+// return one byte of the samples, in the format read by I2cKeypad::readTrace(): KEYPAD_TRACE_SAMPLE_SIZE bytes for
+// each sample, oldest first (time, pins, what, state)
+// parameters
+//    position - number of the byte (0 is the first byte of the oldest sample)
+// returns
+//    the byte (0 if position is past the last sample)
+uint8_t I2cKeypadTrace::readByte(uint16_t position)
+{
+  KeypadTraceSample sample;
+  uint8_t bytes[KEYPAD_TRACE_SAMPLE_SIZE];
+
+  if (!getSample(position / KEYPAD_TRACE_SAMPLE_SIZE, sample))
+    return 0;
+  storeWord(bytes, sample.time);
+  storeWord(bytes + 2, sample.pins);
+  bytes[4] = sample.what;
+  bytes[5] = sample.state;
+  return bytes[position % KEYPAD_TRACE_SAMPLE_SIZE];
+}
+
+// stop saving samples, or start again
+// parameters
+//    paused - true to stop saving samples (the ones in the trace stay as they are), false to start again
+// returns
+//    nothing
+void I2cKeypadTrace::pause(bool paused)
+{
+  _paused = paused;
+}
+
+// save a word in 2 bytes, low byte first
+// parameters
+//    data - the bytes are saved here
+//    word - the word to save
+// returns
+//    nothing
+void I2cKeypadTrace::storeWord(uint8_t *data, uint16_t word)
+{
+  data[0] = word;
+  data[1] = word >> 8;
+}
@@ -0,0 +1,168 @@
+/*
+  I2cKeypadTrace.h
+
+  Written by: Gary Muhonen  gary@dcity.org
+
+  Short Description:
+
+    I2cKeypadTrace keeps a record of what scanKeys() saw, so a keypad in the field that misses keys
+    (or gets them twice) can be looked at later. Give a trace to a keypad with I2cKeypad::setTrace(),
+    and each time the scan reads the chip's pins, a 6 byte sample is saved in a ring buffer in RAM:
+
+      time  - microseconds since the sample before (2 bytes)
+      pins  - the level of the chip's pins that were read, bit n is set if pin n is high (2 bytes)
+      what  - what the sample is (KEYPAD_TRACE_QUICK_CHECK, ...) in the high 4 bits, and the column
+              that was driven low in the low 4 bits (1 byte)
+      state - the keypad state machine's state when the sample was saved (1 byte)
+
+    Samples are also saved when the state machine changes state, when a key event is saved, when the
+    INT pin starts a scan in interrupt mode, when the chip is checked, and when a scan fails (see the
+    KEYPAD_TRACE_ values below). When the buffer is full, the oldest sample is written over, so the trace
+    holds what happened just before the problem was seen.
+
+    Use I2cKeypad::readTrace() to read the trace, and send it over Serial (or save it to a SD card):
+
+      uint8_t bytes[32];
+      uint16_t count;
+      while ((count = keypad.readTrace(bytes, sizeof(bytes))))
+        Serial.write(bytes, count);
+
+    The bytes are a header with the keypad's setup, then the samples, oldest first (all of the words are
+    little endian). extras/host/KeypadReplay.cpp runs a trace back through the library on a computer, so
+    the keys it found can be checked against the ones the keypad saved, and against changes to the scan
+    and debounce code.
+
+    Header (KEYPAD_TRACE_HEADER_SIZE bytes):
+      0   'K', 'T'
+      2   KEYPAD_TRACE_VERSION
+      3   KEYPAD_TRACE_SAMPLE_SIZE
+      4   number of rows, number of columns, scan mode, chip type (1 byte each)
+      8   debounce time, active scan interval, idle scan interval, idle delay (ms, 2 bytes each)
+      16  press samples, release samples (see setDebounceSamples()), 1 if interrupts are enabled, 0
+      20  settle time (microseconds, 2 bytes)
+      22  number of samples (2 bytes)
+      24  micros() when the first sample was saved (4 bytes, so the replay's clock matches the keypad's)
+      28  chip check interval (ms, 2 bytes, see setChipCheckInterval()), 0, 0
+      32  chip pin of each row (16 bytes, 0xff after the last row)
+      48  chip pin of each column (16 bytes, 0xff after the last column)
+
+    Use I2cKeypadTraceBuffer<samples> to create a trace along with its samples.
+
+  https://www.dcity.org/portfolio/i2c-keypad-library/
+
+  License Information:  https://www.dcity.org/license-information/
+*/
+
+#ifndef I2C_KEYPAD_TRACE_H
+#define I2C_KEYPAD_TRACE_H
+
+#include "I2cKeypad.h"
+
+#define KEYPAD_TRACE_VERSION 1         // changes if the format of the trace changes
+#define KEYPAD_TRACE_SAMPLE_SIZE 6     // bytes in each sample read by I2cKeypad::readTrace()
+#define KEYPAD_TRACE_HEADER_SIZE 64    // bytes in the header read by I2cKeypad::readTrace()
+#define KEYPAD_TRACE_MAX_SAMPLES 8192  // max number of samples in a trace (so the whole trace can be counted in 16 bits)
+
+// what each sample is (the high 4 bits of KeypadTraceSample::what)
+#define KEYPAD_TRACE_QUICK_CHECK 0x10  // pins read with all the columns low
+#define KEYPAD_TRACE_COLUMN 0x20       // pins read with one column low (the column is in the low 4 bits)
+#define KEYPAD_TRACE_REVERSED 0x30     // pins read with the rows low (KEYPAD_SCAN_LINE_REVERSAL)
+#define KEYPAD_TRACE_INTERRUPT 0x40    // INTF read from a MCP chip in interrupt mode (pins is INTF)
+#define KEYPAD_TRACE_STATE 0x50        // the state machine changed state at the end of a scan (pins is the key found by the
+                                       //    scan, or 0xffff for no keys and 0xfffb for more than one key, state is the new state)
+#define KEYPAD_TRACE_EVENT 0x60        // a key event was saved (the low byte of pins is the key index, or the code number
+                                       //    for KEY_EVENT_CODE, and the high byte is the event type)
+#define KEYPAD_TRACE_ERROR 0x70        // a scan failed (pins is the error state, KEYPAD_ERROR_NACK, etc.)
+#define KEYPAD_TRACE_WAKE 0x80         // the INT pin was seen low while waiting for a key press, so a scan starts (pins is 0)
+#define KEYPAD_TRACE_CHECK 0x90        // the scan checked that the chip was not reset (pins is 1 if it was reset)
+#define KEYPAD_TRACE_TIME 0xf0         // the time since the sample before was too long for 16 bits. The time is in both words:
+                                       //    time is the low 16 bits and pins is the high 16 bits. The next sample's time counts from here.
+#define KEYPAD_TRACE_KIND(what) ((what) & 0xf0)  // what the sample is
+#define KEYPAD_TRACE_INDEX(what) ((what) & 0x0f) // the column of a KEYPAD_TRACE_COLUMN sample
+
+
+// one sample of the trace
+struct KeypadTraceSample {
+  uint16_t time;                  // microseconds since the sample before
+  uint16_t pins;                  // level of the chip's pins (bit n set if pin n is high), or see KEYPAD_TRACE_STATE, etc.
+  uint8_t what;                   // KEYPAD_TRACE_QUICK_CHECK, etc. in the high 4 bits, the column in the low 4 bits
+  uint8_t state;                  // state of the keypad state machine (WAITING_FOR_NEW_KEY_PRESS, etc.)
+};
+
+
+class I2cKeypadTrace {                // class definition
+public:
+
+  // constructor function and public functions
+
+  I2cKeypadTrace(KeypadTraceSample *samples, uint16_t capacity);  // creates a trace that uses the samples array (capacity is the number of elements, a power of 2)
+
+  // save a sample (this is called by the scan, so it only takes the time to read micros() and fill in the sample)
+  void record(uint8_t what, uint16_t pins, uint8_t state)
+  {
+    if (_paused)
+      return;
+    unsigned long now = micros();
+    unsigned long time = now - _lastTime;
+    _lastTime = now;
+    if (time > 0xffff)
+    {
+      store(KEYPAD_TRACE_TIME, time, time >> 16, state);
+      time = 0;
+    }
+    store(what, time, pins, state);
+  }
+
+  void clear(void);                   // remove all the samples
+  uint16_t count(void);               // returns the number of samples in the trace
+  uint16_t capacity(void);            // returns the max number of samples the trace can hold
+  unsigned long startTime(void);      // returns the time (micros) when the oldest sample was saved
+  bool getSample(uint16_t index, KeypadTraceSample &sample);  // copy a sample (0 is the oldest). Returns false if there is no sample at index.
+  uint8_t readByte(uint16_t position);  // returns one byte of the samples, in the format read by I2cKeypad::readTrace() (without the header)
+  void pause(bool paused);            // stop saving samples (true), or start again (false). I2cKeypad::readTrace() pauses the trace while it is read.
+
+  static void storeWord(uint8_t *data, uint16_t word);  // save a word in 2 bytes, little endian (the order of the words in a trace)
+
+
+private:
+  // private functions used by this library
+
+  // save one sample, writing over the oldest one if the trace is full
+  void store(uint8_t what, uint16_t time, uint16_t pins, uint8_t state)
+  {
+    KeypadTraceSample &sample = _samples[_head];
+    sample.time = time;
+    sample.pins = pins;
+    sample.what = what;
+    sample.state = state;
+    _head = (_head + 1) & _mask;
+    if (_count <= _mask)
+      ++_count;
+  }
+
+
+  // private variables
+
+  KeypadTraceSample *_samples;    // array of samples
+  uint16_t _mask;                 // number of elements in _samples - 1
+  uint16_t _head;                 // index in _samples where the next sample is saved
+  uint16_t _count;                // number of samples saved (up to the number of elements in _samples)
+  unsigned long _lastTime;        // time (micros) of the last sample
+  volatile bool _paused;          // true if samples are not being saved
+};
+
+
+// trace along with its samples, the number of samples is set when it is declared, for example
+//     I2cKeypadTraceBuffer<128> trace;
+template <uint16_t Samples>
+class I2cKeypadTraceBuffer : public I2cKeypadTrace {
+  static_assert(Samples && !(Samples & (Samples - 1)) && Samples <= KEYPAD_TRACE_MAX_SAMPLES, "the trace size must be a power of 2, up to 8192");
+
+public:
+  I2cKeypadTraceBuffer() : I2cKeypadTrace(_storage, Samples) {}
+
+private:
+  KeypadTraceSample _storage[Samples];
+};
+
+#endif